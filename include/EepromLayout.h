@@ -0,0 +1,16 @@
+#pragma once
+
+// EEPROM usage of the ATmega2560 (4096 bytes).
+// Every module that persists data owns exactly one region, regions must not overlap.
+
+//Race journal: one slot per heat, used round robin
+#define EEPROM_JOURNAL_START 0
+#define EEPROM_JOURNAL_LENGTH 2560
+
+//Clock calibration: correction of the crystal/resonator frequency error
+#define EEPROM_CALIBRATION_START 2560
+#define EEPROM_CALIBRATION_LENGTH 16
+
+//Sensor offsets: receiver delay per sensor and edge
+#define EEPROM_SENSOR_OFFSETS_START 2576
+#define EEPROM_SENSOR_OFFSETS_LENGTH 32
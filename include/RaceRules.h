@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+// Race rules profiles.
+// Every federation is described by a struct of compile time constants which is plugged into the
+// race handler through the RaceRules typedef below. Because all values are constant expressions,
+// the compiler folds every rule check and no run-time branching is left for rules that don't apply.
+// Only the FCI profile is defined. Another federation gets its own struct with the values which differ
+// and a build flag selecting it below, once those values are confirmed against its rule book.
+
+struct FciRaceRules {
+   //Time between the lights of the start sequence in milliseconds
+   static constexpr unsigned long StartLightInterval = 1000;
+   //Time between starting the light sequence and the GREEN light (3 light intervals) in microseconds
+   static constexpr unsigned long StartDelay = 3000000;
+   //A box side trigger within this time after a dog entered is still the previous dog coming back (microseconds)
+   static constexpr unsigned long FalseCrossingWindow = 2000000;
+   //An incomplete transition string is discarded when it was not updated for this time (microseconds)
+   static constexpr unsigned long TransitionTimeout = 2000000;
+   static constexpr uint8_t DogsPerTeam = 4;
+   //Size of the per dog run table (first run + reruns)
+   static constexpr uint8_t MaxRunsPerDog = 4;
+   //Faulted dogs have to run again after the last dog
+   static constexpr bool RerunFaultedDogs = true;
+   //Crossing classification (microseconds): below 0 is an early fault, up to PerfectCrossingLimit
+   //is perfect, up to LateCrossingLimit is ok, anything slower is late
+   static constexpr long PerfectCrossingLimit = 10000;
+   static constexpr long LateCrossingLimit = 1000000;
+};
+
+typedef FciRaceRules RaceRules;
+
+static_assert(RaceRules::StartDelay == RaceRules::StartLightInterval * 3000UL, "Start delay must match the start light sequence");
+static_assert(RaceRules::DogsPerTeam <= 8 && RaceRules::MaxRunsPerDog <= 8, "Race rules exceed the size of the race data tables");
@@ -1,15 +1,24 @@
 #pragma once
+#include "RaceRules.h"
 // #include <rom/rtc.h>
 
 struct DogTimeData {
-   unsigned long Time;
-   long CrossingTime;
+   unsigned long Time;     //Milliseconds
+   long CrossingTime;      //Microseconds
+   uint8_t CrossingClass;  //RaceHandlerClass::CrossingClasses
+   uint8_t EnterSpeed;     //0.1 m/s through the gates going in, 0 if not measured
+   uint8_t ReturnSpeed;    //0.1 m/s through the gates coming back, 0 if not measured
+#ifdef BOX_SENSOR_PIN
+   uint16_t OutrunTime;    //Milliseconds from the crossing to the box hit, 0 if the box sensor saw no hit
+   uint16_t TurnTime;      //Milliseconds the dog was on the box, the return is Time - OutrunTime - TurnTime
+#endif
 };
 
 struct stDogData {
    uint8_t DogNumber;
    //String DogName;
-   DogTimeData Timing[4];
+   DogTimeData Timing[RaceRules::MaxRunsPerDog];
+   uint8_t LastRunNumber;  //Zero-based index of the last run, higher than 0 if the dog had reruns
    boolean Running;
    boolean Fault;
 };
@@ -20,6 +29,7 @@ struct RaceData {
    unsigned long EndTime;
    unsigned long ElapsedTime;
    uint8_t RaceState;
-   stDogData DogData[4];
+   stDogData DogData[RaceRules::DogsPerTeam];
    long TotalCrossingTime;
+   long FalseStartTime;    //Microseconds, first beam break relative to the green light, 0 if none
 };
\ No newline at end of file
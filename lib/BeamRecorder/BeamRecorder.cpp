@@ -0,0 +1,220 @@
+#include "BeamRecorder.h"
+#include <RaceJournal.h>
+#include <Telemetry.h>
+
+#define BEAM_EXPORT_CHUNK 32   //Bytes of run-length data per BMD frame
+
+/// <summary>
+///   Stores one sample of both beams, called at BEAM_SAMPLE_RATE from the sensor capture timer
+///   interrupt. Bit 0 is sensor 1, bit 1 sensor 2.
+/// </summary>
+///
+/// <param name="Beams">   The beam states, a bit is set if the beam is broken. </param>
+void BeamRecorderClass::Sample(uint8_t Beams) {
+   if (_State == FROZEN) {
+      return;
+   }
+
+   uint16_t Index = _SampleIndex;
+   uint8_t Shift = (Index & 3) << 1;
+   uint8_t &Byte = _Ring[(Index >> 2) & (BEAM_RING_BYTES - 1)];
+   Byte = (Byte & ~(3 << Shift)) | ((Beams & 3) << Shift);
+   _SampleIndex = Index + 1;
+
+   if (_Recorded < BEAM_RING_SAMPLES) {
+      _Recorded++;
+   }
+   if (_State == ARMED && Index == _FreezeIndex) {
+      _State = FROZEN;
+   }
+}
+
+/// <summary>
+///   Captures the beams around a crossing. Ignored while the previous capture is still being
+///   taken, a second crossing within BEAM_WINDOW_SAMPLES is part of that capture anyway, and once
+///   the race has BEAM_CAPTURES_PER_HEAT captures.
+/// </summary>
+///
+/// <param name="EventTime">  The time of the crossing in microseconds (micros()), at most about
+///                           100ms ago. </param>
+/// <param name="DogIndex">   Zero-based index of the dog which crossed. </param>
+/// <param name="RaceId">     ID of the race. </param>
+void BeamRecorderClass::Trigger(unsigned long EventTime, uint8_t DogIndex, unsigned int RaceId) {
+   if (RaceId != _CaptureRaceId) {
+      _CaptureRaceId = RaceId;
+      _NextCaptureNumber = 0;
+   }
+   if (_State != RECORDING || _NextCaptureNumber >= BEAM_CAPTURES_PER_HEAT) {
+      return;
+   }
+
+   noInterrupts();
+   uint16_t Now = _SampleIndex;
+   uint16_t Recorded = _Recorded;
+   unsigned long NowTime = micros();
+   interrupts();
+
+   unsigned long Ago = (NowTime - EventTime) / BEAM_SAMPLE_PERIOD;
+   if (Ago >= Recorded) {
+      return;
+   }
+   uint16_t PreSamples = min((unsigned long)BEAM_WINDOW_SAMPLES, Recorded - Ago);
+   uint16_t TriggerIndex = Now - Ago;
+
+   _Capture = &_Captures[_NextCaptureNumber % BEAM_CAPTURE_SLOTS];
+   _Capture->Number = _NextCaptureNumber;
+   _Capture->Valid = false;
+   _Capture->DogIndex = DogIndex;
+   _Capture->RaceId = RaceId;
+   _Capture->TriggerTime = EventTime;
+   _Capture->PreSamples = PreSamples;
+   _Capture->Samples = 0;
+   _Capture->Length = 0;
+   _Capture->Truncated = false;
+   _CompressIndex = TriggerIndex - PreSamples;
+   _RunLength = 0;
+
+   //Freeze BEAM_WINDOW_SAMPLES after the crossing, or right away if that has already passed
+   noInterrupts();
+   if ((uint16_t)(_SampleIndex - TriggerIndex) >= BEAM_WINDOW_SAMPLES) {
+      _CompressEnd = _SampleIndex;
+      _State = FROZEN;
+   } else {
+      _FreezeIndex = TriggerIndex + BEAM_WINDOW_SAMPLES - 1;
+      _CompressEnd = TriggerIndex + BEAM_WINDOW_SAMPLES;
+      _State = ARMED;
+   }
+   interrupts();
+
+   RaceJournal.LogRecord(RaceJournal.BEAM_CAPTURE, _NextCaptureNumber);
+   _NextCaptureNumber++;
+}
+
+/// <summary>
+///   Compresses a frozen capture window, at most BEAM_COMPRESS_BATCH samples per call. Sampling
+///   resumes once the capture is complete.
+/// </summary>
+void BeamRecorderClass::Main() {
+   if (_State != FROZEN) {
+      return;
+   }
+
+   for (uint16_t Count = 0; Count < BEAM_COMPRESS_BATCH && _CompressIndex != _CompressEnd; Count++) {
+      uint8_t Beams = _GetSample(_CompressIndex++);
+      if (_RunLength > 0 && Beams != _RunBeams) {
+         if (!_WriteRun()) {
+            _Capture->Truncated = true;
+            _FinishCapture();
+            return;
+         }
+         _RunLength = 0;
+      }
+      _RunBeams = Beams;
+      _RunLength++;
+   }
+
+   if (_CompressIndex == _CompressEnd) {
+      if (_RunLength > 0 && !_WriteRun()) {
+         _Capture->Truncated = true;
+      }
+      _FinishCapture();
+   }
+}
+
+/// <summary>
+///   Sends a capture as telemetry frames: one BMH header frame (capture number, race ID, dog
+///   index, crossing time in microseconds, samples before the crossing, samples, sample period in
+///   microseconds, truncated), BMD frames with the run-length data in hex (capture number, offset,
+///   data) and one BME frame (capture number, data length).
+/// </summary>
+///
+/// <param name="RaceId">          ID of the race of the capture. </param>
+/// <param name="CaptureNumber">   The capture number, as logged in the journal of the race. </param>
+///
+/// <returns>
+///   true if the capture was found, false if it was overwritten or is not complete yet.
+/// </returns>
+bool BeamRecorderClass::Export(unsigned int RaceId, uint8_t CaptureNumber) {
+   const BeamCapture &Capture = _Captures[CaptureNumber % BEAM_CAPTURE_SLOTS];
+   if (!Capture.Valid || Capture.Number != CaptureNumber || Capture.RaceId != (uint16_t)RaceId) {
+      return false;
+   }
+
+   Telemetry.BeginFrame(F("BMH"));
+   Telemetry.AddField(Capture.Number);
+   Telemetry.AddField(Capture.RaceId);
+   Telemetry.AddField(Capture.DogIndex);
+   Telemetry.AddField(Capture.TriggerTime);
+   Telemetry.AddField(Capture.PreSamples);
+   Telemetry.AddField(Capture.Samples);
+   Telemetry.AddField(BEAM_SAMPLE_PERIOD);
+   Telemetry.AddField(Capture.Truncated);
+   Telemetry.EndFrame();
+
+   char Hex[BEAM_EXPORT_CHUNK * 2 + 1];
+   for (uint8_t Offset = 0; Offset < Capture.Length; Offset += BEAM_EXPORT_CHUNK) {
+      uint8_t ChunkLength = min(BEAM_EXPORT_CHUNK, Capture.Length - Offset);
+      for (uint8_t i = 0; i < ChunkLength; i++) {
+         sprintf_P(Hex + i * 2, PSTR("%02X"), Capture.Data[Offset + i]);
+      }
+      Telemetry.BeginFrame(F("BMD"));
+      Telemetry.AddField(Capture.Number);
+      Telemetry.AddField(Offset);
+      Telemetry.AddField(Hex);
+      Telemetry.EndFrame();
+   }
+
+   Telemetry.BeginFrame(F("BME"));
+   Telemetry.AddField(Capture.Number);
+   Telemetry.AddField(Capture.Length);
+   Telemetry.EndFrame();
+   return true;
+}
+
+/// <summary>
+///   Gets a sample from the ring.
+/// </summary>
+uint8_t BeamRecorderClass::_GetSample(uint16_t Index) {
+   return (_Ring[(Index >> 2) & (BEAM_RING_BYTES - 1)] >> ((Index & 3) << 1)) & 3;
+}
+
+/// <summary>
+///   Appends the current run to the capture.
+/// </summary>
+///
+/// <returns>
+///   true if the run fit in the capture, false if the capture is full.
+/// </returns>
+bool BeamRecorderClass::_WriteRun() {
+   uint8_t Run[4];
+   uint8_t RunLength = 0;
+   uint16_t Rest = _RunLength >> 5;
+   Run[RunLength++] = (_RunBeams << 6) | (Rest ? 0x20 : 0) | (_RunLength & 0x1F);
+   while (Rest != 0) {
+      Run[RunLength] = Rest & 0x7F;
+      Rest >>= 7;
+      if (Rest != 0) {
+         Run[RunLength] |= 0x80;
+      }
+      RunLength++;
+   }
+
+   if (_Capture->Length + RunLength > BEAM_CAPTURE_SIZE) {
+      return false;
+   }
+   memcpy(_Capture->Data + _Capture->Length, Run, RunLength);
+   _Capture->Length += RunLength;
+   _Capture->Samples += _RunLength;
+   return true;
+}
+
+/// <summary>
+///   Marks the capture complete and resumes sampling.
+/// </summary>
+void BeamRecorderClass::_FinishCapture() {
+   _Capture->Valid = true;
+   _Recorded = 0;
+   _State = RECORDING;
+}
+
+BeamRecorderClass BeamRecorder;
@@ -0,0 +1,81 @@
+#ifndef _BEAMRECORDER_h
+#define _BEAMRECORDER_h
+
+#include "Arduino.h"
+
+#ifndef BEAM_SAMPLE_RATE
+#define BEAM_SAMPLE_RATE 10000                     //Samples per second of both beams
+#endif
+#define BEAM_SAMPLE_PERIOD (1000000UL / BEAM_SAMPLE_RATE)
+#define BEAM_WINDOW_SAMPLES 1000                   //Samples kept before and after a trigger (100ms)
+#define BEAM_RING_SAMPLES 2048                     //Power of 2, at least 2 * BEAM_WINDOW_SAMPLES
+#define BEAM_RING_BYTES (BEAM_RING_SAMPLES / 4)
+#define BEAM_CAPTURE_SLOTS 4
+#define BEAM_CAPTURES_PER_HEAT 16                  //Capture numbers 0-15, the payload of a journal record
+#define BEAM_CAPTURE_SIZE 128                      //Bytes of run-length data per capture
+#define BEAM_COMPRESS_BATCH 256                    //Samples compressed per call of Main()
+
+/// <summary>
+///   Photo finish for the sensors: both beams are sampled at BEAM_SAMPLE_RATE into a ring of 2 bits
+///   per sample. When a crossing is measured the ring is frozen BEAM_WINDOW_SAMPLES after the
+///   crossing, and the window around it is run-length compressed into one of BEAM_CAPTURE_SLOTS
+///   capture slots, a little at a time from Main(). The race journal gets a BEAM_CAPTURE record
+///   with the capture number right after the sensor edge of the crossing. Capture numbers count
+///   the captures of a heat, so a capture is identified by its race ID and number. A heat has at
+///   most one crossing per run, which is always within BEAM_CAPTURES_PER_HEAT. A slot which was
+///   taken by a newer capture no longer matches, so an old journal reference fails cleanly.
+///
+///   Run-length data: one byte per run, state of sensor 1 in bit 6, sensor 2 in bit 7 (1 is beam
+///   broken), bits 0-4 the low 5 bits of the run length in samples. If bit 5 is set the rest of the
+///   run length (length >> 5) follows as an unsigned LEB128 varint.
+/// </summary>
+class BeamRecorderClass {
+   public:
+      void Sample(uint8_t Beams);
+      void Trigger(unsigned long EventTime, uint8_t DogIndex, unsigned int RaceId);
+      void Main();
+      bool Export(unsigned int RaceId, uint8_t CaptureNumber);
+
+   private:
+      enum RecorderStates {
+         RECORDING,     //Sampling, no capture pending
+         ARMED,         //Sampling until _FreezeIndex
+         FROZEN         //Not sampling, the window is being compressed
+      };
+      volatile RecorderStates _State = RECORDING;
+      volatile uint16_t _SampleIndex = 0;
+      volatile uint16_t _FreezeIndex;
+      volatile uint16_t _Recorded = 0;   //Samples in the ring since the last capture, up to BEAM_RING_SAMPLES
+      uint8_t _Ring[BEAM_RING_BYTES];
+
+      struct BeamCapture {
+         uint8_t Number;            //0-15 within the race, as logged in the journal
+         bool Valid;                //False while the capture is being taken, or if it was never taken
+         uint8_t DogIndex;
+         uint16_t RaceId;
+         unsigned long TriggerTime;
+         uint16_t PreSamples;       //Samples before the trigger
+         uint16_t Samples;          //Samples in the capture
+         uint8_t Length;            //Bytes of run-length data
+         bool Truncated;            //The data did not fit, the capture ends early
+         uint8_t Data[BEAM_CAPTURE_SIZE];
+      };
+      BeamCapture _Captures[BEAM_CAPTURE_SLOTS];
+      uint8_t _NextCaptureNumber = 0;
+      unsigned int _CaptureRaceId = 0;   //Race of _NextCaptureNumber
+
+      //Compression of the frozen window
+      BeamCapture *_Capture;
+      uint16_t _CompressIndex;
+      uint16_t _CompressEnd;
+      uint8_t _RunBeams;
+      uint16_t _RunLength;
+
+      uint8_t _GetSample(uint16_t Index);
+      bool _WriteRun();
+      void _FinishCapture();
+};
+
+extern BeamRecorderClass BeamRecorder;
+
+#endif
@@ -0,0 +1,139 @@
+#include "Button.h"
+
+/// <summary>
+///   Initialises this object. The interrupt which calls HandleEdge() on every change of the pin
+///   has to be attached by the caller.
+/// </summary>
+///
+/// <param name="Pin">  The pin the button is connected to. </param>
+void ButtonClass::Init(uint8_t Pin) {
+   _Pin = Pin;
+   pinMode(_Pin, INPUT);
+   _RawPressed = _Pressed = (digitalRead(_Pin) == HIGH);
+}
+
+/// <summary>
+///   Records an edge of the button pin, should be called from the pin change interrupt. If the
+///   queue is full (heavy bouncing), the newest record is overwritten so the last known state of
+///   the pin is never lost.
+/// </summary>
+void ButtonClass::HandleEdge() {
+   uint8_t WriteIndex = _EdgeWriteIndex;
+   uint8_t NextWriteIndex = (WriteIndex + 1) % BUTTON_EDGE_QUEUE_LENGTH;
+   if (NextWriteIndex == _EdgeReadIndex) {
+      WriteIndex = (WriteIndex + BUTTON_EDGE_QUEUE_LENGTH - 1) % BUTTON_EDGE_QUEUE_LENGTH;
+      NextWriteIndex = _EdgeWriteIndex;
+   }
+
+   _EdgeQueue[WriteIndex].Time = micros();
+   _EdgeQueue[WriteIndex].Pressed = (digitalRead(_Pin) == HIGH);
+   _EdgeWriteIndex = NextWriteIndex;
+}
+
+/// <summary>
+///   Main entry-point for this object, should be called once every main loop. Handles the edges
+///   recorded since the last call and detects presses.
+/// </summary>
+///
+/// <returns>
+///   The detected press, NO_EVENT if nothing happened.
+/// </returns>
+ButtonClass::ButtonEvents ButtonClass::Main() {
+   while (_EdgeReadIndex != _EdgeWriteIndex && _PendingEvent == NO_EVENT) {
+      noInterrupts();
+      ButtonEdge Edge = {_EdgeQueue[_EdgeReadIndex].Time, _EdgeQueue[_EdgeReadIndex].Pressed};
+      _EdgeReadIndex = (_EdgeReadIndex + 1) % BUTTON_EDGE_QUEUE_LENGTH;
+      interrupts();
+
+      //The previous state is only accepted if it was stable until this edge
+      _Settle(Edge.Time);
+      _RawPressed = Edge.Pressed;
+      _RawChangeTime = Edge.Time;
+   }
+
+   unsigned long Now = micros();
+   if (_PendingEvent == NO_EVENT) {
+      _Settle(Now);
+   }
+
+   if (_PendingEvent == NO_EVENT) {
+      if (_Pressed && !_LongPressSent && (Now - _PressTime) >= BUTTON_LONG_PRESS_TIME) {
+         _LongPressSent = true;
+         _SetEvent(LONG_PRESS, _PressTime + BUTTON_LONG_PRESS_TIME);
+      } else if (!_Pressed && _PressCount == 1 && (Now - _ReleaseTime) >= BUTTON_DOUBLE_PRESS_TIME) {
+         _PressCount = 0;
+         _SetEvent(SHORT_PRESS, _ReleaseTime + BUTTON_DOUBLE_PRESS_TIME);
+      }
+   }
+
+   ButtonEvents Event = _PendingEvent;
+   if (Event != NO_EVENT) {
+      _PendingEvent = NO_EVENT;
+      _LastLatency = Now - _PendingEventTime;
+      if (_LastLatency > _MaxLatency) {
+         _MaxLatency = _LastLatency;
+      }
+   }
+   return Event;
+}
+
+/// <summary>
+///   Gets the latency of the last press event: the time between the moment the press could be
+///   recognized (the debounced edge, or the end of the long press or double press window) and the
+///   moment Main() returned it.
+/// </summary>
+///
+/// <returns>
+///   The latency in microseconds.
+/// </returns>
+unsigned long ButtonClass::GetLastLatency() {
+   return _LastLatency;
+}
+
+/// <summary>
+///   Gets the highest latency of all press events so far, see GetLastLatency().
+/// </summary>
+unsigned long ButtonClass::GetMaxLatency() {
+   return _MaxLatency;
+}
+
+/// <summary>
+///   Accepts the last recorded state of the pin if it has been stable for the debounce time.
+/// </summary>
+///
+/// <param name="Now">  The time up to which the state is known to be unchanged. </param>
+void ButtonClass::_Settle(unsigned long Now) {
+   if (_RawPressed != _Pressed && (Now - _RawChangeTime) >= BUTTON_DEBOUNCE_TIME) {
+      _ChangeState(_RawPressed, _RawChangeTime);
+   }
+}
+
+/// <summary>
+///   Handles a debounced press or release.
+/// </summary>
+void ButtonClass::_ChangeState(bool Pressed, unsigned long Time) {
+   _Pressed = Pressed;
+
+   if (Pressed) {
+      _PressTime = Time;
+      _PressCount++;
+      _LongPressSent = false;
+      return;
+   }
+
+   _ReleaseTime = Time;
+   if (_LongPressSent) {
+      //Release after a long press, the long press was already sent
+      _PressCount = 0;
+   } else if (_PressCount >= 2) {
+      _PressCount = 0;
+      _SetEvent(DOUBLE_PRESS, Time + BUTTON_DEBOUNCE_TIME);
+   }
+}
+
+void ButtonClass::_SetEvent(ButtonEvents Event, unsigned long Time) {
+   _PendingEvent = Event;
+   _PendingEventTime = Time;
+}
+
+ButtonClass Button;
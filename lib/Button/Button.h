@@ -0,0 +1,62 @@
+#ifndef _BUTTON_h
+#define _BUTTON_h
+
+#include "Arduino.h"
+
+/// <summary>
+///   Debounced push button with short, long and double press detection. Edges are captured by an
+///   interrupt (HandleEdge()), Main() debounces them and turns them into press events, so the
+///   button pin is never polled. The button is active high.
+/// </summary>
+class ButtonClass {
+   public:
+      enum ButtonEvents
+      {
+         NO_EVENT,
+         SHORT_PRESS,   //Sent once the double press window passed after a single press
+         LONG_PRESS,    //Sent while the button is still held, after BUTTON_LONG_PRESS_TIME
+         DOUBLE_PRESS   //Sent on release of the second press
+      };
+
+      void Init(uint8_t Pin);
+      void HandleEdge();
+      ButtonEvents Main();
+      unsigned long GetLastLatency();
+      unsigned long GetMaxLatency();
+
+   private:
+      #define BUTTON_EDGE_QUEUE_LENGTH 8
+      #define BUTTON_DEBOUNCE_TIME 20000UL          //us the contacts must be stable
+      #define BUTTON_LONG_PRESS_TIME 1500000UL      //us the button must be held for a long press
+      #define BUTTON_DOUBLE_PRESS_TIME 300000UL     //us between a release and the next press
+
+      struct ButtonEdge {
+         unsigned long Time;
+         bool Pressed;
+      };
+
+      uint8_t _Pin;
+      volatile ButtonEdge _EdgeQueue[BUTTON_EDGE_QUEUE_LENGTH];
+      volatile uint8_t _EdgeReadIndex = 0;
+      volatile uint8_t _EdgeWriteIndex = 0;
+
+      bool _RawPressed = false;           //State of the last edge, may still be bouncing
+      unsigned long _RawChangeTime = 0;
+      bool _Pressed = false;              //Debounced state
+      unsigned long _PressTime = 0;
+      unsigned long _ReleaseTime = 0;
+      uint8_t _PressCount = 0;            //Presses in the current gesture
+      bool _LongPressSent = false;
+      ButtonEvents _PendingEvent = NO_EVENT;
+      unsigned long _PendingEventTime = 0;
+      unsigned long _LastLatency = 0;
+      unsigned long _MaxLatency = 0;
+
+      void _Settle(unsigned long Now);
+      void _ChangeState(bool Pressed, unsigned long Time);
+      void _SetEvent(ButtonEvents Event, unsigned long Time);
+};
+
+extern ButtonClass Button;
+
+#endif
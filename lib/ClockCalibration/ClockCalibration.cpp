@@ -0,0 +1,96 @@
+#include "ClockCalibration.h"
+#include <EEPROM.h>
+
+/// <summary>
+///   Loads the correction from EEPROM, without a valid record the clock is left uncorrected.
+/// </summary>
+void ClockCalibrationClass::Init() {
+   CalibrationRecord Record;
+   EEPROM.get(EEPROM_CALIBRATION_START, Record);
+   if (Record.Magic == CLOCK_CALIBRATION_MAGIC && labs(Record.Ppm) <= CLOCK_CALIBRATION_MAX_PPM) {
+      _Ppm = Record.Ppm;
+   } else {
+      _Ppm = 0;
+   }
+   _SetFactor();
+}
+
+/// <summary>
+///   Gets the current correction.
+/// </summary>
+///
+/// <returns>
+///   The correction in ppm.
+/// </returns>
+long ClockCalibrationClass::GetPpm() {
+   return _Ppm;
+}
+
+/// <summary>
+///   Sets the correction and stores it in EEPROM.
+/// </summary>
+///
+/// <param name="Ppm">  The correction in ppm, positive if the clock runs slow. </param>
+///
+/// <returns>
+///   true if the correction was stored, false if it is out of range.
+/// </returns>
+bool ClockCalibrationClass::SetPpm(long Ppm) {
+   if (labs(Ppm) > CLOCK_CALIBRATION_MAX_PPM) {
+      return false;
+   }
+
+   _Ppm = Ppm;
+   _SetFactor();
+
+   CalibrationRecord Record = {CLOCK_CALIBRATION_MAGIC, _Ppm};
+   EEPROM.put(EEPROM_CALIBRATION_START, Record);
+   return true;
+}
+
+/// <summary>
+///   Corrects a measured duration. The duration is split in a high and a low 16 bit half so both
+///   products with the factor fit in 32 bits, this costs two long multiplies and no floating point.
+/// </summary>
+///
+/// <param name="Duration">   The measured duration in microseconds. </param>
+///
+/// <returns>
+///   The corrected duration in microseconds.
+/// </returns>
+unsigned long ClockCalibrationClass::Correct(unsigned long Duration) {
+   if (_Factor == 0) {
+      return Duration;
+   }
+
+   long High = (long)(Duration >> 16) * _Factor;
+   long Low = (long)(Duration & 0xFFFF) * _Factor;
+   return Duration + (High >> (CLOCK_CALIBRATION_FRACTION_BITS - 16)) + (Low >> CLOCK_CALIBRATION_FRACTION_BITS);
+}
+
+/// <summary>
+///   Corrects a measured signed duration (e.g. a crossing time).
+/// </summary>
+///
+/// <param name="Duration">   The measured duration in microseconds. </param>
+///
+/// <returns>
+///   The corrected duration in microseconds.
+/// </returns>
+long ClockCalibrationClass::Correct(long Duration) {
+   if (Duration < 0) {
+      return -(long)Correct((unsigned long)-Duration);
+   }
+   return Correct((unsigned long)Duration);
+}
+
+/// <summary>
+///   Converts the correction to the fixed point factor used by Correct(), rounded to the nearest
+///   step. This is done once when the correction changes, not per measurement.
+/// </summary>
+void ClockCalibrationClass::_SetFactor() {
+   long Scaled = _Ppm * (1L << (CLOCK_CALIBRATION_FRACTION_BITS - 6));   //Fits: 10000 * 2^14 < 2^31
+   _Factor = (Scaled + (Scaled < 0 ? -7812L : 7812L)) / 15625L;           //1000000 / 2^6 = 15625
+}
+
+ClockCalibrationClass ClockCalibration;
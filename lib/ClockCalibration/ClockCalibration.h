@@ -0,0 +1,44 @@
+#ifndef _CLOCKCALIBRATION_h
+#define _CLOCKCALIBRATION_h
+
+#include "Arduino.h"
+#include "EepromLayout.h"
+
+//Largest correction accepted, the resonator spec is +/-0.5%
+#define CLOCK_CALIBRATION_MAX_PPM 10000L
+
+//Fraction bits of the correction factor. With Q20 one step is 0.95ppm, and the factor for
+//CLOCK_CALIBRATION_MAX_PPM fits in 14 bits, so Correct() can stay in 32 bit arithmetic
+#define CLOCK_CALIBRATION_FRACTION_BITS 20
+
+/// <summary>
+///   Corrects durations measured with micros() for the frequency error of the 16MHz resonator.
+///   The correction is given in ppm (how much longer the true duration is than the measured one)
+///   and stored in EEPROM. It is measured against a reference clock with the CAL SYNC command (see
+///   tools/clock_calibration.py).
+/// </summary>
+class ClockCalibrationClass {
+   public:
+      void Init();
+      long GetPpm();
+      bool SetPpm(long Ppm);
+      long Correct(long Duration);
+      unsigned long Correct(unsigned long Duration);
+
+   private:
+      struct CalibrationRecord {
+         uint16_t Magic;
+         long Ppm;
+      };
+
+      #define CLOCK_CALIBRATION_MAGIC 0x434C
+
+      long _Ppm = 0;
+      long _Factor = 0;   //_Ppm / 1000000 in Q20
+
+      void _SetFactor();
+};
+
+extern ClockCalibrationClass ClockCalibration;
+
+#endif
@@ -29,31 +29,174 @@ void LCDControllerClass::init(LiquidCrystal_I2C *LCD1) {
    _LCD1->begin(40, 2);
    _LCD1->clear();
 
-   //Put initial text on screen
+   _LoadBigFont();
+   _DrawDetailedLayout();
+
+   _SLCDfieldFields[D1Time] = {1, 3, 7, String(F("  0.000")), DETAILED};
+   _SLCDfieldFields[D1RerunInfo] = {1, 22, 2, String(F("  ")), DETAILED};
+   _SLCDfieldFields[D2Time] = {2, 3, 7, String(F("  0.000")), DETAILED};
+   _SLCDfieldFields[D2RerunInfo] = {2, 22, 2, String(F("  ")), DETAILED};
+   _SLCDfieldFields[D3Time] = {3, 3, 7, String(F("  0.000")), DETAILED};
+   _SLCDfieldFields[D3RerunInfo] = {3, 22, 2, String(F("  ")), DETAILED};
+   _SLCDfieldFields[D4Time] = {4, 3, 7, String(F("  0.000")), DETAILED};
+   _SLCDfieldFields[D4RerunInfo] = {4, 22, 2, String(F("  ")), DETAILED};
+   _SLCDfieldFields[D1CrossTime] = {1, 12, 8, String(F("+.000000")), DETAILED};
+   _SLCDfieldFields[D2CrossTime] = {2, 12, 8, String(F("+.000000")), DETAILED};
+   _SLCDfieldFields[D3CrossTime] = {3, 12, 8, String(F("+.000000")), DETAILED};
+   _SLCDfieldFields[D4CrossTime] = {4, 12, 8, String(F("+.000000")), DETAILED};
+   _SLCDfieldFields[BattLevel] = {1, 36, 3, String(F("  0")), DETAILED};
+   _SLCDfieldFields[RaceState] = {1, 25, 7, String(F(" STOP")), DETAILED};
+   _SLCDfieldFields[TeamTime] = {2, 32, 7, String(F("  0.000")), DETAILED};
+   _SLCDfieldFields[TotalCrossTime] = {3, 32, 7, String(F("  0.000")), DETAILED};
+#ifdef BOX_SENSOR_PIN
+   _SLCDfieldFields[BoxDirection] = {4, 25, 15, String(), DETAILED};
+#else
+   _SLCDfieldFields[BoxDirection] = {4, 37, 3, String(F("-->")), DETAILED};
+#endif
+   _SLCDfieldFields[D1CrossClass] = {1, 21, 1, String(F(" ")), DETAILED};
+   _SLCDfieldFields[D2CrossClass] = {2, 21, 1, String(F(" ")), DETAILED};
+   _SLCDfieldFields[D3CrossClass] = {3, 21, 1, String(F(" ")), DETAILED};
+   _SLCDfieldFields[D4CrossClass] = {4, 21, 1, String(F(" ")), DETAILED};
+   //Below the big team time:    "Dog 2  D1 +0.12  Fin  18.42  Best -0.31"
+   _SLCDfieldFields[BigRunningDog] = {4, 0, 6, String(), BIG_TIME};
+   _SLCDfieldFields[BigDogPace] = {4, 7, 9, String(), BIG_TIME};
+   _SLCDfieldFields[BigProjectedTime] = {4, 17, 10, String(), BIG_TIME};
+   _SLCDfieldFields[BigBestDelta] = {4, 29, 11, String(), BIG_TIME};
+}
+
+/// <summary>
+///   Custom characters for the big digits. Every digit is 3 characters wide and 2 lines high and
+///   is built from these 8 glyphs (the HD44780 has exactly 8 CGRAM slots), the full block (255)
+///   and a space.
+/// </summary>
+static const uint8_t BigFontGlyphs[8][8] PROGMEM = {
+   {0x07, 0x0F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F},  //0: upper left corner
+   {0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00},  //1: upper bar
+   {0x1C, 0x1E, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F},  //2: upper right corner
+   {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x0F, 0x07},  //3: lower left corner
+   {0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F},  //4: lower bar
+   {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1E, 0x1C},  //5: lower right corner
+   {0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x1F, 0x1F},  //6: upper and middle bar
+   {0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F}   //7: middle and lower bar
+};
+
+//Glyphs for the digits 0-9: 3 characters for the upper line followed by 3 for the lower line
+static const uint8_t BigFontDigits[10][6] PROGMEM = {
+   {0, 1, 2, 3, 4, 5},
+   {1, 2, ' ', 4, 255, 4},
+   {6, 6, 2, 3, 4, 4},
+   {6, 6, 2, 4, 4, 5},
+   {3, 4, 255, ' ', ' ', 255},
+   {255, 6, 6, 4, 4, 5},
+   {0, 6, 6, 3, 4, 5},
+   {1, 1, 2, ' ', ' ', 255},
+   {0, 6, 2, 3, 4, 5},
+   {0, 6, 2, ' ', ' ', 255}
+};
+
+/// <summary>
+///   Loads the big digit glyphs into the CGRAM of the LCD.
+/// </summary>
+void LCDControllerClass::_LoadBigFont() {
+   uint8_t Glyph[8];
+   for (uint8_t GlyphIndex = 0; GlyphIndex < 8; GlyphIndex++) {
+      memcpy_P(Glyph, BigFontGlyphs[GlyphIndex], sizeof(Glyph));
+      _LCD1->createChar(GlyphIndex, Glyph);
+   }
+}
+
+/// <summary>
+///   Draws the static text of the detailed (per dog) view, the fields are drawn on top of this.
+/// </summary>
+void LCDControllerClass::_DrawDetailedLayout() {
+   //Put initial text on screen, the layout comes from flash so it takes no SRAM
    //                                 1         2         3
    //LCD layout:            0123456789012345678901234567890123456789
-   _UpdateLCD(1, 0, String("1:   0.000s +  0.000s   | STOP   B:   0%"), 40);
-   _UpdateLCD(2, 0, String("2:   0.000s +  0.000s   | Team:   0.000s"), 40);
-   _UpdateLCD(3, 0, String("3:   0.000s +  0.000s   |   CR:   0.000s"), 40);
-   _UpdateLCD(4, 0, String("4:   0.000s +  0.000s   |       Box: -->"), 40);
-
-   _SLCDfieldFields[D1Time] = {1, 3, 7, String("  0.000")};
-   _SLCDfieldFields[D1RerunInfo] = {1, 22, 2, String("  ")};
-   _SLCDfieldFields[D2Time] = {2, 3, 7, String("  0.000")};
-   _SLCDfieldFields[D2RerunInfo] = {2, 22, 2, String("  ")};
-   _SLCDfieldFields[D3Time] = {3, 3, 7, String("  0.000")};
-   _SLCDfieldFields[D3RerunInfo] = {3, 22, 2, String("  ")};
-   _SLCDfieldFields[D4Time] = {4, 3, 7, String("  0.000")};
-   _SLCDfieldFields[D4RerunInfo] = {4, 22, 2, String("  ")};
-   _SLCDfieldFields[D1CrossTime] = {1, 12, 8, String("+  0.000")};
-   _SLCDfieldFields[D2CrossTime] = {2, 12, 8, String("+  0.000")};
-   _SLCDfieldFields[D3CrossTime] = {3, 12, 8, String("+  0.000")};
-   _SLCDfieldFields[D4CrossTime] = {4, 12, 8, String("+  0.000")};
-   _SLCDfieldFields[BattLevel] = {1, 36, 3, String("  0")};
-   _SLCDfieldFields[RaceState] = {1, 25, 7, String(" STOP")};
-   _SLCDfieldFields[TeamTime] = {2, 32, 7, String("  0.000")};
-   _SLCDfieldFields[TotalCrossTime] = {3, 32, 7, String("  0.000")};
-   _SLCDfieldFields[BoxDirection] = {4, 37, 3, String("-->")};
+   _UpdateLCD(1, 0, String(F("1:   0.000s +.000000s   | STOP   B:   0%")), 40);
+   _UpdateLCD(2, 0, String(F("2:   0.000s +.000000s   | Team:   0.000s")), 40);
+   _UpdateLCD(3, 0, String(F("3:   0.000s +.000000s   |   CR:   0.000s")), 40);
+#ifdef BOX_SENSOR_PIN
+   //The box splits of the last dog back take the place of the box direction
+   _UpdateLCD(4, 0, String(F("4:   0.000s +.000000s   |               ")), 40);
+#else
+   _UpdateLCD(4, 0, String(F("4:   0.000s +.000000s   |       Box: -->")), 40);
+#endif
+}
+
+/// <summary>
+///   Switches between the detailed per dog view and the big team time view. The screen is
+///   cleared and all fields of the new view are drawn on the next call of Main().
+/// </summary>
+///
+/// <param name="NewDisplayMode">   The new display mode. </param>
+void LCDControllerClass::SetDisplayMode(DisplayModes NewDisplayMode) {
+   if (NewDisplayMode == _DisplayMode) {
+      return;
+   }
+
+   _DisplayMode = NewDisplayMode;
+   _LCD1->clear();
+   if (_DisplayMode == DETAILED) {
+      _DrawDetailedLayout();
+   } else {
+      //Nothing is shown yet, so every big digit has to be drawn
+      memset(_ShownBigDigits, 0, sizeof(_ShownBigDigits));
+   }
+   _LastLCDUpdate = millis() - _LCDUpdateInterval - 1;
+}
+
+/// <summary>
+///   Sets the team time which is shown in the big team time view.
+/// </summary>
+///
+/// <param name="TimeMillis">   The team time in milliseconds. </param>
+void LCDControllerClass::UpdateBigTime(unsigned long TimeMillis) {
+   //Big time format is "SSS.hh", leading zeros of the seconds are blanked
+   unsigned long Hundredths = (TimeMillis / 10) % 100000;
+   for (int8_t i = BIG_TIME_DIGITS - 1; i >= 0; i--) {
+      _BigDigits[i] = '0' + (Hundredths % 10);
+      Hundredths /= 10;
+   }
+   for (uint8_t i = 0; i < BIG_TIME_DIGITS - 3 && _BigDigits[i] == '0'; i++) {
+      _BigDigits[i] = ' ';
+   }
+}
+
+/// <summary>
+///   Draws the digits of the big team time which changed since they were last drawn. Digits are
+///   3 columns wide with 1 column spacing, the decimal point takes 1 column.
+/// </summary>
+void LCDControllerClass::_DrawBigTime() {
+   for (uint8_t i = 0; i < BIG_TIME_DIGITS; i++) {
+      if (_BigDigits[i] == _ShownBigDigits[i]) {
+         continue;
+      }
+
+      //The two decimals are behind the decimal point
+      uint8_t Position = BIG_TIME_POSITION + i * 4 + ((i >= BIG_TIME_DIGITS - 2) ? 2 : 0);
+      uint8_t Glyphs[6] = {' ', ' ', ' ', ' ', ' ', ' '};
+      if (_BigDigits[i] != ' ') {
+         memcpy_P(Glyphs, BigFontDigits[_BigDigits[i] - '0'], sizeof(Glyphs));
+      }
+
+      _LCD1->setCursor(Position, 1);
+      _LCD1->write(Glyphs[0]);
+      _LCD1->write(Glyphs[1]);
+      _LCD1->write(Glyphs[2]);
+      _LCD1->setCursor(Position, 2);
+      _LCD1->write(Glyphs[3]);
+      _LCD1->write(Glyphs[4]);
+      _LCD1->write(Glyphs[5]);
+
+      _ShownBigDigits[i] = _BigDigits[i];
+   }
+
+   //Decimal point, only needed once after the view was switched
+   if (_ShownBigDigits[BIG_TIME_DIGITS] != '.') {
+      _LCD1->setCursor(BIG_TIME_POSITION + (BIG_TIME_DIGITS - 2) * 4, 2);
+      _LCD1->write('.');
+      _ShownBigDigits[BIG_TIME_DIGITS] = '.';
+   }
 }
 
 /// <summary>
@@ -62,12 +205,22 @@ void LCDControllerClass::init(LiquidCrystal_I2C *LCD1) {
 ///   timeout, and if yes, it will update the LCD screen with the latest data.
 /// </summary>
 void LCDControllerClass::Main() {
+   //The big team time is updated more often, but only changed digits are sent to the LCD
+   if (_DisplayMode == BIG_TIME && (millis() - _LastBigTimeUpdate) > _BigTimeUpdateInterval) {
+      _DrawBigTime();
+      _LastBigTimeUpdate = millis();
+   }
+
    //This is the main loop which handles LCD updates
    if ((millis() - _LastLCDUpdate) > _LCDUpdateInterval)
    {
 
       for (const SLCDField &lcdField : _SLCDfieldFields)
       {
+         //Only fields of the active view are drawn
+         if (lcdField.Mode != _DisplayMode) {
+            continue;
+         }
          _UpdateLCD(lcdField.Line, lcdField.StartingPosition, lcdField.Text, lcdField.FieldLength);
       }
 
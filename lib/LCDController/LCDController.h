@@ -26,6 +26,14 @@ class LCDControllerClass {
  public:
 	void init(LiquidCrystal_I2C* LCD1);
    void Main();
+
+   enum DisplayModes {
+      DETAILED,   //Times of all dogs, crossings, team time etc.
+      BIG_TIME    //Team time in big digits, for use while racing
+   };
+   void SetDisplayMode(DisplayModes NewDisplayMode);
+   void UpdateBigTime(unsigned long TimeMillis);
+
    enum LCDFields {
       D1Time,
       D1RerunInfo,
@@ -43,23 +51,44 @@ class LCDControllerClass {
       BattLevel,
       TeamTime,
       TotalCrossTime,
-      BoxDirection
+      BoxDirection,     //With a box sensor: outrun, turn and return time of the last dog back
+      D1CrossClass,
+      D2CrossClass,
+      D3CrossClass,
+      D4CrossClass,
+      BigRunningDog,
+      BigDogPace,       //Last dog back against its average, e.g. "D2 +0.12"
+      BigProjectedTime, //Projected team time
+      BigBestDelta,     //Projected team time against the best heat
+      NUM_LCD_FIELDS
    };
 
    void UpdateField(LCDFields lcdfieldField, String NewValue);
 
 private:
    void _UpdateLCD(int Line, int Position, String Text, int FieldLength);
+   void _LoadBigFont();
+   void _DrawDetailedLayout();
+   void _DrawBigTime();
    LiquidCrystal_I2C* _LCD1;
    unsigned long _LastLCDUpdate = 0;
    unsigned int _LCDUpdateInterval = 500; //500ms update interval
+   DisplayModes _DisplayMode = DETAILED;
+
+   #define BIG_TIME_DIGITS 5
+   #define BIG_TIME_POSITION 9
+   char _BigDigits[BIG_TIME_DIGITS] = {' ', ' ', '0', '0', '0'};
+   char _ShownBigDigits[BIG_TIME_DIGITS + 1]; //Last entry tracks the decimal point
+   unsigned long _LastBigTimeUpdate = 0;
+   unsigned int _BigTimeUpdateInterval = 100; //100ms update interval for the big team time
 
    struct SLCDField {
       int Line;
       int StartingPosition;
       int FieldLength;
       String Text;
-   }_SLCDfieldFields[17];
+      DisplayModes Mode;
+   }_SLCDfieldFields[NUM_LCD_FIELDS];
 };
 
 extern LCDControllerClass LCDController;
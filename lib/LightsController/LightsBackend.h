@@ -0,0 +1,49 @@
+#ifndef _LIGHTSBACKEND_h
+#define _LIGHTSBACKEND_h
+
+#include "Arduino.h"
+
+#define NUM_LIGHTS 4
+
+#ifndef LIGHTS_FADE_TIME
+#define LIGHTS_FADE_TIME 0 //Default time (ms) a light takes to fade in or out, PWM backend only
+#endif
+
+/// <summary>
+///   Switches the lights. The default backend switches the pins with digitalWrite(). When built with
+///   LIGHTS_BACKEND_PWM, the timer PWM channels of the lights are driven directly, which adds
+///   brightness per light and fades stepped in the Timer1 overflow interrupt. Lights on pins
+///   without hardware PWM are switched on/off.
+/// </summary>
+class LightsBackendClass {
+   public:
+      void Init(const uint8_t *Pins);
+      void SetLight(uint8_t LightIndex, bool On);
+      void SetBrightness(uint8_t LightIndex, uint8_t Brightness);
+      void SetFadeTime(unsigned int FadeTime);
+
+#ifdef LIGHTS_BACKEND_PWM
+      void HandleTimerOverflow();
+      uint8_t GetDuty(uint8_t LightIndex);
+#endif
+
+   private:
+      uint8_t _Pins[NUM_LIGHTS];
+
+#ifdef LIGHTS_BACKEND_PWM
+      #define NO_PWM_CHANNEL 0xFF
+      uint8_t _PwmChannels[NUM_LIGHTS];
+      uint8_t _Brightness[NUM_LIGHTS];
+      uint8_t _TargetDuty[NUM_LIGHTS];
+      volatile uint16_t _Duty[NUM_LIGHTS];   //8.8 fixed point, so slow fades still move every step
+      uint16_t _FadeStep[NUM_LIGHTS];
+      unsigned int _FadeTime = LIGHTS_FADE_TIME;
+
+      void _StartFade(uint8_t LightIndex, uint8_t TargetDuty);
+      void _WriteDuty(uint8_t LightIndex);
+#endif
+};
+
+extern LightsBackendClass LightsBackend;
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef LIGHTS_BACKEND_PWM
+#include "LightsBackend.h"
+
+/// <summary>
+///   Initialises this object.
+/// </summary>
+///
+/// <param name="Pins">  The pins of the NUM_LIGHTS lights. </param>
+void LightsBackendClass::Init(const uint8_t *Pins) {
+   for (uint8_t LightIndex = 0; LightIndex < NUM_LIGHTS; LightIndex++) {
+      _Pins[LightIndex] = Pins[LightIndex];
+   }
+}
+
+void LightsBackendClass::SetLight(uint8_t LightIndex, bool On) {
+   digitalWrite(_Pins[LightIndex], On ? HIGH : LOW);
+}
+
+/// <summary>
+///   Brightness is not supported by this backend, lights are always fully on.
+/// </summary>
+void LightsBackendClass::SetBrightness(uint8_t LightIndex, uint8_t Brightness) {
+}
+
+/// <summary>
+///   Fades are not supported by this backend, lights always switch immediately.
+/// </summary>
+void LightsBackendClass::SetFadeTime(unsigned int FadeTime) {
+}
+
+LightsBackendClass LightsBackend;
+
+#endif
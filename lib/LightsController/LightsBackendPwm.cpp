@@ -0,0 +1,170 @@
+#ifdef LIGHTS_BACKEND_PWM
+#include "LightsBackend.h"
+#include <util/atomic.h>
+
+//Timer1 runs 8-bit phase correct PWM with prescaler 64 (Arduino default): 510 * 4us per overflow
+#define PWM_OVERFLOW_PERIOD 2040
+
+//Output compare channels of the light pins on the ATmega2560
+enum PwmChannels {
+   PWM_OC0B,   //Pin 4, Timer0 (fast PWM, also used by millis())
+   PWM_OC1A,   //Pin 11
+   PWM_OC1B,   //Pin 12
+   PWM_OC3A    //Pin 5
+};
+static const uint8_t PwmChannelPins[] = {4, 11, 12, 5};
+
+/// <summary>
+///   Initialises this object. Lights start OFF at full brightness.
+/// </summary>
+///
+/// <param name="Pins">  The pins of the NUM_LIGHTS lights. </param>
+void LightsBackendClass::Init(const uint8_t *Pins) {
+   for (uint8_t LightIndex = 0; LightIndex < NUM_LIGHTS; LightIndex++) {
+      _Pins[LightIndex] = Pins[LightIndex];
+      _PwmChannels[LightIndex] = NO_PWM_CHANNEL;
+      for (uint8_t Channel = 0; Channel < sizeof(PwmChannelPins); Channel++) {
+         if (PwmChannelPins[Channel] == Pins[LightIndex]) {
+            _PwmChannels[LightIndex] = Channel;
+         }
+      }
+
+      _Brightness[LightIndex] = 255;
+      _TargetDuty[LightIndex] = 0;
+      _Duty[LightIndex] = 0;
+      //The pin is low whenever the PWM output is disconnected
+      digitalWrite(_Pins[LightIndex], LOW);
+      _WriteDuty(LightIndex);
+   }
+}
+
+void LightsBackendClass::SetLight(uint8_t LightIndex, bool On) {
+   _StartFade(LightIndex, On ? _Brightness[LightIndex] : 0);
+}
+
+/// <summary>
+///   Sets the brightness of a light, a light which is on fades to the new brightness.
+/// </summary>
+///
+/// <param name="LightIndex">  Zero-based index of the light. </param>
+/// <param name="Brightness">  The brightness, 0 (off) to 255 (fully on). </param>
+void LightsBackendClass::SetBrightness(uint8_t LightIndex, uint8_t Brightness) {
+   _Brightness[LightIndex] = Brightness;
+   if (_TargetDuty[LightIndex] > 0) {
+      _StartFade(LightIndex, Brightness);
+   }
+}
+
+/// <summary>
+///   Sets the time a light takes to fade in or out. 0 switches lights immediately.
+/// </summary>
+///
+/// <param name="FadeTime">  The fade time in milliseconds. </param>
+void LightsBackendClass::SetFadeTime(unsigned int FadeTime) {
+   _FadeTime = FadeTime;
+}
+
+/// <summary>
+///   Gets the duty cycle currently written to a light, 0 to 255.
+/// </summary>
+uint8_t LightsBackendClass::GetDuty(uint8_t LightIndex) {
+   uint16_t Duty;
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      Duty = _Duty[LightIndex];
+   }
+   return Duty >> 8;
+}
+
+/// <summary>
+///   Moves every fading light one step closer to its target duty cycle, should be called from the
+///   Timer1 overflow interrupt. The interrupt is disabled again once all fades are done, so lights
+///   which don't fade cost no CPU time.
+/// </summary>
+void LightsBackendClass::HandleTimerOverflow() {
+   bool Fading = false;
+
+   for (uint8_t LightIndex = 0; LightIndex < NUM_LIGHTS; LightIndex++) {
+      uint16_t Target = (uint16_t)_TargetDuty[LightIndex] << 8;
+      uint16_t Duty = _Duty[LightIndex];
+      if (Duty == Target) {
+         continue;
+      }
+
+      if (Duty < Target) {
+         Duty = (Target - Duty > _FadeStep[LightIndex]) ? Duty + _FadeStep[LightIndex] : Target;
+      } else {
+         Duty = (Duty - Target > _FadeStep[LightIndex]) ? Duty - _FadeStep[LightIndex] : Target;
+      }
+      _Duty[LightIndex] = Duty;
+      _WriteDuty(LightIndex);
+      Fading |= (Duty != Target);
+   }
+
+   if (!Fading) {
+      TIMSK1 &= ~_BV(TOIE1);
+   }
+}
+
+/// <summary>
+///   Starts a fade of a light to the given duty cycle, or sets it immediately when the fade time is 0.
+///   Lights on pins without PWM are switched on for any duty cycle above 0.
+/// </summary>
+void LightsBackendClass::_StartFade(uint8_t LightIndex, uint8_t TargetDuty) {
+   if (_PwmChannels[LightIndex] == NO_PWM_CHANNEL) {
+      _TargetDuty[LightIndex] = TargetDuty;
+      digitalWrite(_Pins[LightIndex], (TargetDuty > 0) ? HIGH : LOW);
+      return;
+   }
+
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      _TargetDuty[LightIndex] = TargetDuty;
+      uint16_t Target = (uint16_t)TargetDuty << 8;
+
+      if (_FadeTime == 0) {
+         _Duty[LightIndex] = Target;
+         _WriteDuty(LightIndex);
+      } else {
+         uint16_t Distance = (Target > _Duty[LightIndex]) ? Target - _Duty[LightIndex] : _Duty[LightIndex] - Target;
+         unsigned long Steps = ((unsigned long)_FadeTime * 1000) / PWM_OVERFLOW_PERIOD;
+         _FadeStep[LightIndex] = (Steps > 0 && Distance / Steps > 0) ? Distance / Steps : 1;
+         TIMSK1 |= _BV(TOIE1);
+      }
+   }
+}
+
+/// <summary>
+///   Writes the duty cycle of a light to its output compare register. At 0 the output is
+///   disconnected from the timer, since fast PWM would still give a short pulse every period.
+/// </summary>
+void LightsBackendClass::_WriteDuty(uint8_t LightIndex) {
+   uint8_t Duty = _Duty[LightIndex] >> 8;
+
+   switch (_PwmChannels[LightIndex]) {
+      case PWM_OC0B:
+         OCR0B = Duty;
+         TCCR0A = (Duty > 0) ? (TCCR0A | _BV(COM0B1)) : (TCCR0A & ~_BV(COM0B1));
+         break;
+      case PWM_OC1A:
+         OCR1A = Duty;
+         TCCR1A = (Duty > 0) ? (TCCR1A | _BV(COM1A1)) : (TCCR1A & ~_BV(COM1A1));
+         break;
+      case PWM_OC1B:
+         OCR1B = Duty;
+         TCCR1A = (Duty > 0) ? (TCCR1A | _BV(COM1B1)) : (TCCR1A & ~_BV(COM1B1));
+         break;
+      case PWM_OC3A:
+         OCR3A = Duty;
+         TCCR3A = (Duty > 0) ? (TCCR3A | _BV(COM3A1)) : (TCCR3A & ~_BV(COM3A1));
+         break;
+      default:
+         break;
+   }
+}
+
+ISR(TIMER1_OVF_vect) {
+   LightsBackend.HandleTimerOverflow();
+}
+
+LightsBackendClass LightsBackend;
+
+#endif
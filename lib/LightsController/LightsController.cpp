@@ -1,59 +1,190 @@
 #include "LightsController.h"
 #include "RaceHandler.h"
 
+//Light programs, see LightsController.h for the format
+#define LIGHT_TICKS(Milliseconds) ((Milliseconds) / LIGHT_TICK_LENGTH)
+#define START_LIGHT_TICKS LIGHT_TICKS(RaceRules::StartLightInterval)
+
+static const uint8_t StartSequenceProgram[] PROGMEM = {
+   LIGHT_ALL, 0,
+   LIGHT_RED, START_LIGHT_TICKS,
+   LIGHT_YELLOW1, START_LIGHT_TICKS,
+   LIGHT_YELLOW2, START_LIGHT_TICKS,
+   LIGHT_GREEN | LIGHT_STEP_GREEN, START_LIGHT_TICKS,
+   0, 0
+};
+
+static const uint8_t FaultFlashProgram[] PROGMEM = {
+   LIGHT_STEP_TARGET, 0,
+   LIGHT_STEP_TARGET, LIGHT_TICKS(200),
+   0, LIGHT_TICKS(200),
+   LIGHT_STEP_TARGET, LIGHT_TICKS(200),
+   0, LIGHT_TICKS(200),
+   LIGHT_STEP_TARGET, LIGHT_TICKS(200),
+   0, LIGHT_TICKS(200),
+   0, 0
+};
+
+static const uint8_t RerunPendingProgram[] PROGMEM = {
+   LIGHT_STEP_TARGET, LIGHT_PROGRAM_LOOP,
+   LIGHT_STEP_TARGET, LIGHT_TICKS(100),
+   0, LIGHT_TICKS(1900),
+   0, 0
+};
+
+static const uint8_t RaceCompleteProgram[] PROGMEM = {
+   LIGHT_ALL, 0,
+   LIGHT_ALL, LIGHT_TICKS(500),
+   0, LIGHT_TICKS(500),
+   LIGHT_ALL, LIGHT_TICKS(500),
+   0, LIGHT_TICKS(500),
+   LIGHT_ALL, LIGHT_TICKS(500),
+   0, 0
+};
+
+static const uint8_t FalseStartProgram[] PROGMEM = {
+   LIGHT_RED, 0,
+   LIGHT_RED, LIGHT_TICKS(100),
+   0, LIGHT_TICKS(100),
+   LIGHT_RED, LIGHT_TICKS(100),
+   0, LIGHT_TICKS(100),
+   LIGHT_RED, LIGHT_TICKS(100),
+   0, LIGHT_TICKS(100),
+   LIGHT_RED, LIGHT_TICKS(100),
+   0, LIGHT_TICKS(100),
+   LIGHT_RED, LIGHT_TICKS(100),
+   0, LIGHT_TICKS(100),
+   0, 0
+};
+
+static const uint8_t *const LightProgramTable[] = {
+   StartSequenceProgram,
+   FaultFlashProgram,
+   RerunPendingProgram,
+   RaceCompleteProgram,
+   FalseStartProgram
+};
+
 void LightsControllerClass::Init(
    uint8_t LIGHT_1_PIN,
    uint8_t LIGHT_2_PIN,
    uint8_t LIGHT_3_PIN,
    uint8_t LIGHT_4_PIN
 ) {
-   _LIGHT_1_PIN = LIGHT_1_PIN;
-   _LIGHT_2_PIN = LIGHT_2_PIN;
-   _LIGHT_3_PIN = LIGHT_3_PIN;
-   _LIGHT_4_PIN = LIGHT_4_PIN;
+   _LightPins[0] = LIGHT_1_PIN;
+   _LightPins[1] = LIGHT_2_PIN;
+   _LightPins[2] = LIGHT_3_PIN;
+   _LightPins[3] = LIGHT_4_PIN;
+   LightsBackend.Init(_LightPins);
+   ResetLights();
 }
 
+/// <summary>
+///   Main entry-point for this object, should be called once every main loop. Advances each light
+///   channel by at most one step, so the time spent here does not depend on the program length.
+/// </summary>
 void LightsControllerClass::Main() {
-   HandleStartSequence();
+   unsigned long Now = millis();
+   bool StepChanged = false;
 
-   //Check if we have to toggle any lights
-   for (int i = 0; i < 4; i++) {
-      if (millis() >= _LightsOnSchedule[i] && _LightsOnSchedule[i] != 0) {
-         SetLightState(i, ON);
-         _LightsOnSchedule[i] = 0; // Mark as schedule done
+   for (uint8_t ChannelIndex = 0; ChannelIndex < NUM_LIGHT_CHANNELS; ChannelIndex++) {
+      LightChannel &Channel = _Channels[ChannelIndex];
+      if (Channel.Program == NULL || (Now - Channel.StepStartTime) < Channel.StepDuration) {
+         continue;
       }
 
-      if (millis() >= _LightsOffSchedule[i] && _LightsOffSchedule[i] != 0) {
-         SetLightState(i, OFF);
-         _LightsOffSchedule[i] = 0; // Mark as schedule done
-      }
+      //Next step starts when the previous one should have ended, so the timing does not drift
+      Channel.StepStartTime += Channel.StepDuration;
+      Channel.Step++;
+      _LoadStep(Channel);
+      StepChanged = true;
+   }
+
+   if (StepChanged) {
+      _UpdateLights();
    }
 }
 
 /// <summary>
 ///   Initiate start sequence, should be called if starting lights sequence should be initiated.
+///   The race timers are started as soon as the GREEN light comes on.
 /// </summary>
 void LightsControllerClass::InitiateStartSequence() {
-   OverallState = STARTING;
+   RunProgram(START_SEQUENCE);
 }
 
 /// <summary>
-///   Deletes any scheduled light timings.
+///   Runs a light program once. Start sequence and race complete run on the main channel, the other
+///   programs on the indication channel, where they temporarily take over the lights they use.
 /// </summary>
-void LightsControllerClass::DeleteSchedules() {
-   //Delete any set schedules
-   for (int lightIndex = 0; lightIndex < 4; lightIndex++) {
-      _LightsOnSchedule[lightIndex] = 0;  //Delete schedule
-      _LightsOffSchedule[lightIndex] = 0; //Delete schedule
+///
+/// <param name="Program">       The program to run. </param>
+/// <param name="TargetLight">   Zero-based index of the light used for LIGHT_STEP_TARGET steps. </param>
+void LightsControllerClass::RunProgram(LightPrograms Program, uint8_t TargetLight) {
+   _StartProgram(_Channels[_GetChannel(Program)], Program, TargetLight);
+   _UpdateLights();
+}
+
+/// <summary>
+///   Sets the program which the indication channel runs whenever no other indication is running,
+///   this should be a looping program.
+/// </summary>
+///
+/// <param name="Program">       The program to run. </param>
+/// <param name="TargetLight">   Zero-based index of the light used for LIGHT_STEP_TARGET steps. </param>
+void LightsControllerClass::SetBackgroundProgram(LightPrograms Program, uint8_t TargetLight) {
+   LightChannel &Channel = _Channels[INDICATION_CHANNEL];
+   //Setting the program which already runs doesn't restart it
+   if (Channel.BackgroundProgram == Program && Channel.BackgroundTarget == TargetLight) {
+      return;
+   }
+   Channel.BackgroundProgram = Program;
+   Channel.BackgroundTarget = TargetLight;
+
+   //Don't interrupt a one-time indication, the background program starts when it is finished
+   if (Channel.Program == NULL || Channel.Background) {
+      _StartProgram(Channel, Program, TargetLight);
+      _UpdateLights();
    }
 }
 
+/// <summary>
+///   Removes the background program of the indication channel.
+/// </summary>
+void LightsControllerClass::ClearBackgroundProgram() {
+   LightChannel &Channel = _Channels[INDICATION_CHANNEL];
+   if (Channel.Background) {
+      _StopChannel(Channel);
+   }
+   Channel.BackgroundProgram = NO_PROGRAM;
+   _UpdateLights();
+}
+
+/// <summary>
+///   Stops all running light programs, including the start sequence.
+/// </summary>
+void LightsControllerClass::StopPrograms() {
+   for (uint8_t ChannelIndex = 0; ChannelIndex < NUM_LIGHT_CHANNELS; ChannelIndex++) {
+      _Channels[ChannelIndex].BackgroundProgram = NO_PROGRAM;
+      _StopChannel(_Channels[ChannelIndex]);
+   }
+   _UpdateLights();
+}
+
 /// <summary>
 ///   Resets the lights (turn everything OFF).
 /// </summary>
 void LightsControllerClass::ResetLights() {
-   OverallState = STOP;
-   DeleteSchedules();
+   StopPrograms();
+   _LightStates = 0xFF; //Force all pins to be written
+   _UpdateLights();
+}
+
+/// <summary>
+///   Flashes the RED light to show the first dog started before the GREEN light.
+/// </summary>
+void LightsControllerClass::ShowFalseStart() {
+   RunProgram(FALSE_START_FLASH);
 }
 
 /// <summary>
@@ -70,13 +201,13 @@ String RaceHandlerClass::GetRaceStateString() {
    
    switch (RaceState) {
       case RaceHandlerClass::STOP:
-         strRaceState = " STOP";
+         strRaceState = F(" STOP");
          break;
       case RaceHandlerClass::STARTING:
-         strRaceState = " STARTING";
+         strRaceState = F(" STARTING");
          break;
       case RaceHandlerClass::RACING:
-         strRaceState = "RACING";
+         strRaceState = F("RACING");
          break;
       default:
          break;
@@ -86,82 +217,121 @@ String RaceHandlerClass::GetRaceStateString() {
 }
 
 /// <summary>
-///   Handles the start sequence, will be called by main function when oceral race state is
-///   STARTING.
+///   Gets the current state of a light.
 /// </summary>
-void LightsControllerClass::HandleStartSequence() {
-   //This function takes care of the starting lights sequence
-   //First check if the overall state of this class is 'STARTING'
+LightsControllerClass::LightStates LightsControllerClass::CheckLightState(int LightIndex) {
+   return (_LightStates & (1 << LightIndex)) ? ON : OFF;
+}
 
-   if (OverallState != STARTING) {
-      return;
+/// <summary>
+///   Set a given light to a given state.
+/// </summary>
+void LightsControllerClass::SetLightState(int LightIndex, LightStates LightState) {
+   LightsBackend.SetLight(LightIndex, LightState == ON);
+}
+
+/// <summary>
+///   Sets the brightness of all lights (e.g. brighter outdoors than indoors). Only has effect when
+///   the PWM lights backend is used.
+/// </summary>
+///
+/// <param name="Brightness">  The brightness, 0 (off) to 255 (fully on). </param>
+void LightsControllerClass::SetBrightness(uint8_t Brightness) {
+   for (uint8_t LightIndex = 0; LightIndex < NUM_LIGHTS; LightIndex++) {
+      SetBrightness(LightIndex, Brightness);
    }
-   
-   //The class is in the 'STARTING' state, check if the lights have been programmed yet
-   if (!_StartSequenceStarted) { 
-      //Start sequence is not yet started, we need to schedule the lights on/off times
+}
 
-      //Set schedule for RED light
-      _LightsOnSchedule[0] = millis();         //Turn on NOW
-      _LightsOffSchedule[0] = millis() + _msBetweenLights; //keep on for 1 second
+/// <summary>
+///   Sets the brightness of one light, see SetBrightness(Brightness).
+/// </summary>
+void LightsControllerClass::SetBrightness(uint8_t LightIndex, uint8_t Brightness) {
+   LightsBackend.SetBrightness(LightIndex, Brightness);
+}
 
-      //Set schedule for YELLOW1 light
-      _LightsOnSchedule[1] = millis() + _msBetweenLights;  //Turn on after 1 second
-      _LightsOffSchedule[1] = millis() + (2 * _msBetweenLights); //Turn off after 2 seconds
+/// <summary>
+///   Starts a program on a channel.
+/// </summary>
+void LightsControllerClass::_StartProgram(LightChannel &Channel, LightPrograms Program, uint8_t TargetLight) {
+   Channel.Program = LightProgramTable[Program];
+   Channel.Background = (Program == Channel.BackgroundProgram);
+   Channel.Target = TargetLight;
+   Channel.Step = 0;
+   Channel.StepStartTime = millis();
 
-      //Set schedule for YELLOW2 light
-      _LightsOnSchedule[2] = millis() + (2 * _msBetweenLights);  //Turn on after 2 seconds
-      _LightsOffSchedule[2] = millis() + (3 * _msBetweenLights); //Turn off after 3 seconds
+   //Header: lights used by the program and program flags
+   uint8_t UsedLights = pgm_read_byte(&Channel.Program[0]);
+   Channel.UsedLights = (UsedLights & LIGHT_STEP_TARGET) ? (1 << TargetLight) : (UsedLights & LIGHT_ALL);
+   Channel.Loop = (pgm_read_byte(&Channel.Program[1]) & LIGHT_PROGRAM_LOOP);
+   _LoadStep(Channel);
+}
 
-      //Set schedule for GREEN light
-      _LightsOnSchedule[3] = millis() + (3 * _msBetweenLights);  //Turn on after 3 seconds
-      _LightsOffSchedule[3] = millis() + (4 * _msBetweenLights); //Turn off after 4 seconds
+void LightsControllerClass::_StopChannel(LightChannel &Channel) {
+   Channel.Program = NULL;
+   Channel.Background = false;
+   Channel.UsedLights = 0;
+   Channel.Lights = 0;
+}
 
-      _StartSequenceStarted = true;
-   }
-   
-   //Check if the start sequence is busy
-   bool StartSequenceBusy = false;
-   for (int i = 0; i < 4; i++) {
-      // check if any schedule is not yet done
-      if (_LightsOnSchedule[i] > 0 || _LightsOffSchedule[i] > 0) {
-         StartSequenceBusy = true;
-      }
-   }
+/// <summary>
+///   Reads the current step of the program running on a channel. At the end of the program the
+///   program is restarted (looping programs), the background program is started, or the channel
+///   stops.
+/// </summary>
+void LightsControllerClass::_LoadStep(LightChannel &Channel) {
+   //Step 0 is the header
+   const uint8_t *Step = &Channel.Program[(Channel.Step + 1) * 2];
+   uint8_t Ticks = pgm_read_byte(&Step[1]);
 
-   //Check if we should start the timer (GREEN light on and race is still in STARTING state)
-   if (_LightsOnSchedule[3] == 0 && RaceHandler.RaceState == RaceHandler.STARTING) {
-      RaceHandler.StartTimers();
-      Serial.println("GREEN light is ON!");
+   if (Ticks == 0) {
+      if (Channel.Loop) {
+         Channel.Step = 0;
+         Step = &Channel.Program[2];
+         Ticks = pgm_read_byte(&Step[1]);
+      } else if (Channel.BackgroundProgram != NO_PROGRAM) {
+         _StartProgram(Channel, Channel.BackgroundProgram, Channel.BackgroundTarget);
+         return;
+      } else {
+         _StopChannel(Channel);
+         return;
+      }
    }
 
-   if (!StartSequenceBusy) {
-      _StartSequenceStarted = false;
-      OverallState = RACING;
-   }
+   uint8_t Mask = pgm_read_byte(&Step[0]);
+   Channel.Lights = (Mask & LIGHT_STEP_TARGET) ? (1 << Channel.Target) : (Mask & LIGHT_ALL);
+   Channel.StepDuration = (unsigned long)Ticks * LIGHT_TICK_LENGTH;
+   Channel.GreenStep = (Mask & LIGHT_STEP_GREEN);
 }
 
 /// <summary>
-///   Set a given light to a given state.
+///   Writes the combined state of all channels to the lights. The indication channel overrides the
+///   main channel for the lights it uses. Only lights which change are written.
 /// </summary>
-void LightsControllerClass::SetLightState(int LightIndex, LightStates LightState) {
-   bool stateToSet = 0;
+void LightsControllerClass::_UpdateLights() {
+   LightChannel &Main = _Channels[MAIN_CHANNEL];
+   LightChannel &Indication = _Channels[INDICATION_CHANNEL];
+   uint8_t NewLightStates = (Main.Lights & ~Indication.UsedLights) | Indication.Lights;
+   uint8_t ChangedLights = NewLightStates ^ _LightStates;
 
-   if (LightState == ON) {
-      stateToSet = 1;
-   } else if (LightState == OFF) {
-      stateToSet = 0;
+   for (uint8_t LightIndex = 0; LightIndex < NUM_LIGHTS; LightIndex++) {
+      if (ChangedLights & (1 << LightIndex)) {
+         SetLightState(LightIndex, (NewLightStates & (1 << LightIndex)) ? ON : OFF);
+      }
    }
+   _LightStates = NewLightStates;
 
-   if (LightIndex == 0) {
-      digitalWrite(_LIGHT_1_PIN, stateToSet);
-   } else if (LightIndex == 1) {
-      digitalWrite(_LIGHT_2_PIN, stateToSet);
-   }  else if (LightIndex == 2) {
-      digitalWrite(_LIGHT_3_PIN, stateToSet);
-   }  else if (LightIndex == 3) {
-      digitalWrite(_LIGHT_4_PIN, stateToSet);
+   //Start the race the moment the GREEN light is on
+   if (Main.GreenStep) {
+      Main.GreenStep = false;
+      RaceHandler.StartTimers(micros());
    }
 }
 
-LightsControllerClass LightsController;
\ No newline at end of file
+/// <summary>
+///   Gets the channel a program runs on.
+/// </summary>
+uint8_t LightsControllerClass::_GetChannel(LightPrograms Program) {
+   return (Program == START_SEQUENCE || Program == RACE_COMPLETE) ? MAIN_CHANNEL : INDICATION_CHANNEL;
+}
+
+LightsControllerClass LightsController;
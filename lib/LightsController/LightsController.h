@@ -3,12 +3,30 @@
 
 #include "Arduino.h"
 #include "Structs.h"
+#include "LightsBackend.h"
 
+//Light bits in light program steps
+#define LIGHT_RED       0x01
+#define LIGHT_YELLOW1   0x02
+#define LIGHT_YELLOW2   0x04
+#define LIGHT_GREEN     0x08
+#define LIGHT_ALL       0x0F
+#define LIGHT_STEP_TARGET 0x40   //Use the target light given when the program was started
+#define LIGHT_STEP_GREEN  0x80   //Start the race timers when this step starts
+#define LIGHT_PROGRAM_LOOP 0x01
+#define LIGHT_TICK_LENGTH 50     //ms per duration tick
+
+/// <summary>
+///   Drives the four lights with small light programs stored in PROGMEM. A program is a header
+///   (lights used, flags) followed by steps of 2 bytes: the lights which are on, and the duration
+///   in LIGHT_TICK_LENGTH ticks. A step with duration 0 ends the program. There are two channels:
+///   the main channel (start sequence, race complete) and the indication channel (faults, reruns,
+///   false start) which overrides the main channel for the lights it uses.
+/// </summary>
 class LightsControllerClass {
    public:
       void Main();
       void Init(uint8_t LIGHT_1_PIN,  uint8_t LIGHT_2_PIN, uint8_t LIGHT_3_PIN, uint8_t LIGHT_4_PIN);
-      void HandleStartSequence();
 
       enum LightStates {
          OFF,
@@ -16,31 +34,55 @@ class LightsControllerClass {
       };
       LightStates CheckLightState(int LightIndex);
       void SetLightState(int LightIndex, LightStates LightState);
+      void SetBrightness(uint8_t Brightness);
+      void SetBrightness(uint8_t LightIndex, uint8_t Brightness);
 
-      void InitiateStartSequence();
-      
-      enum OverallStates {
-         STARTING,
-         RACING,
-         STOP
+      enum LightPrograms {
+         START_SEQUENCE,      //RED, YELLOW1, YELLOW2, GREEN, starts the race timers on GREEN
+         FAULT_FLASH,         //Three quick flashes of the target light
+         RERUN_PENDING,       //Short blink of the target light every 2 seconds, loops
+         RACE_COMPLETE,       //All lights flash three times
+         FALSE_START_FLASH,   //Five quick flashes of the RED light
+         NO_PROGRAM
       };
-      OverallStates OverallState = STOP;
 
-      void DeleteSchedules();
+      void InitiateStartSequence();
+      void RunProgram(LightPrograms Program, uint8_t TargetLight = 0);
+      void SetBackgroundProgram(LightPrograms Program, uint8_t TargetLight);
+      void ClearBackgroundProgram();
+      void StopPrograms();
       void ResetLights();
+      void ShowFalseStart();
 
-   private: 
-      unsigned long _LightsOnSchedule[4];
-      unsigned long _LightsOffSchedule[4];
-      uint8_t _LIGHT_1_PIN;
-      uint8_t _LIGHT_2_PIN;
-      uint8_t _LIGHT_3_PIN;
-      uint8_t _LIGHT_4_PIN;
+   private:
+      #define NUM_LIGHT_CHANNELS 2
+      #define MAIN_CHANNEL 0
+      #define INDICATION_CHANNEL 1
 
-      bool _StartSequenceStarted = false;
+      struct LightChannel {
+         const uint8_t *Program;          //PROGMEM, NULL if the channel is idle
+         uint8_t Step;
+         uint8_t Target;
+         uint8_t UsedLights;
+         uint8_t Lights;                  //Lights which are on in the current step
+         bool Loop;
+         bool GreenStep;
+         bool Background;                 //True if the background program is running
+         unsigned long StepStartTime;
+         unsigned long StepDuration;
+         LightPrograms BackgroundProgram;
+         uint8_t BackgroundTarget;
+      };
 
+      uint8_t _LightPins[NUM_LIGHTS];
+      LightChannel _Channels[NUM_LIGHT_CHANNELS];
+      uint8_t _LightStates = 0;
 
-      int _msBetweenLights = 1000;
+      void _StartProgram(LightChannel &Channel, LightPrograms Program, uint8_t TargetLight);
+      void _StopChannel(LightChannel &Channel);
+      void _LoadStep(LightChannel &Channel);
+      void _UpdateLights();
+      static uint8_t _GetChannel(LightPrograms Program);
 };
 
 extern LightsControllerClass LightsController;
@@ -0,0 +1,91 @@
+#include "MemoryMonitor.h"
+#include <Telemetry.h>
+
+#define STACK_PAINT_PATTERN 0xC5
+
+extern uint8_t _end;             //End of .bss, start of the heap
+extern uint8_t __stack;          //Top of the stack (RAMEND)
+extern char *__brkval;           //Top of the heap, 0 if malloc() was never used
+
+static void PaintStack() __attribute__((naked, used, section(".init1")));
+
+/// <summary>
+///   Fills all SRAM between the end of .bss and the top of the stack with STACK_PAINT_PATTERN.
+///   Runs from the .init1 section, before the stack is used and before any constructor runs, so
+///   it is written in assembly and may not call anything.
+/// </summary>
+static void PaintStack() {
+   __asm volatile(
+      "    ldi r30, lo8(_end)\n"
+      "    ldi r31, hi8(_end)\n"
+      "    ldi r24, %0\n"
+      "    ldi r25, hi8(__stack)\n"
+      "    rjmp 2f\n"
+      "1:\n"
+      "    st Z+, r24\n"
+      "2:\n"
+      "    cpi r30, lo8(__stack)\n"
+      "    cpc r31, r25\n"
+      "    brlo 1b\n"
+      "    breq 1b\n"
+      :: "M" (STACK_PAINT_PATTERN));
+}
+
+/// <summary>
+///   Gets the top of the heap.
+/// </summary>
+static uint8_t *GetHeapEnd() {
+   return (__brkval == 0) ? &_end : (uint8_t *)__brkval;
+}
+
+/// <summary>
+///   Gets the number of bytes between the top of the heap and the current stack pointer.
+/// </summary>
+unsigned int MemoryMonitorClass::GetFreeMemory() {
+   uint8_t StackTop;
+   return &StackTop - GetHeapEnd();
+}
+
+/// <summary>
+///   Gets the number of bytes above the heap which were never written since startup. This is the
+///   smallest distance there ever was between the heap and the stack.
+/// </summary>
+unsigned int MemoryMonitorClass::GetUntouchedMemory() {
+   const uint8_t *Address = GetHeapEnd();
+   unsigned int Untouched = 0;
+
+   while (Address <= &__stack && *Address == STACK_PAINT_PATTERN) {
+      Address++;
+      Untouched++;
+   }
+   return Untouched;
+}
+
+/// <summary>
+///   Gets the deepest the stack has been since startup, in bytes.
+/// </summary>
+unsigned int MemoryMonitorClass::GetStackHighWaterMark() {
+   return (&__stack - GetHeapEnd()) + 1 - GetUntouchedMemory();
+}
+
+/// <summary>
+///   Gets the current size of the heap (String buffers) in bytes.
+/// </summary>
+unsigned int MemoryMonitorClass::GetHeapSize() {
+   return GetHeapEnd() - &_end;
+}
+
+/// <summary>
+///   Sends a MEM telemetry frame: free memory now, untouched memory, stack high water mark and
+///   heap size, all in bytes.
+/// </summary>
+void MemoryMonitorClass::SendReport() {
+   Telemetry.BeginFrame(F("MEM"));
+   Telemetry.AddField(GetFreeMemory());
+   Telemetry.AddField(GetUntouchedMemory());
+   Telemetry.AddField(GetStackHighWaterMark());
+   Telemetry.AddField(GetHeapSize());
+   Telemetry.EndFrame();
+}
+
+MemoryMonitorClass MemoryMonitor;
@@ -0,0 +1,22 @@
+#ifndef _MEMORYMONITOR_h
+#define _MEMORYMONITOR_h
+
+#include "Arduino.h"
+
+/// <summary>
+///   Keeps track of how much SRAM is left between the heap and the stack. At startup (before
+///   main()) all free SRAM is painted with a fixed pattern, the part of it which is still intact
+///   shows how close the stack and heap ever came to each other.
+/// </summary>
+class MemoryMonitorClass {
+   public:
+      unsigned int GetFreeMemory();
+      unsigned int GetUntouchedMemory();
+      unsigned int GetStackHighWaterMark();
+      unsigned int GetHeapSize();
+      void SendReport();
+};
+
+extern MemoryMonitorClass MemoryMonitor;
+
+#endif
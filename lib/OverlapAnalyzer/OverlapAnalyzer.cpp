@@ -0,0 +1,179 @@
+#include "OverlapAnalyzer.h"
+
+/// <summary>
+///   Forgets all profiles, called for every new race since the team may have changed.
+/// </summary>
+void OverlapAnalyzerClass::Reset() {
+   memset(_Profiles, 0, sizeof(_Profiles));
+   _LastProfile.Valid = false;
+   StartWindow();
+}
+
+/// <summary>
+///   Starts a new gate window, called when the gates are clear.
+/// </summary>
+void OverlapAnalyzerClass::StartWindow() {
+   _SeenBreaks = 0;
+   _SeenRestores = 0;
+}
+
+/// <summary>
+///   Adds a sensor edge of the current gate window.
+/// </summary>
+///
+/// <param name="SensorNumber"> The sensor number (1-2). </param>
+/// <param name="SensorState">  The sensor state, 1 if the beam was broken. </param>
+/// <param name="TriggerTime">  The trigger time in microseconds. </param>
+void OverlapAnalyzerClass::AddEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime) {
+   if (SensorNumber < 1 || SensorNumber > 2) {
+      return;
+   }
+   uint8_t Sensor = SensorNumber - 1;
+
+   if (_SeenBreaks == 0 && _SeenRestores == 0) {
+      _WindowStart = TriggerTime;
+      _FirstSensor = Sensor;
+   }
+   long Time = TriggerTime - _WindowStart;
+
+   if (SensorState) {
+      if (!(_SeenBreaks & _BV(Sensor))) {
+         _FirstBreak[Sensor] = Time;
+         _SeenBreaks |= _BV(Sensor);
+      }
+   } else {
+      _LastRestore[Sensor] = Time;
+      _SeenRestores |= _BV(Sensor);
+   }
+}
+
+/// <summary>
+///   Stores the current gate window as the profile of a dog, the window must be a clean pass
+///   (ABab or BAba).
+/// </summary>
+///
+/// <param name="DogIndex">   Zero-based index of the dog which passed. </param>
+void OverlapAnalyzerClass::RecordCleanPass(uint8_t DogIndex) {
+   if (DogIndex >= RaceRules::DogsPerTeam || _SeenBreaks != 0x03 || _SeenRestores != 0x03) {
+      return;
+   }
+
+   uint8_t First = _FirstSensor;
+   uint8_t Second = 1 - First;
+   PassProfile Profile;
+   Profile.Valid = true;
+   Profile.Gap = _FirstBreak[Second] - _FirstBreak[First];
+   Profile.FirstOccluded = _LastRestore[First] - _FirstBreak[First];
+   Profile.SecondOccluded = _LastRestore[Second] - _FirstBreak[Second];
+   _Profiles[DogIndex] = Profile;
+   _LastProfile = Profile;
+}
+
+/// <summary>
+///   Gets the delays between both beams in the current gate window, from the beam broken first to
+///   the other beam.
+/// </summary>
+///
+/// <param name="BreakDelay">    [out] Time between both beam breaks in microseconds. </param>
+/// <param name="RestoreDelay">  [out] Time between both beam restores in microseconds, negative if
+///                              the beam broken first was restored last. </param>
+///
+/// <returns>
+///   true if both beams were broken and restored in the window.
+/// </returns>
+bool OverlapAnalyzerClass::GetBeamDelays(long &BreakDelay, long &RestoreDelay) {
+   if (_SeenBreaks != 0x03 || _SeenRestores != 0x03) {
+      return false;
+   }
+
+   uint8_t First = _FirstSensor;
+   uint8_t Second = 1 - First;
+   BreakDelay = _FirstBreak[Second] - _FirstBreak[First];
+   RestoreDelay = _LastRestore[Second] - _LastRestore[First];
+   return true;
+}
+
+/// <summary>
+///   Estimates the crossing time of a pass-over in the current gate window.
+/// </summary>
+///
+/// <param name="ReturningDogIndex">   Zero-based index of the dog coming back. </param>
+/// <param name="EnteringDogIndex">    Zero-based index of the dog going in. </param>
+/// <param name="CrossingTime">        [out] The estimated crossing time in microseconds, negative if
+///                                     the entering dog was early. </param>
+///
+/// <returns>
+///   true if the crossing time could be estimated, false if there are no profiles or the window
+///   doesn't look like a pass-over.
+/// </returns>
+bool OverlapAnalyzerClass::EstimateCrossingTime(uint8_t ReturningDogIndex, uint8_t EnteringDogIndex, long &CrossingTime) {
+   if (_SeenBreaks != 0x03 || _SeenRestores != 0x03) {
+      return false;
+   }
+   const PassProfile &Returning = _GetProfile(ReturningDogIndex);
+   const PassProfile &Entering = _GetProfile(EnteringDogIndex);
+   if (!Returning.Valid || !Entering.Valid) {
+      return false;
+   }
+
+   //The returning dog breaks the box side beam (sensor 2) first, the entering dog the handlers side
+   //beam (sensor 1). Candidate positions put one profile edge on one observed edge.
+   long ReturningStarts[4] = {
+      _FirstBreak[1],
+      _FirstBreak[0] - Returning.Gap,
+      _LastRestore[1] - Returning.FirstOccluded,
+      _LastRestore[0] - Returning.Gap - Returning.SecondOccluded
+   };
+   long EnteringStarts[4] = {
+      _FirstBreak[0],
+      _FirstBreak[1] - Entering.Gap,
+      _LastRestore[0] - Entering.FirstOccluded,
+      _LastRestore[1] - Entering.Gap - Entering.SecondOccluded
+   };
+
+   long BestError = -1;
+   long BestReturningStart = 0;
+   long BestEnteringStart = 0;
+   for (uint8_t i = 0; i < 4; i++) {
+      for (uint8_t j = 0; j < 4; j++) {
+         long Error = _Error(ReturningStarts[i], EnteringStarts[j], Returning, Entering);
+         if (BestError < 0 || Error < BestError) {
+            BestError = Error;
+            BestReturningStart = ReturningStarts[i];
+            BestEnteringStart = EnteringStarts[j];
+         }
+      }
+   }
+
+   CrossingTime = BestEnteringStart - BestReturningStart;
+   return labs(CrossingTime) <= OVERLAP_MAX_CROSSING;
+}
+
+/// <summary>
+///   Gets the profile of a dog, or the last clean pass of any dog if the dog has none.
+/// </summary>
+const OverlapAnalyzerClass::PassProfile &OverlapAnalyzerClass::_GetProfile(uint8_t DogIndex) {
+   if (DogIndex < RaceRules::DogsPerTeam && _Profiles[DogIndex].Valid) {
+      return _Profiles[DogIndex];
+   }
+   return _LastProfile;
+}
+
+/// <summary>
+///   Sum of the absolute differences between the observed edges of the window and the edges both
+///   dogs would cause at the given positions.
+/// </summary>
+///
+/// <param name="ReturningStart">   Time the returning dog breaks the box side beam. </param>
+/// <param name="EnteringStart">    Time the entering dog breaks the handlers side beam. </param>
+long OverlapAnalyzerClass::_Error(long ReturningStart, long EnteringStart, const PassProfile &Returning, const PassProfile &Entering) {
+   long Sensor1Break = min(ReturningStart + Returning.Gap, EnteringStart);
+   long Sensor2Break = min(ReturningStart, EnteringStart + Entering.Gap);
+   long Sensor1Restore = max(ReturningStart + Returning.Gap + Returning.SecondOccluded, EnteringStart + Entering.FirstOccluded);
+   long Sensor2Restore = max(ReturningStart + Returning.FirstOccluded, EnteringStart + Entering.Gap + Entering.SecondOccluded);
+
+   return labs(Sensor1Break - _FirstBreak[0]) + labs(Sensor2Break - _FirstBreak[1])
+      + labs(Sensor1Restore - _LastRestore[0]) + labs(Sensor2Restore - _LastRestore[1]);
+}
+
+OverlapAnalyzerClass OverlapAnalyzer;
@@ -0,0 +1,55 @@
+#ifndef _OVERLAPANALYZER_h
+#define _OVERLAPANALYZER_h
+
+#include "Arduino.h"
+#include "RaceRules.h"
+
+#define OVERLAP_MAX_CROSSING 500000L   //Estimates further off than this (us) are not a pass-over
+
+/// <summary>
+///   Estimates the crossing of a pass-over: the entering dog breaks the handlers side beam while
+///   the returning dog is still in the gates, so its own edge is hidden. The gates only see the
+///   first beam break and the last beam restore of each sensor in the window.
+///
+///   Each dog's last clean pass is kept as a profile: the gap between both beam breaks and how
+///   long each beam stayed broken. The returning and the entering dog are laid over the window
+///   with their profiles, and the pair of positions which explains the four observed edges best
+///   (least absolute error, evaluated at every position where a profile edge matches an observed
+///   edge) gives the crossing: entering dog breaking the handlers side beam minus returning dog
+///   breaking the box side beam. Integer math only.
+/// </summary>
+class OverlapAnalyzerClass {
+   public:
+      void Reset();
+      void StartWindow();
+      void AddEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime);
+      void RecordCleanPass(uint8_t DogIndex);
+      bool GetBeamDelays(long &BreakDelay, long &RestoreDelay);
+      bool EstimateCrossingTime(uint8_t ReturningDogIndex, uint8_t EnteringDogIndex, long &CrossingTime);
+
+   private:
+      //Times relative to the first beam break of the pass, first beam is the one broken first
+      struct PassProfile {
+         bool Valid;
+         long Gap;               //First beam broken to second beam broken
+         long FirstOccluded;     //Time the first beam was broken
+         long SecondOccluded;    //Time the second beam was broken
+      };
+      PassProfile _Profiles[RaceRules::DogsPerTeam];
+      PassProfile _LastProfile;   //Most recent clean pass of any dog, used for dogs without one
+
+      //Edges of the current gate window, [sensor number - 1]
+      unsigned long _WindowStart;
+      long _FirstBreak[2];
+      long _LastRestore[2];
+      uint8_t _SeenBreaks;        //Bit per sensor
+      uint8_t _SeenRestores;
+      uint8_t _FirstSensor;       //Sensor index broken first in the window
+
+      const PassProfile &_GetProfile(uint8_t DogIndex);
+      long _Error(long ReturningStart, long EnteringStart, const PassProfile &Returning, const PassProfile &Entering);
+};
+
+extern OverlapAnalyzerClass OverlapAnalyzer;
+
+#endif
@@ -1,4 +1,17 @@
 #include "RaceHandler.h"
+#include <RaceJournal.h>
+#include <ClockCalibration.h>
+#include <SensorCalibration.h>
+#include <BeamRecorder.h>
+#include <OverlapAnalyzer.h>
+#include <RaceReconstruction.h>
+#include <SpeedEstimator.h>
+#include <RaceStatistics.h>
+#include <Telemetry.h>
+
+static_assert(BOX_HIT_TIMEOUT >= RaceRules::FalseCrossingWindow, "A missed box hit must not shorten the false crossing window");
+//Every crossing of a heat gets its own beam capture number
+static_assert(RaceRules::DogsPerTeam * RaceRules::MaxRunsPerDog <= BEAM_CAPTURES_PER_HEAT, "Too many runs per heat for the beam capture numbers");
 
 /// <summary>
 ///   Initialises this object andsets all counters to 0.
@@ -20,37 +33,96 @@ void RaceHandlerClass::init(uint8_t Sensor1Pin, uint8_t Sensor2Pin)
 ///   Main entry-point for this application. This function should be called once every main loop.
 ///   It will check if any new interrupts were saved from the sensors, and handle them if this
 ///   the case. All timing related data and also fault handling of the dogs is done in this
-///   function.
+///   function. The race data is only published again when it changed, and every tick while racing
+///   for the running times. Afterwards all events raised since the last call are sent to the
+///   subscribers. A heat which stopped is checked against the race journal on the next call, which
+///   has no sensor records to handle, and then its journal is written to EEPROM.
 /// </summary>
 void RaceHandlerClass::Main() {
-   //Don't handle anything if race is stopped
-   if (RaceState == STOP) {
-      return;
+   if (_ReconstructionPending) {
+      _ReconstructionPending = false;
+      _CheckReconstruction();
+      RaceJournal.Flush();
+   }
+
+   //Sensor records are only decoded once the race runs, before that we only watch for false starts
+   if (RaceState == STARTING) {
+      _MonitorStart();
+   } else if (RaceState == RACING) {
+      _HandleSensorQueue();
+   } else if (_CalibratingSensors) {
+      _HandleCalibrationQueue();
+   }
+
+   bool Tick = (millis() - _LastTickTime) >= RACE_TICK_INTERVAL;
+   if (_RaceDataChanged || (Tick && RaceState == RACING)) {
+      _PublishRaceData();
+   }
+
+   if (Tick) {
+      _LastTickTime = millis();
+      _RaiseEvent(TICK, CurrentDogIndex, _GetPublishedRaceData().ElapsedTime);
+   }
+
+   _DispatchEvents();
+}
+
+/// <summary>
+///   Watches the sensor trigger queue during the start light sequence. The records are left in the
+///   queue so they are decoded as usual once the race runs, only the first break of the handlers
+///   side beam is remembered. Since the records are timestamped by the same interrupt as during
+///   the race, a false start is measured as accurately as a normal crossing.
+/// </summary>
+void RaceHandlerClass::_MonitorStart() {
+   while (_FalseStartTriggerTime == 0 && _StartMonitorIndex != _QueueWriteIndex) {
+      SensorTriggerRecord &Record = _SensorTriggerQueue[_StartMonitorIndex];
+      if (Record.sensorNumber == 1 && Record.sensorState == 1) {
+         _FalseStartTriggerTime = Record.triggerTime - _SensorOffsets[0][1];
+         _RaiseEvent(FALSE_START, 0, ClockCalibration.Correct((long)(_FalseStartTriggerTime - _PerfectCrossingTime)));
+      }
+      _StartMonitorIndex = (_StartMonitorIndex + 1) % TRIGGER_QUEUE_LENGTH;
    }
+}
 
-   //If queue is not empty, we have work to do
-   if (!_QueueEmpty()) {
+/// <summary>
+///   Handles the records in the sensor trigger queue, this is where all timing and fault handling
+///   of the dogs is done.
+/// </summary>
+void RaceHandlerClass::_HandleSensorQueue() {
+
+   //Drain the queue in one batch, but don't spend more than the batch budget so the rest of the
+   //main loop (lights, LCD, button) keeps running during a burst of sensor edges. The batch also
+   //ends before the event queue could fill up, the rest is handled by the next call.
+   unsigned long BatchStartTime = micros();
+   uint8_t BatchSize = 0;
+   while (!_QueueEmpty() && RaceState != STOP && (micros() - BatchStartTime) < QUEUE_BATCH_BUDGET
+      && _PendingEventCount <= RACE_EVENT_QUEUE_LENGTH - RACE_EVENTS_PER_RECORD) {
+      BatchSize++;
       //Get next record from queue
       SensorTriggerRecord SensorTriggerRecord = _QueuePop();
+      RaceJournal.LogEdge(SensorTriggerRecord.sensorNumber, SensorTriggerRecord.sensorState, SensorTriggerRecord.triggerTime);
+#ifdef BOX_SENSOR_PIN
+      //The box sensor is not part of the transition string, it only tells when the dog turned
+      if (SensorTriggerRecord.sensorNumber == BOX_SENSOR_NUMBER) {
+         _HandleBoxEdge(SensorTriggerRecord.sensorState, SensorTriggerRecord.triggerTime);
+         continue;
+      }
+#endif
+      SensorTriggerRecord.triggerTime -= _SensorOffsets[SensorTriggerRecord.sensorNumber - 1][SensorTriggerRecord.sensorState];
+
       //If the transition string is not empty and is was not updated for 2 seconds then we have to clear it.
-      if (_Transition.length() != 0 && (micros() - _LastTransitionStringUpdate) > 2000000) {
+      if (_Transition.length() != 0 && (micros() - _LastTransitionStringUpdate) > RaceRules::TransitionTimeout) {
          _Transition = "";
       } if (_Transition.length() == 0) {
          _AreGatesClear = true;
+         OverlapAnalyzer.StartWindow();
       }
 
       // FIX LOGGING LATER
       // ESP_LOGD(__FILE__, "S%i|T:%li|St:%i", SensorTriggerRecord.sensorNumber, SensorTriggerRecord.triggerTime - _RaceStartTime, SensorTriggerRecord.sensorState);
       // ESP_LOGD(__FILE__, "bGatesClear: %i", _AreGatesClear);
 
-
-      // <<<<<<<<<<<<<<<<<< DONE HERE >>>>>>>>>>>>>>>>
-
-
-      // RERUNS TO BE DONE
-
-
-      NextDogIndex = CurrentDogIndex + 1;
+      NextDogIndex = _GetNextDogIndex();
 
       //Handle sensor 1 events (handlers side)
       //Only if gates are clear nd act on HIGH events (beam broken)
@@ -62,11 +134,11 @@ void RaceHandlerClass::Main() {
             SetDogFault(CurrentDogIndex, ON);
             // TODO: handle logging
             // ESP_LOGD(__FILE__, "F! D:%i!", CurrentDogIndex);
-            _CrossingTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]] = SensorTriggerRecord.triggerTime - _PerfectCrossingTime;
+            //The crossing time is stored by the normal race handling below
             _DogEnterTimes[CurrentDogIndex] = SensorTriggerRecord.triggerTime;
 
             //Check if this is a next dog which is too early (we are expecting a dog to come back)
-         } else if (_DogRunDirection == COMINGBACK) {
+         } else if (_DogRunDirection == COMINGBACK && NextDogIndex != CurrentDogIndex) {
             //This dog is too early!
             //We don't increase the dog number at this point. The transition string further down in the code will determine whether current dog came in or not.
             //Set fault light for next dog.
@@ -75,10 +147,11 @@ void RaceHandlerClass::Main() {
             //For now we assume dogs crossed more or less at the same time.
             //It is very unlikely that a next dog clears the sensors before the previous dog crosses them (this would be a veeery early crossing).
             _DogExitTimes[CurrentDogIndex] = SensorTriggerRecord.triggerTime;
-            _DogTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]] = SensorTriggerRecord.triggerTime - _DogEnterTimes[CurrentDogIndex];
+            _SetDogTime(CurrentDogIndex, SensorTriggerRecord.triggerTime - _DogEnterTimes[CurrentDogIndex]);
 
             //Handle next dog
             _DogEnterTimes[NextDogIndex] = SensorTriggerRecord.triggerTime;
+            _SetBoxDog(NextDogIndex);
             
             // TODO: handle logging
             // ESP_LOGD(__FILE__, "F! D:%i!", NextDogIndex);
@@ -87,7 +160,8 @@ void RaceHandlerClass::Main() {
          //Normal race handling (no faults)
          if (_DogRunDirection == GOINGIN) {
             //Store crossing time
-            _CrossingTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]] = SensorTriggerRecord.triggerTime - _PerfectCrossingTime;
+            _SetCrossingTime(CurrentDogIndex, SensorTriggerRecord.triggerTime - _PerfectCrossingTime, SensorTriggerRecord.triggerTime);
+            _SetBoxDog(CurrentDogIndex);
 
             //If this dog is doing a rerun we have to turn the error light for this dog off
             if (_RerunBusy) {
@@ -116,47 +190,46 @@ void RaceHandlerClass::Main() {
          //TODO: The current dog could also have a fault which is not caused by being too early (manually triggered fault).
          //We should store the fault type also so we can check if the dog was too early or not.
 
-         //If dog is not 1st dog and current dog has fault and S2 is trigger less than 2s after current dog's enter time
+         //If dog is not 1st dog and current dog has fault and current dog can't have turned yet (box sensor,
+         //or S2 is triggered less than 2s after current dog's enter time)
          //Then we know It's actually the previous dog who's still coming back (current dog was way too early).
-         if (CurrentDogIndex != 0 && _DogFaults[CurrentDogIndex] && (SensorTriggerRecord.triggerTime - _DogEnterTimes[CurrentDogIndex]) < 2000000) {
+         bool HasTurned = _HasTurned(CurrentDogIndex, SensorTriggerRecord.triggerTime);
+         if (CurrentDogIndex != 0 && _DogFaults[CurrentDogIndex] && !HasTurned) {
             //Current dog had a fault (was too early), so we need to modify the previous dog crossing time (we didn't know this before)
             //Update exit and total time of previous dog
             _DogExitTimes[PreviousDogIndex] = SensorTriggerRecord.triggerTime;
-            _DogTimes[PreviousDogIndex][_DogRunCounters[PreviousDogIndex]] = _DogExitTimes[PreviousDogIndex] - _DogEnterTimes[PreviousDogIndex];
+            _SetDogTime(PreviousDogIndex, _DogExitTimes[PreviousDogIndex] - _DogEnterTimes[PreviousDogIndex]);
 
-            //And update crossing time of this dog (who is in fault)
-            _CrossingTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]] = _DogEnterTimes[CurrentDogIndex] - _DogExitTimes[PreviousDogIndex];
+            //And update crossing time of this dog (who is in fault), its beam capture was taken when it went in
+            _SetCrossingTime(CurrentDogIndex, _DogEnterTimes[CurrentDogIndex] - _DogExitTimes[PreviousDogIndex]);
 
-            //Filter out S2 HIGH signals that are < 2 seconds after dog enter time
-         } else if ((SensorTriggerRecord.triggerTime - _DogEnterTimes[CurrentDogIndex]) > 2000000) {
+            //Filter out S2 HIGH signals of a dog which can't have turned yet
+         } else if (HasTurned) {
             //Normal handling for dog coming back
             _DogExitTimes[CurrentDogIndex] = SensorTriggerRecord.triggerTime;
-            _DogTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]] = SensorTriggerRecord.triggerTime - _DogEnterTimes[CurrentDogIndex];
+            _SetDogTime(CurrentDogIndex, SensorTriggerRecord.triggerTime - _DogEnterTimes[CurrentDogIndex]);
             //The time the dog came OUT is also the perfect crossing time
             _PerfectCrossingTime = SensorTriggerRecord.triggerTime;
 
 
-            //If this is the 4th dog and there is no fault we have to stop the race
-            // OR if the rerun sequence was started but no faults exist anymore
-            if ((CurrentDogIndex == 3 && _Fault == false && _RerunBusy == false) || (_RerunBusy == true && _Fault == false)) {
-               StopRace(SensorTriggerRecord.triggerTime);
-               
-               // TODO: handle logging
-               // ESP_LOGD(__FILE__, "Last Dog: %i|ENT:%lu|EXIT:%lu|TOT:%lu", CurrentDogIndex, _DogEnterTimes[CurrentDogIndex], _DogExitTimes[CurrentDogIndex], _DogTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]]);
+            if (_RerunBusy || CurrentDogIndex == RaceRules::DogsPerTeam - 1) {
+               //The last dog (or a dog doing a rerun) came back, this dog's run is complete.
+               //If it had a fault it is now added to the back of the rerun queue.
+               _CompleteDogRun(CurrentDogIndex);
 
+               if (_RerunQueueLength == 0) {
+                  //No dog owes a rerun and the last dog was clean: the race is finished
+                  StopRace(SensorTriggerRecord.triggerTime);
 
-               //If current dog is dog 4 and a fault exists, we have to initiate rerun sequence
-               //Or if rerun is busy (and faults still exist) 
-            } else if ((CurrentDogIndex == 3 && _Fault == true && _RerunBusy == false) || _RerunBusy == true) {
-               //Dog 3 came in but there is a fault, we have to initiate the rerun sequence
-               _RerunBusy = true;
-               //Reset timers for this dog
-               _DogEnterTimes[NextDogIndex] = SensorTriggerRecord.triggerTime;
-               _DogExitTimes[NextDogIndex] = 0;
-               //Increase run counter for this dog
-               _DogRunCounters[NextDogIndex]++;
-               // TODO: handle logging
-               // ESP_LOGI(__FILE__, "RR%i", NextDogIndex);
+                  // TODO: handle logging
+                  // ESP_LOGD(__FILE__, "Last Dog: %i|ENT:%lu|EXIT:%lu|TOT:%lu", CurrentDogIndex, _DogEnterTimes[CurrentDogIndex], _DogExitTimes[CurrentDogIndex], _DogTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]]);
+               } else {
+                  //The first dog in the rerun queue is next, its run counter is increased once it enters
+                  NextDogIndex = _RerunQueue[_RerunQueueHead];
+                  _DogEnterTimes[NextDogIndex] = SensorTriggerRecord.triggerTime;
+                  // TODO: handle logging
+                  // ESP_LOGI(__FILE__, "RR%i", NextDogIndex);
+               }
             } else {
                //Store next dog enter time
                _DogEnterTimes[NextDogIndex] = SensorTriggerRecord.triggerTime;
@@ -190,6 +263,7 @@ void RaceHandlerClass::Main() {
 
       //Add trigger record to transition string
       _AddToTransitionString(SensorTriggerRecord);
+      OverlapAnalyzer.AddEdge(SensorTriggerRecord.sensorNumber, SensorTriggerRecord.sensorState, SensorTriggerRecord.triggerTime);
 
       //Check if the transition string up till now tells us the gates are clear
       String Last2TransitionChars = _Transition.substring(_Transition.length() - 2);
@@ -213,11 +287,17 @@ void RaceHandlerClass::Main() {
 
             //Dog going to box
             if (_Transition == "ABab") {
+               RaceJournal.LogRecord(RaceJournal.TRANSITION, DOG_GOING_IN);
+               OverlapAnalyzer.RecordCleanPass(CurrentDogIndex);
+               _MeasureSpeed(CurrentDogIndex, GOINGIN);
                //Change dog state to coming back
                _ChangeDogRunDirection(COMINGBACK);
 
                 //Dog coming back 
             } else if (_Transition == "BAba"){
+               RaceJournal.LogRecord(RaceJournal.TRANSITION, DOG_COMING_BACK);
+               OverlapAnalyzer.RecordCleanPass(CurrentDogIndex);
+               _MeasureSpeed(CurrentDogIndex, COMINGBACK);
                //Normal handling, change dog state to GOING IN
                _ChangeDogRunDirection(GOINGIN);
                //Set next dog active
@@ -225,6 +305,7 @@ void RaceHandlerClass::Main() {
             } else if (_Transition == "BbAa") {
                //Transistion string BbAa indicates small object has passed through sensors
                //Most likely dog spat ball
+               RaceJournal.LogRecord(RaceJournal.TRANSITION, SMALL_OBJECT);
 
                // TODO: do logging
                // ESP_LOGI(__FILE__, "Spat ball detected?!");
@@ -233,20 +314,28 @@ void RaceHandlerClass::Main() {
                 //Transition string indicated something other than dog coming back or dog going in, it means 2 dogs must have passed
             } else {
                //Transition string indicates more than 1 dog passed
+               RaceJournal.LogRecord(RaceJournal.TRANSITION, MULTIPLE_DOGS);
+               //The edges of both dogs overlap, estimate the crossing from the way the dogs passed
+               //the gates before. If that is not possible the crossing stays unknown (CROSSING_NONE),
+               //so it isn't shown, reported or counted in the statistics as a perfect crossing.
+               long CrossingTime;
+               bool CrossingKnown = OverlapAnalyzer.EstimateCrossingTime(CurrentDogIndex, NextDogIndex, CrossingTime);
+
                //We increase the dog number
                _ChangeDogIndex(NextDogIndex);
 
-               //First check if no error was set for next dog (too early)
-               if (_DogFaults[CurrentDogIndex])
-               {
-                  //This dog was too early, but since have a simultaneous crossing we don't know the crossing time.
-                  //Set it to 0 for now
-               }
+               //A fault set for the next dog (too early) is kept, the estimated crossing only
+               //shows by how much it was early.
 
-               // and set perfect crossing time for new dog
+               // and set crossing time for new dog
                _ChangeDogRunDirection(COMINGBACK);
-               _CrossingTimes[CurrentDogIndex][_DogRunCounters[CurrentDogIndex]] = 0;
+               if (CrossingKnown) {
+                  _SetCrossingTime(CurrentDogIndex, CrossingTime, _DogExitTimes[PreviousDogIndex] + CrossingTime);
+               } else {
+                  BeamRecorder.Trigger(_DogExitTimes[PreviousDogIndex], CurrentDogIndex, _CurrentRaceId);
+               }
                _DogEnterTimes[CurrentDogIndex] = _DogExitTimes[PreviousDogIndex];
+               _SetBoxDog(CurrentDogIndex);
             }
          }
          _Transition = "";
@@ -255,21 +344,11 @@ void RaceHandlerClass::Main() {
       }
    }
 
-   //Update racetime
-   if (RaceState == RACING) {
-      if (micros() > _RaceStartTime) {
-         _RaceTime = micros() - _RaceStartTime;
-      }
+   if (BatchSize > _LargestQueueBatch) {
+      _LargestQueueBatch = BatchSize;
    }
-
-   //Check for faults, loop through array of dogs checking for faults
-   _Fault = false;
-   for (auto Fault : _DogFaults) {
-      if (Fault) {
-         //At least one dog with fault is found, set general fault value to true
-         _Fault = true;
-         break;
-      }
+   if (BatchSize > 0) {
+      _RaceDataChanged = true;
    }
 }
 
@@ -281,9 +360,7 @@ void RaceHandlerClass::Main() {
 void RaceHandlerClass::_ChangeDogRunDirection(_DogRunDirections NewDogRunDirection) {
    if (_DogRunDirection != NewDogRunDirection) {
       _DogRunDirection = NewDogRunDirection;
-
-      // TODO: do logging
-      // ESP_LOGD(__FILE__, "DogState: %i", NewDogRunDirection);
+      RaceJournal.LogRecord(RaceJournal.DIRECTION, NewDogRunDirection);
    }
 }
 
@@ -293,14 +370,580 @@ void RaceHandlerClass::_ChangeDogRunDirection(_DogRunDirections NewDogRunDirecti
 ///
 /// <param name="NewDogIndex"> Zero-based index of the new dog number. </param>
 void RaceHandlerClass::_ChangeDogIndex(uint8_t NewDogIndex) {
-   //Check if the dog really changed (this function could be called superfluously)
+   //After the last dog every new run is a rerun, which is only allowed for the first dog in the rerun queue
+   bool StartsRerun = _RerunBusy || CurrentDogIndex == RaceRules::DogsPerTeam - 1;
+   if (StartsRerun && (_RerunQueueLength == 0 || _RerunQueue[_RerunQueueHead] != NewDogIndex)) {
+      return;
+   }
+
+   //The new run starts when the current dog came back, taken before a rerun of the same dog clears it
+   unsigned long RunStartTime = _DogExitTimes[CurrentDogIndex];
+
+   //The run of the current dog is over (it might have been completed already when it came back)
+   _CompleteDogRun(CurrentDogIndex);
+
+   if (StartsRerun) {
+      _RemoveRerun(NewDogIndex);
+      _RerunBusy = true;
+      _DogRunCounters[NewDogIndex]++;
+      _DogExitTimes[NewDogIndex] = 0;
+      // TODO: handle logging
+      // ESP_LOGI(__FILE__, "RR%i", NewDogIndex);
+   }
+   _DogRunCompleted[NewDogIndex] = false;
+   if (_RunCount < sizeof(_RunOrder)) {
+      _RunOrder[_RunCount++] = (NewDogIndex << 4) | _DogRunCounters[NewDogIndex];
+   }
+
+   //Check if the dog really changed (a dog can rerun right after itself)
    if (NewDogIndex != CurrentDogIndex) {
       PreviousDogIndex = CurrentDogIndex;
       CurrentDogIndex = NewDogIndex;
+      RaceJournal.LogRecord(RaceJournal.DOG_INDEX, NewDogIndex);
 
-      // TODO: do logging
       // ESP_LOGD(__FILE__, "Prev Dog: %i|ENT:%lu|EXIT:%lu|TOT:%lu", PreviousDogIndex, _lDogEnterTimes[PreviousDogIndex], _lDogExitTimes[PreviousDogIndex], _lDogTimes[PreviousDogIndex][_iDogRunCounters[PreviousDogIndex]]);
    }
+
+   //Also raised when the same dog reruns, every run starts with this event
+   long RunStartRaceTime = 0;
+   if ((long)(RunStartTime - _RaceStartTime) > 0) {
+      RunStartRaceTime = ClockCalibration.Correct(RunStartTime - _RaceStartTime) / 1000;
+   }
+   _RaiseEvent(DOG_CHANGED, NewDogIndex, RunStartRaceTime);
+}
+
+/// <summary>
+///   Stores the first measurement of the crossing time of the current run of a dog and takes a beam
+///   capture around the crossing. Later revisions of the same crossing use the overload without
+///   event time, so every crossing is captured once.
+/// </summary>
+///
+/// <param name="DogIndex">     Zero-based index of the dog. </param>
+/// <param name="CrossingTime"> The crossing time in microseconds, negative if the dog was early. </param>
+/// <param name="EventTime">    The time (micros()) at which the dog crossed the line. </param>
+void RaceHandlerClass::_SetCrossingTime(uint8_t DogIndex, long CrossingTime, unsigned long EventTime) {
+   BeamRecorder.Trigger(EventTime, DogIndex, _CurrentRaceId);
+   _SetCrossingTime(DogIndex, CrossingTime);
+}
+
+/// <summary>
+///   Stores the crossing time of the current run of a dog, together with its classification.
+/// </summary>
+///
+/// <param name="DogIndex">     Zero-based index of the dog. </param>
+/// <param name="CrossingTime"> The crossing time in microseconds, negative if the dog was early. </param>
+void RaceHandlerClass::_SetCrossingTime(uint8_t DogIndex, long CrossingTime) {
+   CrossingTime = ClockCalibration.Correct(CrossingTime);
+   _CrossingTimes[DogIndex][_DogRunCounters[DogIndex]] = CrossingTime;
+   _CrossingClasses[DogIndex][_DogRunCounters[DogIndex]] = _ClassifyCrossing(CrossingTime);
+   _RaiseEvent(CROSSING_MEASURED, DogIndex, CrossingTime);
+}
+
+/// <summary>
+///   Measures the speed of a clean pass through the gates and stores it with the current run of the
+///   dog. A SPD frame is sent with the race id, dog, run number, direction (0 going in, 1 coming
+///   back), the speed and the average speed of the dog in this direction, both in mm/s.
+/// </summary>
+///
+/// <param name="DogIndex">    Zero-based index of the dog. </param>
+/// <param name="Direction">   The direction of the pass. </param>
+void RaceHandlerClass::_MeasureSpeed(uint8_t DogIndex, _DogRunDirections Direction) {
+   long BreakDelay;
+   long RestoreDelay;
+   if (!OverlapAnalyzer.GetBeamDelays(BreakDelay, RestoreDelay)) {
+      return;
+   }
+
+   SpeedEstimatorClass::PassDirections PassDirection = (Direction == GOINGIN) ? SpeedEstimator.GOING_IN : SpeedEstimator.COMING_BACK;
+   uint16_t Speed = SpeedEstimator.AddPass(DogIndex, PassDirection, ClockCalibration.Correct((BreakDelay + RestoreDelay) / 2));
+   if (Speed == 0) {
+      return;
+   }
+
+   uint8_t RunNumber = _DogRunCounters[DogIndex];
+   _Speeds[DogIndex][RunNumber][Direction] = min((Speed + 50) / 100, 255);
+
+   Telemetry.BeginFrame(F("SPD"));
+   Telemetry.AddField(_CurrentRaceId);
+   Telemetry.AddField(DogIndex);
+   Telemetry.AddField(RunNumber);
+   Telemetry.AddField((int)Direction);
+   Telemetry.AddField(Speed);
+   Telemetry.AddField(SpeedEstimator.GetAverage(DogIndex, PassDirection));
+   Telemetry.EndFrame();
+}
+
+/// <summary>
+///   Stores the time of the current run of a dog.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+/// <param name="DogTime">  The dog time in microseconds. </param>
+void RaceHandlerClass::_SetDogTime(uint8_t DogIndex, unsigned long DogTime) {
+   DogTime = ClockCalibration.Correct(DogTime);
+   uint8_t RunNumber = _DogRunCounters[DogIndex];
+   _DogTimes[DogIndex][RunNumber] = DogTime;
+
+   //Fixes issue 7 (https://github.com/vyruz1986/FlyballETS-Software/issues/7)
+   //Only deduct crossing time if it is positive
+   unsigned long DogTimeMillis = DogTime / 1000;
+   long CrossingTimeMillis = _CrossingTimes[DogIndex][RunNumber] / 1000;
+   if (CrossingTimeMillis > 0 && DogTimeMillis > (unsigned long)CrossingTimeMillis) {
+      DogTimeMillis -= CrossingTimeMillis;
+   }
+   _DogTimesMillis[DogIndex][RunNumber] = min(DogTimeMillis, 65535UL);
+#ifdef BOX_SENSOR_PIN
+   _SetBoxSplits(DogIndex);
+#endif
+   _RaiseEvent(DOG_FINISHED, DogIndex, DogTime / 1000);
+}
+
+/// <summary>
+///   Determines whether a box side beam break can be the given dog coming back. Without a box
+///   sensor a dog has turned once RaceRules::FalseCrossingWindow passed since it went in. Once the
+///   box sensor saw a dog in this race a box hit also counts, and for a dog with a fault (which
+///   can have overtaken the previous dog) the box hit counts until BOX_HIT_TIMEOUT passed. A dog
+///   whose hit was missed is still seen coming back, so one missed hit doesn't stall the race.
+/// </summary>
+///
+/// <param name="DogIndex">      Zero-based index of the dog. </param>
+/// <param name="TriggerTime">   The time of the box side beam break in microseconds. </param>
+bool RaceHandlerClass::_HasTurned(uint8_t DogIndex, unsigned long TriggerTime) {
+#ifdef BOX_SENSOR_PIN
+   if (_BoxHitTimes[DogIndex] != 0) {
+      return true;
+   }
+   if (_BoxHitsSeen && _DogFaults[DogIndex]) {
+      return (TriggerTime - _DogEnterTimes[DogIndex]) > BOX_HIT_TIMEOUT;
+   }
+#endif
+   return (TriggerTime - _DogEnterTimes[DogIndex]) > RaceRules::FalseCrossingWindow;
+}
+
+/// <summary>
+///   Marks the dog which went in last, the next box edges belong to it. Its box times of the
+///   previous run are cleared.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+void RaceHandlerClass::_SetBoxDog(uint8_t DogIndex) {
+#ifdef BOX_SENSOR_PIN
+   _BoxDogIndex = DogIndex;
+   _BoxHitTimes[DogIndex] = 0;
+   _BoxReleaseTimes[DogIndex] = 0;
+#endif
+}
+
+#ifdef BOX_SENSOR_PIN
+/// <summary>
+///   Handles an edge of the box sensor, it belongs to the dog which went in last. Only the first
+///   hit of a run counts (the dog can bounce on the pedal), the release is the last one before the
+///   dog comes back.
+/// </summary>
+///
+/// <param name="SensorState">  The sensor state, 1 when the box is hit. </param>
+/// <param name="TriggerTime">  The raw time of the edge in microseconds. </param>
+void RaceHandlerClass::_HandleBoxEdge(uint8_t SensorState, unsigned long TriggerTime) {
+   if (RaceState != RACING) {
+      return;
+   }
+
+   if (SensorState == 1) {
+      if (_BoxHitTimes[_BoxDogIndex] == 0) {
+         _BoxHitTimes[_BoxDogIndex] = TriggerTime;
+         _BoxHitsSeen = true;
+      }
+   } else if (_BoxHitTimes[_BoxDogIndex] != 0) {
+      _BoxReleaseTimes[_BoxDogIndex] = TriggerTime;
+   }
+}
+
+/// <summary>
+///   Splits the current run of a dog in outrun (crossing to box hit) and turn (box hit to release),
+///   the rest of the dog time is the return. The outrun starts where the dog time starts: at the
+///   dog's own crossing when it was late.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+void RaceHandlerClass::_SetBoxSplits(uint8_t DogIndex) {
+   uint8_t RunNumber = _DogRunCounters[DogIndex];
+   _BoxSplits[DogIndex][RunNumber][0] = 0;
+   _BoxSplits[DogIndex][RunNumber][1] = 0;
+   unsigned long HitTime = _BoxHitTimes[DogIndex];
+   if (HitTime == 0 || (long)(HitTime - _DogEnterTimes[DogIndex]) <= 0) {
+      return;
+   }
+
+   long Outrun = ClockCalibration.Correct(HitTime - _DogEnterTimes[DogIndex]);
+   long CrossingTime = _CrossingTimes[DogIndex][RunNumber];
+   if (CrossingTime > 0) {
+      Outrun -= CrossingTime;
+   }
+   unsigned long ReleaseTime = (_BoxReleaseTimes[DogIndex] != 0) ? _BoxReleaseTimes[DogIndex] : HitTime;
+   unsigned long Turn = ClockCalibration.Correct(ReleaseTime - HitTime);
+   _BoxSplits[DogIndex][RunNumber][0] = constrain(Outrun / 1000, 0L, 65535L);
+   _BoxSplits[DogIndex][RunNumber][1] = min(Turn / 1000, 65535UL);
+}
+#endif
+
+/// <summary>
+///   Feeds the raw sensor edges to the sensor calibration while the race is stopped.
+/// </summary>
+void RaceHandlerClass::_HandleCalibrationQueue() {
+   while (!_QueueEmpty()) {
+      SensorTriggerRecord Record = _QueuePop();
+      SensorCalibration.AddEdge(Record.sensorNumber, Record.sensorState, Record.triggerTime);
+   }
+}
+
+/// <summary>
+///   Sets the receiver delays which are compensated on every sensor edge.
+/// </summary>
+///
+/// <param name="Offsets">   The delay in microseconds, per [sensor number - 1][sensor state]. </param>
+void RaceHandlerClass::SetSensorOffsets(const long Offsets[2][2]) {
+   memcpy(_SensorOffsets, Offsets, sizeof(_SensorOffsets));
+}
+
+/// <summary>
+///   Gets the receiver delays which are compensated on every sensor edge.
+/// </summary>
+///
+/// <param name="Offsets">   [out] The delay in microseconds, per [sensor number - 1][sensor state]. </param>
+void RaceHandlerClass::GetSensorOffsets(long Offsets[2][2]) const {
+   memcpy(Offsets, _SensorOffsets, sizeof(_SensorOffsets));
+}
+
+/// <summary>
+///   Starts sending the sensor edges to SensorCalibration, this is only possible while the race is
+///   stopped. A new calibration is started.
+/// </summary>
+///
+/// <returns>
+///   true if the calibration was started, false if the race is not stopped.
+/// </returns>
+bool RaceHandlerClass::StartSensorCalibration() {
+   if (RaceState != STOP) {
+      return false;
+   }
+
+   _CalibratingSensors = false;
+   _QueueReadIndex = _QueueWriteIndex;
+   SensorCalibration.Reset();
+   _CalibratingSensors = true;
+   return true;
+}
+
+/// <summary>
+///   Stops sending the sensor edges to SensorCalibration.
+/// </summary>
+void RaceHandlerClass::StopSensorCalibration() {
+   _CalibratingSensors = false;
+   _HandleCalibrationQueue();
+}
+
+/// <summary>
+///   Query if the sensor edges are sent to SensorCalibration.
+/// </summary>
+///
+/// <returns>
+///   true if a sensor calibration is running.
+/// </returns>
+bool RaceHandlerClass::IsCalibratingSensors() const {
+   return _CalibratingSensors;
+}
+
+/// <summary>
+///   Registers a function which will be called for every race event. Subscribers are called from
+///   Main(), never from an interrupt. There is room for MAX_RACE_EVENT_SUBSCRIBERS subscribers.
+/// </summary>
+///
+/// <param name="Handler">   The function to call. </param>
+///
+/// <returns>
+///   true if the subscriber was added, false if the subscriber list is full.
+/// </returns>
+bool RaceHandlerClass::Subscribe(RaceEventHandler Handler) {
+   if (_EventSubscriberCount >= MAX_RACE_EVENT_SUBSCRIBERS) {
+      return false;
+   }
+
+   _EventSubscribers[_EventSubscriberCount++] = Handler;
+   return true;
+}
+
+/// <summary>
+///   Queues an event for the subscribers. If the event queue is full anyway (events raised outside
+///   Main()), the race data is published and the pending events are sent right away so no event is
+///   lost and the subscribers don't read stale race data.
+/// </summary>
+///
+/// <param name="Type">       The event type. </param>
+/// <param name="DogIndex">   Zero-based index of the dog the event is about. </param>
+/// <param name="Value">      The event value, see RaceEventTypes. </param>
+void RaceHandlerClass::_RaiseEvent(RaceEventTypes Type, uint8_t DogIndex, long Value) {
+   if (_EventSubscriberCount == 0) {
+      return;
+   }
+
+   if (_PendingEventCount >= RACE_EVENT_QUEUE_LENGTH) {
+      if (_RaceDataChanged) {
+         _PublishRaceData();
+      }
+      _DispatchEvents();
+   }
+
+   _PendingEvents[_PendingEventCount++] = {Type, DogIndex, _DogRunCounters[DogIndex], Value};
+}
+
+/// <summary>
+///   Sends all pending events to all subscribers, in the order in which they were raised.
+/// </summary>
+void RaceHandlerClass::_DispatchEvents() {
+   for (uint8_t EventIndex = 0; EventIndex < _PendingEventCount; EventIndex++) {
+      for (uint8_t SubscriberIndex = 0; SubscriberIndex < _EventSubscriberCount; SubscriberIndex++) {
+         _EventSubscribers[SubscriberIndex](_PendingEvents[EventIndex]);
+      }
+   }
+   _PendingEventCount = 0;
+}
+
+/// <summary>
+///   Classifies a crossing time using the thresholds of the active race rules.
+/// </summary>
+///
+/// <param name="CrossingTime"> The crossing time in microseconds. </param>
+RaceHandlerClass::CrossingClasses RaceHandlerClass::_ClassifyCrossing(long CrossingTime) {
+   if (CrossingTime < 0) {
+      return CROSSING_EARLY;
+   } else if (CrossingTime <= RaceRules::PerfectCrossingLimit) {
+      return CROSSING_PERFECT;
+   } else if (CrossingTime <= RaceRules::LateCrossingLimit) {
+      return CROSSING_OK;
+   }
+   return CROSSING_LATE;
+}
+
+/// <summary>
+///   Gets the index of the dog which will run after the current dog. During the first run of all
+///   dogs this is simply the next dog, after that it is the first dog in the rerun queue. If the
+///   rerun queue is empty, the current dog index is returned (there is no next dog).
+/// </summary>
+uint8_t RaceHandlerClass::_GetNextDogIndex() {
+   if (!_RerunBusy && CurrentDogIndex < RaceRules::DogsPerTeam - 1) {
+      return CurrentDogIndex + 1;
+   }
+
+   if (_RerunQueueLength > 0) {
+      return _RerunQueue[_RerunQueueHead];
+   }
+
+   return CurrentDogIndex;
+}
+
+/// <summary>
+///   Gets the dog which reruns first, the front of the rerun queue. A faulted dog is only queued
+///   once its run is complete, so the queue changes with the FAULT_CHANGED and DOG_CHANGED events.
+/// </summary>
+///
+/// <param name="DogIndex">   [out] Zero-based index of the dog. </param>
+///
+/// <returns>
+///   False if no dog is waiting for a rerun.
+/// </returns>
+bool RaceHandlerClass::GetNextRerunDog(uint8_t &DogIndex) const {
+   if (_RerunQueueLength == 0) {
+      return false;
+   }
+
+   DogIndex = _RerunQueue[_RerunQueueHead];
+   return true;
+}
+
+/// <summary>
+///   Marks the current run of a dog as complete. If the dog has a fault at this point, it is added
+///   to the back of the rerun queue. Calling this function again for the same run does nothing.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+void RaceHandlerClass::_CompleteDogRun(uint8_t DogIndex) {
+   if (_DogRunCompleted[DogIndex]) {
+      return;
+   }
+
+   _DogRunCompleted[DogIndex] = true;
+   if (_DogFaults[DogIndex]) {
+      _EnqueueRerun(DogIndex);
+   }
+}
+
+/// <summary>
+///   Adds a dog to the back of the rerun queue. A dog is queued at most once, and only if its run
+///   table still has room for another run. If it has no room, the race can finish while the dog
+///   still owes a run, so a RERUN_NOT_QUEUED event reports it.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+void RaceHandlerClass::_EnqueueRerun(uint8_t DogIndex) {
+   if (!RaceRules::RerunFaultedDogs || _RerunQueued[DogIndex]) {
+      return;
+   }
+   if (_DogRunCounters[DogIndex] >= RaceRules::MaxRunsPerDog - 1) {
+      _RaiseEvent(RERUN_NOT_QUEUED, DogIndex, _DogRunCounters[DogIndex] + 1);
+      return;
+   }
+
+   _RerunQueue[(_RerunQueueHead + _RerunQueueLength) % RaceRules::DogsPerTeam] = DogIndex;
+   _RerunQueueLength++;
+   _RerunQueued[DogIndex] = true;
+}
+
+/// <summary>
+///   Removes a dog from the rerun queue, either because its rerun starts (it is at the front of the
+///   queue) or because its fault was removed manually.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+void RaceHandlerClass::_RemoveRerun(uint8_t DogIndex) {
+   if (!_RerunQueued[DogIndex]) {
+      return;
+   }
+
+   //Find the dog and move all dogs behind it one place forward
+   bool Found = false;
+   for (uint8_t i = 0; i < _RerunQueueLength; i++) {
+      uint8_t Position = (_RerunQueueHead + i) % RaceRules::DogsPerTeam;
+      if (Found) {
+         _RerunQueue[(Position + RaceRules::DogsPerTeam - 1) % RaceRules::DogsPerTeam] = _RerunQueue[Position];
+      } else if (_RerunQueue[Position] == DogIndex) {
+         Found = true;
+         if (i == 0) {
+            //Dog is at the front of the queue, just move the head
+            _RerunQueueHead = (_RerunQueueHead + 1) % RaceRules::DogsPerTeam;
+            break;
+         }
+      }
+   }
+
+   _RerunQueueLength--;
+   _RerunQueued[DogIndex] = false;
+}
+
+/// <summary>
+///   Rebuilds the heat which just ended from the race journal and sends a RCD frame for every run
+///   where the rebuilt dog time (field T) or crossing time (field C) differs from the live result,
+///   followed by a RCS frame with the race id, the result of the reconstruction, the number of runs,
+///   the number of differences and the time the check took in microseconds.
+/// </summary>
+void RaceHandlerClass::_CheckReconstruction() {
+   unsigned long CheckStartTime = micros();
+   uint8_t RunCount = min(_RunCount, RECONSTRUCTION_MAX_RUNS);
+
+   //Lane time (going in to coming back) of the runs of this heat, the median is the expected lane
+   //time for dogs which didn't run in the heats before
+   unsigned long LaneTimes[RECONSTRUCTION_MAX_RUNS];
+   uint8_t LaneTimeCount = 0;
+   for (uint8_t i = 0; i < RunCount; i++) {
+      uint8_t DogIndex = _RunOrder[i] >> 4;
+      uint8_t RunNumber = _RunOrder[i] & 0x0F;
+      if (_DogTimes[DogIndex][RunNumber] == 0) {
+         continue;
+      }
+      unsigned long LaneTime = _DogTimes[DogIndex][RunNumber] - _CrossingTimes[DogIndex][RunNumber];
+      uint8_t Position = LaneTimeCount++;
+      while (Position > 0 && LaneTimes[Position - 1] > LaneTime) {
+         LaneTimes[Position] = LaneTimes[Position - 1];
+         Position--;
+      }
+      LaneTimes[Position] = LaneTime;
+   }
+   unsigned long HeatLaneTime = (LaneTimeCount > 0) ? LaneTimes[LaneTimeCount / 2] : 0;
+
+   //The sorted lane times are done with, their room on the stack holds the expected ones
+   unsigned long *ExpectedLaneTimes = LaneTimes;
+   for (uint8_t i = 0; i < RunCount; i++) {
+      ExpectedLaneTimes[i] = _GetExpectedLaneTime(_RunOrder[i] >> 4, HeatLaneTime);
+   }
+
+   RaceReconstructionClass::ReconstructedRun Runs[RECONSTRUCTION_MAX_RUNS];
+   RaceReconstructionClass::ReconstructionResults Result = RaceReconstruction.Run(_RaceStartTime, _SensorOffsets, _RunCount, ExpectedLaneTimes, Runs);
+
+   uint8_t Differences = 0;
+   if (Result == RaceReconstructionClass::RECONSTRUCTED) {
+      for (uint8_t i = 0; i < RunCount; i++) {
+         uint8_t DogIndex = _RunOrder[i] >> 4;
+         uint8_t RunNumber = _RunOrder[i] & 0x0F;
+
+         long LiveDogTime = _DogTimes[DogIndex][RunNumber];
+         long DogTime = Runs[i].Complete ? ClockCalibration.Correct(Runs[i].DogTime) : 0;
+         if (labs(DogTime - LiveDogTime) > RECONSTRUCTION_TOLERANCE) {
+            _SendDisagreement(DogIndex, RunNumber, 'T', LiveDogTime, DogTime);
+            Differences++;
+         }
+
+         //A crossing hidden by another dog can't be rebuilt
+         if (Runs[i].CrossingKnown) {
+            long LiveCrossingTime = _CrossingTimes[DogIndex][RunNumber];
+            long CrossingTime = ClockCalibration.Correct(Runs[i].CrossingTime);
+            if (labs(CrossingTime - LiveCrossingTime) > RECONSTRUCTION_TOLERANCE) {
+               _SendDisagreement(DogIndex, RunNumber, 'C', LiveCrossingTime, CrossingTime);
+               Differences++;
+            }
+         }
+      }
+   }
+
+   Telemetry.BeginFrame(F("RCS"));
+   Telemetry.AddField(_CurrentRaceId);
+   Telemetry.AddField((int)Result);
+   Telemetry.AddField(RunCount);
+   Telemetry.AddField(Differences);
+   Telemetry.AddField(micros() - CheckStartTime);
+   Telemetry.EndFrame();
+}
+
+/// <summary>
+///   Gets the expected lane time of a dog: the average of its runs in the heats which are still in
+///   the race history, or the lane time of this heat if the dog didn't run in those.
+/// </summary>
+///
+/// <param name="DogIndex">      Zero-based index of the dog. </param>
+/// <param name="HeatLaneTime">  The median lane time of the heat in microseconds, 0 if unknown. </param>
+unsigned long RaceHandlerClass::_GetExpectedLaneTime(uint8_t DogIndex, unsigned long HeatLaneTime) {
+   unsigned long TotalTime = 0;
+   uint8_t RunCount = 0;
+   for (uint8_t i = 0; i < NUM_HISTORIC_RACE_RECORDS; i++) {
+      const RaceData &Race = _HistoricRaceData[i];
+      if (Race.Id == _CurrentRaceId) {
+         continue;
+      }
+      for (uint8_t RunNumber = 0; RunNumber < RaceRules::MaxRunsPerDog; RunNumber++) {
+         const DogTimeData &Timing = Race.DogData[DogIndex].Timing[RunNumber];
+         if (Timing.Time != 0) {
+            //Published dog times already have positive crossing times deducted
+            long EarlyTime = (Timing.CrossingTime < 0) ? Timing.CrossingTime : 0;
+            TotalTime += Timing.Time * 1000 - EarlyTime;
+            RunCount++;
+         }
+      }
+   }
+
+   return (RunCount > 0) ? TotalTime / RunCount : HeatLaneTime;
+}
+
+/// <summary>
+///   Sends a RCD frame: race id, dog, run number, field, live value and rebuilt value, both in
+///   microseconds.
+/// </summary>
+void RaceHandlerClass::_SendDisagreement(uint8_t DogIndex, uint8_t RunNumber, char Field, long LiveValue, long ReconstructedValue) {
+   Telemetry.BeginFrame(F("RCD"));
+   Telemetry.AddField(_CurrentRaceId);
+   Telemetry.AddField(DogIndex);
+   Telemetry.AddField(RunNumber);
+   Telemetry.AddField(Field);
+   Telemetry.AddField(LiveValue);
+   Telemetry.AddField(ReconstructedValue);
+   Telemetry.EndFrame();
 }
 
 /// <summary>
@@ -352,12 +995,8 @@ void RaceHandlerClass::_AddToTransitionString(SensorTriggerRecord _InterruptTrig
 ///   state (HIGH/LOW) of the sensor in the interrupt queue.
 /// </summary>
 void RaceHandlerClass::TriggerSensor1() {
-   if (RaceState == STOP) {
-      return;
-   }
-
-   uint8_t sensorNumber = 1;
-   _QueuePush({sensorNumber, micros(), digitalRead(_Sensor1Pin)});
+   unsigned long TriggerTime = micros();
+   PushSensorEdge(1, (uint8_t)digitalRead(_Sensor1Pin), TriggerTime);
 }
 
 /// <summary>
@@ -367,8 +1006,8 @@ void RaceHandlerClass::TriggerSensor1() {
 /// <param name="DogIndex"> Zero-based index of the dog number. </param>
 /// <param name="State">      The state. </param>
 void RaceHandlerClass::SetDogFault(uint8_t DogIndex, DogFaults State) {
-   //Don't process any faults when race is not running
-   if (RaceState == STOP) {
+   //Don't process any faults when race is not running, or for dogs which aren't in the team
+   if (RaceState == STOP || DogIndex >= RaceRules::DogsPerTeam) {
       return;
    }
 
@@ -380,8 +1019,30 @@ void RaceHandlerClass::SetDogFault(uint8_t DogIndex, DogFaults State) {
       Fault = State;
    }
 
+   //Keep track of the number of faulted dogs so we don't have to scan all dogs
+   if (Fault != _DogFaults[DogIndex]) {
+      if (Fault) {
+         _FaultCount++;
+      } else {
+         _FaultCount--;
+      }
+   }
+   _Fault = (_FaultCount > 0);
+
    //Set fault to specified value for relevant dog
    _DogFaults[DogIndex] = Fault;
+   _RaceDataChanged = true;
+   _RaiseEvent(FAULT_CHANGED, DogIndex, Fault);
+
+   //A fault which is set or removed after the dog's run was completed changes the rerun queue directly
+   if (_DogRunCompleted[DogIndex]) {
+      if (Fault) {
+         _EnqueueRerun(DogIndex);
+      } else {
+         _RemoveRerun(DogIndex);
+      }
+   }
+   RaceJournal.LogRecord(RaceJournal.DOG_FAULT, (DogIndex << 1) | Fault);
 
    
    // <<<<<<<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -404,21 +1065,54 @@ void RaceHandlerClass::SetDogFault(uint8_t DogIndex, DogFaults State) {
 /// </summary>
 void RaceHandlerClass::TriggerSensor2()
 {
-   if (RaceState == STOP)
-   {
+   unsigned long TriggerTime = micros();
+   PushSensorEdge(2, (uint8_t)digitalRead(_Sensor2Pin), TriggerTime);
+}
+
+#ifdef BOX_SENSOR_PIN
+/// <summary>
+///   ISR function for the box sensor, the same path as the gate sensors: the time is taken first
+///   and the edge is recorded in the interrupt queue as sensor BOX_SENSOR_NUMBER.
+/// </summary>
+void RaceHandlerClass::TriggerBoxSensor() {
+   unsigned long TriggerTime = micros();
+   PushSensorEdge(BOX_SENSOR_NUMBER, (uint8_t)digitalRead(BOX_SENSOR_PIN), TriggerTime);
+}
+#endif
+
+/// <summary>
+///   Records a sensor edge in the interrupt queue. Called from interrupt context by the sensor
+///   capture backend, edges are ignored while the race is stopped.
+/// </summary>
+///
+/// <param name="SensorNumber"> The sensor number. </param>
+/// <param name="SensorState">  The sensor state (HIGH/LOW). </param>
+/// <param name="TriggerTime">  The time of the edge in microseconds. </param>
+void RaceHandlerClass::PushSensorEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime) {
+   if (RaceState == STOP && !_CalibratingSensors) {
       return;
    }
-   uint8_t sensorNumber = 2;
-   _QueuePush({sensorNumber, micros(), digitalRead(_Sensor2Pin)});
+
+   _QueuePush({SensorNumber, TriggerTime, SensorState});
 }
 
 /// <summary>
-///   Pushes an interrupt trigger record to the back of the interrupt buffer.
+///   Pushes an interrupt trigger record to the back of the interrupt buffer. When the buffer is
+///   full the record is dropped and counted, the records which are waiting are never overwritten.
+///   While the race is starting nothing is popped, so a lot of edges during the start light
+///   sequence can fill the buffer.
 /// </summary>
 ///
 /// <param name="_InterruptTrigger">   The interrupt trigger record. </param>
 void RaceHandlerClass::_QueuePush(RaceHandlerClass::SensorTriggerRecord _InterruptTrigger)
 {
+   if ((_QueueWriteIndex + 1) % TRIGGER_QUEUE_LENGTH == _QueueReadIndex) {
+      if (_QueueOverflows < 255) {
+         _QueueOverflows++;
+      }
+      return;
+   }
+
    //Add record to queue
    _SensorTriggerQueue[_QueueWriteIndex] = _InterruptTrigger;
 
@@ -433,6 +1127,12 @@ void RaceHandlerClass::_QueuePush(RaceHandlerClass::SensorTriggerRecord _Interru
       //End of array not yet reached, increase index by 1
       _QueueWriteIndex++;
    }
+
+   //Keep track of the deepest the queue has been
+   uint8_t QueueDepth = (_QueueWriteIndex + TRIGGER_QUEUE_LENGTH - _QueueReadIndex) % TRIGGER_QUEUE_LENGTH;
+   if (QueueDepth > _QueueHighWaterMark) {
+      _QueueHighWaterMark = QueueDepth;
+   }
 }
 
 /// <summary>
@@ -440,15 +1140,91 @@ void RaceHandlerClass::_QueuePush(RaceHandlerClass::SensorTriggerRecord _Interru
 ///   software for starting a next race.
 /// </summary>
 void RaceHandlerClass::ResetRace() {
+   //A heat which is reset before Main() checked it is checked now, before its data is cleared
+   if (_ReconstructionPending) {
+      _ReconstructionPending = false;
+      _CheckReconstruction();
+   }
+
+   //If the previous race was started, the next one gets a new ID
+   if (_RaceStartTime != 0) {
+      _CurrentRaceId++;
+   }
+
    RaceState = STOP;
    _QueueReadIndex = 0;
    _QueueWriteIndex = 0;
+   _QueueHighWaterMark = 0;
+   _QueueOverflows = 0;
+   _LargestQueueBatch = 0;
+
+   CurrentDogIndex = 0;
+   PreviousDogIndex = 0;
+   NextDogIndex = 0;
+   _Fault = false;
+   _FaultCount = 0;
+   _RerunBusy = false;
+   _RerunQueueHead = 0;
+   _RerunQueueLength = 0;
+   _RunOrder[0] = 0;
+   _RunCount = 1;
+#ifdef BOX_SENSOR_PIN
+   _BoxDogIndex = 0;
+   _BoxHitsSeen = false;
+#endif
+   _AreGatesClear = false;
+   _Transition = "";
+   OverlapAnalyzer.Reset();
+   _DogRunDirection = GOINGIN;
+   _PerfectCrossingTime = 0;
+   _FalseStartTriggerTime = 0;
+   _StartMonitorIndex = 0;
+   _RaceStartTime = 0;
+   _RaceEndTime = 0;
+   _RaceTime = 0;
+
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      _DogFaults[DogIndex] = false;
+      _RerunQueued[DogIndex] = false;
+      _DogRunCompleted[DogIndex] = false;
+      _DogRunCounters[DogIndex] = 0;
+      _DogEnterTimes[DogIndex] = 0;
+      _DogExitTimes[DogIndex] = 0;
+#ifdef BOX_SENSOR_PIN
+      _BoxHitTimes[DogIndex] = 0;
+      _BoxReleaseTimes[DogIndex] = 0;
+      memset(_BoxSplits[DogIndex], 0, sizeof(_BoxSplits[DogIndex]));
+#endif
+      for (uint8_t RunNumber = 0; RunNumber < RaceRules::MaxRunsPerDog; RunNumber++) {
+         _DogTimes[DogIndex][RunNumber] = 0;
+         _DogTimesMillis[DogIndex][RunNumber] = 0;
+         _CrossingTimes[DogIndex][RunNumber] = 0;
+         _CrossingClasses[DogIndex][RunNumber] = CROSSING_NONE;
+         _Speeds[DogIndex][RunNumber][GOINGIN] = 0;
+         _Speeds[DogIndex][RunNumber][COMINGBACK] = 0;
+      }
+   }
+
+   //All race data changed, let the subscribers know
+   _PublishRaceData();
+   _RaiseEvent(STATE_CHANGED, CurrentDogIndex, RaceState);
 }
 
 /// <summary>
 ///   Starts the timers. Should be called once GREEN light comes ON.
 /// </summary>
-void RaceHandlerClass::StartTimers() {
+///
+/// <param name="GreenTime">  The time in microseconds at which the green light was switched on.
+///                           The race time and the crossing of the first dog are measured from
+///                           this moment. </param>
+void RaceHandlerClass::StartTimers(unsigned long GreenTime) {
+   if (RaceState != STARTING) {
+      return;
+   }
+
+   _RaceStartTime = GreenTime;
+   _PerfectCrossingTime = GreenTime;
+   _DogEnterTimes[0] = GreenTime;
    _ChangeRaceState(RACING);
 }
 
@@ -464,69 +1240,137 @@ void RaceHandlerClass::StopRace() {
 /// </summary>
 /// <param name="StopTime">   The time in microseconds at which the race stopped. </param>
 void RaceHandlerClass::StopRace(unsigned long StopTime) {
-   if (RaceState == RACING) {
+   bool WasRacing = RaceState == RACING;
+   if (WasRacing) {
       //Race is running, so we have to record the EndTime
       _RaceEndTime = StopTime;
-      _RaceTime = _RaceEndTime - _RaceStartTime;
+      _RaceTime = ClockCalibration.Correct(_RaceEndTime - _RaceStartTime) / 1000;
    }
    _ChangeRaceState(STOP);
 
-   _HistoricRaceData[_CurrentRaceId] = GetRaceData(_CurrentRaceId);
+   _PublishRaceData();
+   if (WasRacing) {
+      //StopRace() can run from the sensor batch, the reconstruction is left to the next Main()
+      _ReconstructionPending = true;
+      RaceStatistics.AddRace(_GetPublishedRaceData());
+   }
 }
 
 /// <summary>
-///   Gets race data for the current race
+///   Gets race data for the current race, as it was published at the end of the last call to
+///   Main(). The reference stays valid and unchanged until the next publish, so it must not be
+///   kept across calls to Main(). Not for interrupt handlers, the data may be half rebuilt.
 /// </summary>
 ///
 /// <returns>
 ///   The race data struct
 /// </returns>
-RaceData RaceHandlerClass::GetRaceData() {
-   return GetRaceData(_CurrentRaceId);
+const RaceData &RaceHandlerClass::GetRaceData() const {
+   return _GetPublishedRaceData();
 }
 
 /// <summary>
-///   Gets race data for given race ID
+///   Gets race data for given race ID. Only the last NUM_HISTORIC_RACE_RECORDS races are kept, the
+///   record of an older race was overwritten by a newer one.
 /// </summary>
-
+///
 /// <param name="RaceId">The ID for the race you want the data for</param>
+/// <param name="Data">  [out] Race data struct, only valid if true is returned</param>
 ///
 /// <returns>
-///  Race data struct
+///  False if the race is not kept (anymore) or did not run yet
 /// </returns>
-RaceData RaceHandlerClass::GetRaceData(unsigned int RaceId) {
-   RaceData RequestedRaceData;
-
+bool RaceHandlerClass::GetRaceData(unsigned int RaceId, RaceData &Data) const {
    if (RaceId == _CurrentRaceId) {
-      //We need to return data for the current dace
-      RequestedRaceData.Id = _CurrentRaceId;
-      RequestedRaceData.StartTime = _RaceStartTime / 1000;
-      RequestedRaceData.EndTime = _RaceEndTime / 1000;
-      RequestedRaceData.ElapsedTime = _RaceTime / 1000;
-      // TODO: do logging
-      //Serial.printf("Elapsed1: %lu - %lu = %lu\r\n", micros(), _lRaceStartTime, _lRaceTime);
-      //Serial.printf("Elapsed2: %lu - %lu = %lu\r\n", GET_MICROS, _lRaceStartTime, _lRaceTime);
-      RequestedRaceData.TotalCrossingTime = this->GetTotalCrossingTimeMillis();
-      RequestedRaceData.RaceState = RaceState;
-
-      //Get Dog info
-      for (uint8_t dogIndex = 0; dogIndex < 4; dogIndex++) {
-         RequestedRaceData.DogData[dogIndex].DogNumber = dogIndex;
-
-         // WHAT IS i2?
-         for (uint8_t i2 = 0; i2 < 4; i2++) {
-            RequestedRaceData.DogData[dogIndex].Timing[i2].Time = GetDogTimeMillis(dogIndex, i2);
-            RequestedRaceData.DogData[dogIndex].Timing[i2].CrossingTime = GetCrossingTimeMillis(dogIndex, i2);
+      Data = _GetPublishedRaceData();
+      return true;
+   }
+
+   const RaceData &HistoricData = _HistoricRaceData[RaceId % NUM_HISTORIC_RACE_RECORDS];
+   if (RaceId > _CurrentRaceId || HistoricData.Id != RaceId) {
+      return false;
+   }
+
+   Data = HistoricData;
+   return true;
+}
+
+/// <summary>
+///   Builds the race data of the current race from the internal timing tables and publishes it.
+///   This is the only place where the race time and the time of a running dog are calculated, all
+///   getters read from the result. Finished runs are already kept in milliseconds. Readers run
+///   from loop() like this function, so they never see a half updated race.
+/// </summary>
+void RaceHandlerClass::_PublishRaceData() {
+   _RaceDataChanged = false;
+   if (RaceState == RACING && (long)(micros() - _RaceStartTime) > 0) {
+      _RaceTime = ClockCalibration.Correct(micros() - _RaceStartTime) / 1000;
+   }
+
+   //Published in place, in the record the race keeps in the history
+   RaceData &NewRaceData = _HistoricRaceData[_CurrentRaceId % NUM_HISTORIC_RACE_RECORDS];
+   NewRaceData.Id = _CurrentRaceId;
+   NewRaceData.StartTime = _RaceStartTime / 1000;
+   NewRaceData.EndTime = _RaceEndTime / 1000;
+   NewRaceData.ElapsedTime = (RaceState == STARTING) ? 0 : _RaceTime;
+   NewRaceData.RaceState = RaceState;
+   //Relative to the green light, so only known once the race runs
+   NewRaceData.FalseStartTime = (_FalseStartTriggerTime != 0 && RaceState != STARTING) ? ClockCalibration.Correct((long)(_FalseStartTriggerTime - _PerfectCrossingTime)) : 0;
+
+   long TotalCrossingTime = 0;
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      stDogData &DogData = NewRaceData.DogData[DogIndex];
+      DogData.DogNumber = DogIndex;
+      DogData.LastRunNumber = _DogRunCounters[DogIndex];
+      DogData.Fault = _DogFaults[DogIndex];
+      DogData.Running = (CurrentDogIndex == DogIndex);
+
+      for (uint8_t RunNumber = 0; RunNumber < RaceRules::MaxRunsPerDog; RunNumber++) {
+         unsigned long DogTimeMillis = _DogTimesMillis[DogIndex][RunNumber];
+
+         //Without a final time, check if the dog is running this run (and coming back) so we can
+         //show the time so far
+         if (DogTimeMillis == 0 && RaceState == RACING && CurrentDogIndex == DogIndex && _DogRunDirection == COMINGBACK
+            && RunNumber == _DogRunCounters[DogIndex]) {
+            DogTimeMillis = ClockCalibration.Correct(micros() - _DogEnterTimes[DogIndex]) / 1000;
+            long CrossingTimeMillis = _CrossingTimes[DogIndex][RunNumber] / 1000;
+            if (CrossingTimeMillis > 0 && DogTimeMillis > (unsigned long)CrossingTimeMillis) {
+               DogTimeMillis -= CrossingTimeMillis;
+            }
          }
 
-         RequestedRaceData.DogData[dogIndex].Fault = _DogFaults[dogIndex];
-         RequestedRaceData.DogData[dogIndex].Running = (CurrentDogIndex == dogIndex);
+         DogData.Timing[RunNumber].Time = DogTimeMillis;
+         DogData.Timing[RunNumber].CrossingTime = _CrossingTimes[DogIndex][RunNumber];
+         DogData.Timing[RunNumber].CrossingClass = _CrossingClasses[DogIndex][RunNumber];
+         DogData.Timing[RunNumber].EnterSpeed = _Speeds[DogIndex][RunNumber][GOINGIN];
+         DogData.Timing[RunNumber].ReturnSpeed = _Speeds[DogIndex][RunNumber][COMINGBACK];
+#ifdef BOX_SENSOR_PIN
+         DogData.Timing[RunNumber].OutrunTime = _BoxSplits[DogIndex][RunNumber][0];
+         DogData.Timing[RunNumber].TurnTime = _BoxSplits[DogIndex][RunNumber][1];
+#endif
+         TotalCrossingTime += _CrossingTimes[DogIndex][RunNumber];
       }
-   } else {
-      RequestedRaceData = _HistoricRaceData[RaceId];
    }
+   NewRaceData.TotalCrossingTime = TotalCrossingTime / 1000;
+}
 
-   return RequestedRaceData;
+/// <summary>
+///   Gets the published race data of the current race.
+/// </summary>
+const RaceData &RaceHandlerClass::_GetPublishedRaceData() const {
+   return _HistoricRaceData[_CurrentRaceId % NUM_HISTORIC_RACE_RECORDS];
+}
+
+/// <summary>
+///   Gets the timing data of one run of a dog.
+/// </summary>
+///
+/// <param name="DogIndex"> Zero-based index of the dog number. </param>
+/// <param name="RunNumber"> Zero-based index of the run number. A negative number selects the
+///                           last run of the dog. </param>
+const DogTimeData &RaceHandlerClass::_GetTiming(uint8_t DogIndex, int8_t RunNumber) const {
+   const stDogData &DogData = _GetPublishedRaceData().DogData[DogIndex];
+   return DogData.Timing[(RunNumber < 0) ? DogData.LastRunNumber : RunNumber];
 }
 
 /// <summary>
@@ -536,13 +1380,8 @@ RaceData RaceHandlerClass::GetRaceData(unsigned int RaceId) {
 /// <returns>
 ///   The race time in seconds with 2 decimals places.
 /// </returns>
-double RaceHandlerClass::GetRaceTime() {
-   double RaceTimeSeconds = 0;
-   if (RaceState != STARTING) {
-      RaceTimeSeconds = _RaceTime / 1000000.0;
-   }
-
-   return RaceTimeSeconds;
+double RaceHandlerClass::GetRaceTime() const {
+   return _GetPublishedRaceData().ElapsedTime / 1000.0;
 }
 
 /// <summary>
@@ -550,75 +1389,145 @@ double RaceHandlerClass::GetRaceTime() {
 ///   sequence is called.
 /// </summary>
 void RaceHandlerClass::StartRace() {
+   RaceJournal.StartHeat(_CurrentRaceId, micros());
    _ChangeRaceState(STARTING);
-   _RaceStartTime = micros() + 3000000;
+   //Expected start, until StartTimers() tells us when the green light really came on
+   _RaceStartTime = micros() + RaceRules::StartDelay;
    _PerfectCrossingTime = _RaceStartTime;
    _DogEnterTimes[0] = _RaceStartTime;
+   _StartMonitorIndex = _QueueReadIndex;
+   _FalseStartTriggerTime = 0;
 }
 
 /// <summary>
-///   Gets dogs crossing time. Keep in mind each dog can have multiple runs (reruns for faultS).
+///   Gets dogs crossing time as display text. Keep in mind each dog can have multiple runs (reruns
+///   for faults). The text is always 8 characters: the sign followed by the crossing time in
+///   seconds. Crossings below 1 second are shown with full microsecond resolution, leaving out the
+///   leading zero (e.g. "-.000400"), slower crossings with as many decimals as fit.
 /// </summary>
 ///
 /// <param name="DogIndex"> Zero-based index of the dog number. </param>
-/// <param name="RunNumber"> Zero-based index of the run number. If -1 is passed, this function
-///                           will alternate between each run we have for the dog, passing a new
-///                           run every 2 seconds. If -2 is passed, the last run number we have
-///                           for this dog will be passed. </param>
+/// <param name="RunNumber"> Zero-based index of the run number. If a negative number is passed,
+///                           the last run of this dog is used. </param>
 ///
 /// <returns>
-///   The dog time in seconds with 2 decimals.
+///   The crossing time in seconds.
 /// </returns>
-String RaceHandlerClass::GetCrossingTime(uint8_t DogIndex, int8_t RunNumber) {
-   double CrossingTime = 0;
-   char CharCrossingTime[8];
-   String StringCrossingTime;
-   long CrossingTimeMillis = GetCrossingTimeMillis(DogIndex, RunNumber);
-   CrossingTime = CrossingTimeMillis / 1000.0;
-
-   if (CrossingTime < 0) {
-      CrossingTime = fabs(CrossingTime);
-      StringCrossingTime = "-";
+String RaceHandlerClass::GetCrossingTime(uint8_t DogIndex, int8_t RunNumber) const {
+   char CharCrossingTime[10];
+   long CrossingTimeMicros = GetCrossingTimeMicros(DogIndex, RunNumber);
+   char Sign = (CrossingTimeMicros < 0) ? '-' : '+';
+   unsigned long AbsoluteCrossingTime = labs(CrossingTimeMicros);
+
+   if (AbsoluteCrossingTime < 1000000) {
+      sprintf_P(CharCrossingTime, PSTR("%c.%06lu"), Sign, AbsoluteCrossingTime);
    } else {
-      StringCrossingTime = "+";
+      uint8_t Decimals = 5;
+      if (AbsoluteCrossingTime >= 100000000) {
+         Decimals = 3;
+      } else if (AbsoluteCrossingTime >= 10000000) {
+         Decimals = 4;
+      }
+      CharCrossingTime[0] = Sign;
+      dtostrf(AbsoluteCrossingTime / 1000000.0, 7, Decimals, &CharCrossingTime[1]);
    }
 
-   dtostrf(CrossingTime, 7, 3, CharCrossingTime);
-   StringCrossingTime += CharCrossingTime;
+   return String(CharCrossingTime);
+}
 
-   return StringCrossingTime;
+long RaceHandlerClass::GetCrossingTimeMillis(uint8_t DogIndex, int8_t RunNumber) const {
+   return GetCrossingTimeMicros(DogIndex, RunNumber) / 1000;
 }
 
-unsigned long RaceHandlerClass::GetCrossingTimeMillis(uint8_t DogIndex, int8_t RunNumber) {
-   long CrossingTime = 0;
-   if (_DogRunCounters[DogIndex] > 0) {
-      //We have multiple times for this dog.
-      //if run number is -1 (unspecified), we have to cycle throug them
-      if (RunNumber == -1) {
-         auto &LastReturnedTimeStamp = _LastDogTimeReturnTimeStamp[DogIndex];
-         RunNumber = _LastReturnedRunNumber[DogIndex];
-         if ((millis() - LastReturnedTimeStamp) > 2000) {
-            if (RunNumber == _DogRunCounters[DogIndex]) {
-               RunNumber = 0;
-            } else {
-               RunNumber++;
-            }
+/// <summary>
+///   Gets dogs crossing time in microseconds. See GetCrossingTime() for the run number.
+/// </summary>
+long RaceHandlerClass::GetCrossingTimeMicros(uint8_t DogIndex, int8_t RunNumber) const {
+   return _GetTiming(DogIndex, RunNumber).CrossingTime;
+}
+
+/// <summary>
+///   Gets the classification of a dogs crossing. See GetCrossingTime() for the run number.
+/// </summary>
+RaceHandlerClass::CrossingClasses RaceHandlerClass::GetCrossingClass(uint8_t DogIndex, int8_t RunNumber) const {
+   return (CrossingClasses)_GetTiming(DogIndex, RunNumber).CrossingClass;
+}
+
+/// <summary>
+///   Gets the single character code of a crossing class, as used on the display and in telemetry.
+/// </summary>
+///
+/// <returns>
+///   'E' (early), 'P' (perfect), 'O' (ok), 'L' (late) or a space when not measured.
+/// </returns>
+char RaceHandlerClass::GetCrossingClassCode(CrossingClasses CrossingClass) {
+   switch (CrossingClass) {
+      case CROSSING_EARLY:
+         return 'E';
+      case CROSSING_PERFECT:
+         return 'P';
+      case CROSSING_OK:
+         return 'O';
+      case CROSSING_LATE:
+         return 'L';
+      default:
+         return ' ';
+   }
+}
 
-            LastReturnedTimeStamp = millis();
+/// <summary>
+///   Sends all measured crossings of the current race over telemetry, followed by the crossing
+///   statistics of the team. Frames: CRS (race, dog, run, crossing time in us, class code) for
+///   every crossing and CRT (race, number of crossings, early, perfect, ok and late counts, total
+///   of all non-early crossings in us, best and worst non-early crossing in us).
+/// </summary>
+void RaceHandlerClass::SendCrossingReport() {
+   uint8_t ClassCounts[CROSSING_LATE + 1] = {0};
+   unsigned long TotalCrossingTime = 0;
+   long BestCrossingTime = 0;
+   long WorstCrossingTime = 0;
+   uint8_t CrossingCount = 0;
+
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      for (uint8_t RunNumber = 0; RunNumber <= _DogRunCounters[DogIndex]; RunNumber++) {
+         uint8_t CrossingClass = _CrossingClasses[DogIndex][RunNumber];
+         if (CrossingClass == CROSSING_NONE) {
+            continue;
          }
 
-         _LastReturnedRunNumber[DogIndex] = RunNumber;
-      } else if (RunNumber == -2) {
-         //if RunNumber is -2 it means we should return the last one
-         RunNumber = _DogRunCounters[DogIndex];
+         long CrossingTime = _CrossingTimes[DogIndex][RunNumber];
+         Telemetry.BeginFrame(F("CRS"));
+         Telemetry.AddField(_CurrentRaceId);
+         Telemetry.AddField(DogIndex);
+         Telemetry.AddField(RunNumber);
+         Telemetry.AddField(CrossingTime);
+         Telemetry.AddField(GetCrossingClassCode((CrossingClasses)CrossingClass));
+         Telemetry.EndFrame();
+
+         ClassCounts[CrossingClass]++;
+         CrossingCount++;
+         if (CrossingClass != CROSSING_EARLY) {
+            if (ClassCounts[CROSSING_PERFECT] + ClassCounts[CROSSING_OK] + ClassCounts[CROSSING_LATE] == 1 || CrossingTime < BestCrossingTime) {
+               BestCrossingTime = CrossingTime;
+            }
+            if (CrossingTime > WorstCrossingTime) {
+               WorstCrossingTime = CrossingTime;
+            }
+            TotalCrossingTime += CrossingTime;
+         }
       }
-   } else if (RunNumber < 0) {
-      RunNumber = 0;
    }
 
-   CrossingTime = _CrossingTimes[DogIndex][RunNumber] / 1000;
-
-   return CrossingTime;
+   Telemetry.BeginFrame(F("CRT"));
+   Telemetry.AddField(_CurrentRaceId);
+   Telemetry.AddField(CrossingCount);
+   for (uint8_t CrossingClass = CROSSING_EARLY; CrossingClass <= CROSSING_LATE; CrossingClass++) {
+      Telemetry.AddField(ClassCounts[CrossingClass]);
+   }
+   Telemetry.AddField(TotalCrossingTime);
+   Telemetry.AddField(BestCrossingTime);
+   Telemetry.AddField(WorstCrossingTime);
+   Telemetry.EndFrame();
 }
 
 /// <summary>
@@ -627,70 +1536,18 @@ unsigned long RaceHandlerClass::GetCrossingTimeMillis(uint8_t DogIndex, int8_t R
 /// </summary>
 ///
 /// <param name="DogIndex"> Zero-based index of the dog number. </param>
-/// <param name="RunNumber"> Zero-based index of the run number. If -1 is passed, this function
-///                           will alternate between each run we have for the dog, passing a new
-///                           run every 2 seconds. If -2 is passed, the last run number we have
-///                           for this dog will be passed. </param>
+/// <param name="RunNumber"> Zero-based index of the run number. If a negative number is passed,
+///                           the last run of this dog is used. </param>
 ///
 /// <returns>
 ///   The dog time in seconds with 2 decimals.
 /// </returns>
-double RaceHandlerClass::GetDogTime(uint8_t DogIndex, int8_t RunNumber) {
-   double DogTime;
-   unsigned long DogTimeMillis = GetDogTimeMillis(DogIndex, RunNumber);
-   DogTime = DogTimeMillis / 1000.0;
-
-   return DogTime;
+double RaceHandlerClass::GetDogTime(uint8_t DogIndex, int8_t RunNumber) const {
+   return GetDogTimeMillis(DogIndex, RunNumber) / 1000.0;
 }
 
-unsigned long RaceHandlerClass::GetDogTimeMillis(uint8_t DogIndex, int8_t RunNumber) {
-   unsigned long DogTimeMillis = 0;
-
-   if (_DogRunCounters[DogIndex] > 0) {
-      //We have multiple times for this dog.
-      //if run number is -1 (unspecified), we have to cycle throug them
-      if (RunNumber == -1) {
-         auto &LastReturnedTimeStamp = _LastDogTimeReturnTimeStamp[DogIndex];
-
-         RunNumber = _LastReturnedRunNumber[DogIndex];
-
-         if ((millis() - LastReturnedTimeStamp) > 2000) {
-            if (RunNumber == _DogRunCounters[DogIndex]) {
-               RunNumber = 0;
-            } else {
-               RunNumber++;
-            }
-
-            LastReturnedTimeStamp = millis();
-         }
-
-         _LastReturnedRunNumber[DogIndex] = RunNumber;
-      } else if (RunNumber == -2) {
-         //if RunNumber is -2 it means we should return the last one
-         RunNumber = _DogRunCounters[DogIndex];
-      }
-   } else if (RunNumber < 0) {
-      RunNumber = 0;
-   }
-
-   //First check if we have final time for the requested dog number
-   if (_DogTimes[DogIndex][RunNumber] > 0) {
-      DogTimeMillis = _DogTimes[DogIndex][RunNumber] / 1000;
-
-
-   // Then check if the requested dog is perhaps running (and coming back) so we can return the time so far
-   // And if requested run number is lower then number of times dog has run 
-   } else if ((RaceState == RACING && CurrentDogIndex == DogIndex && _DogRunDirection == COMINGBACK) && RunNumber <= _DogRunCounters[DogIndex]){
-      DogTimeMillis = (micros() - _DogEnterTimes[DogIndex]) / 1000;
-   }
-
-   //Fixes issue 7 (https://github.com/vyruz1986/FlyballETS-Software/issues/7)
-   //Only deduct crossing time if it is positive
-   if (_CrossingTimes[DogIndex][RunNumber] > 0 && DogTimeMillis > (_CrossingTimes[DogIndex][RunNumber] / 1000)) {
-      DogTimeMillis -= (_CrossingTimes[DogIndex][RunNumber] / 1000);
-   }
-
-   return DogTimeMillis;
+unsigned long RaceHandlerClass::GetDogTimeMillis(uint8_t DogIndex, int8_t RunNumber) const {
+   return _GetTiming(DogIndex, RunNumber).Time;
 }
 
 /// <summary>
@@ -702,15 +1559,8 @@ unsigned long RaceHandlerClass::GetDogTimeMillis(uint8_t DogIndex, int8_t RunNum
 /// <returns>
 ///   The total crossing time in milliseconds
 /// </returns>
-long RaceHandlerClass::GetTotalCrossingTimeMillis() {
-   long TotalCrossingTime = 0;
-
-   for (auto &Dog : _CrossingTimes) {
-      for (auto &Time : Dog) {
-         TotalCrossingTime += Time;
-      }
-   }
-   return TotalCrossingTime / 1000;
+long RaceHandlerClass::GetTotalCrossingTimeMillis() const {
+   return _GetPublishedRaceData().TotalCrossingTime;
 }
 
 /// <summary>
@@ -722,9 +1572,8 @@ long RaceHandlerClass::GetTotalCrossingTimeMillis() {
 /// <returns>
 ///   The total crossing time in seconds with 2 decimals.
 /// </returns>
-double RaceHandlerClass::GetTotalCrossingTime() {
-   double TotalCrossingTime = this->GetTotalCrossingTimeMillis() / 1000.0;
-   return TotalCrossingTime;
+double RaceHandlerClass::GetTotalCrossingTime() const {
+   return _GetPublishedRaceData().TotalCrossingTime / 1000.0;
 }
 
 /// <summary>
@@ -737,31 +1586,42 @@ void RaceHandlerClass::_ChangeRaceState(RaceStates NewRaceState) {
    if (RaceState != NewRaceState) {
       PreviousRaceState = RaceState;
       RaceState = NewRaceState;
+      _RaceDataChanged = true;
+      RaceJournal.LogRecord(RaceJournal.RACE_STATE, NewRaceState, micros());
+      _RaiseEvent(STATE_CHANGED, CurrentDogIndex, NewRaceState);
    }
 }
 
 /// <summary>
-///   Gets rerun information to put on LCD. If a dog has done more than 1 run, before the dogs
-///   time we will display and * (asterisk) followed by the run number for which we are showing
-///   the time. If a dog has not done a rerun, the space before the dogs time is empty.
+///   Gets the highest number of records which were waiting in the sensor trigger queue during the
+///   current race. This should stay well below TRIGGER_QUEUE_LENGTH.
+/// </summary>
+uint8_t RaceHandlerClass::GetQueueHighWaterMark() {
+   return _QueueHighWaterMark;
+}
+
+/// <summary>
+///   Gets the number of sensor records which were dropped during the current race because the
+///   sensor trigger queue was full. Anything but 0 means the timing of the race can't be trusted.
+/// </summary>
+uint8_t RaceHandlerClass::GetQueueOverflows() {
+   return _QueueOverflows;
+}
+
+/// <summary>
+///   Gets the number of reruns a dog has done (0 if the dog only did its first run).
 /// </summary>
 ///
-/// <param name="DogIndex"> Zero-based index of the dog number. </param>
-///
-/// <returns>
-///   The rerun information. * (asterisk) followed by run number if there is more than 1 run for
-///   this dog. Empty string if the dog did only do 1 run.
-/// </returns>
-String RaceHandlerClass::GetRerunInfo(uint8_t DogIndex) {
-   String RerunInfo = "  ";
+/// <param name="DogIndex"> Zero-based index of the dog. </param>
+uint8_t RaceHandlerClass::GetRunCount(uint8_t DogIndex) const {
+   return _GetPublishedRaceData().DogData[DogIndex].LastRunNumber;
+}
 
-   uint8_t RunNumber = _LastReturnedRunNumber[DogIndex];
-   if (_DogRunCounters[DogIndex] > 0)
-   {
-      RerunInfo = "*";
-      RerunInfo += (RunNumber + 1);
-   }
-   return RerunInfo;
+/// <summary>
+///   Gets the highest number of records processed in a single call of Main() during the current race.
+/// </summary>
+uint8_t RaceHandlerClass::GetLargestQueueBatch() {
+   return _LargestQueueBatch;
 }
 
 /// <summary>
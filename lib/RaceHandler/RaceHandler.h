@@ -4,7 +4,20 @@
 #include "Arduino.h"
 #include "Structs.h"
 
-#define NUM_HISTORIC_RACE_RECORDS 100
+//Each record takes sizeof(RaceData) (about 215 bytes, 279 with a box sensor) of SRAM, older races are only kept in the
+//journal in EEPROM. The running race is published in its own record, so 2 keeps the previous race.
+#ifndef NUM_HISTORIC_RACE_RECORDS
+#define NUM_HISTORIC_RACE_RECORDS 2
+#endif
+
+//Sensor number of the optional box sensor (BOX_SENSOR_PIN), its edges share the queue with the gate sensors
+#define BOX_SENSOR_NUMBER 3
+//A faulted dog whose box hit was missed is seen coming back once this time (microseconds) passed since
+//it went in, or since the dog it overtook came back. Not shorter than RaceRules::FalseCrossingWindow, so
+//a slow previous dog is still caught.
+#ifndef BOX_HIT_TIMEOUT
+#define BOX_HIT_TIMEOUT 2500000
+#endif
 
 class RaceHandlerClass {
    public:
@@ -27,28 +40,86 @@ class RaceHandlerClass {
          TOGGLE
       };
 
+      //Classification of a crossing, see RaceRules for the thresholds
+      enum CrossingClasses
+      {
+         CROSSING_NONE,    //Not measured (yet)
+         CROSSING_EARLY,   //Too early, this is a fault
+         CROSSING_PERFECT,
+         CROSSING_OK,
+         CROSSING_LATE
+      };
+
+      //Transition string patterns as logged to the race journal
+      enum TransitionPatterns
+      {
+         DOG_GOING_IN,     //ABab
+         DOG_COMING_BACK,  //BAba
+         SMALL_OBJECT,     //BbAa
+         MULTIPLE_DOGS     //Anything else
+      };
+
+      enum RaceEventTypes
+      {
+         DOG_FINISHED,        //Value: dog time in milliseconds
+         CROSSING_MEASURED,   //Value: crossing time in microseconds
+         FAULT_CHANGED,       //Value: new fault state
+         STATE_CHANGED,       //Value: new race state, also sent when the race is reset
+         DOG_CHANGED,         //DogIndex: the dog which is now running, also sent when a dog reruns right after itself. Value: race time in milliseconds at which its run started
+         TICK,                //Value: race time in milliseconds, sent every RACE_TICK_INTERVAL ms
+         FALSE_START,         //Value: beam break before the green light, relative to the expected start in microseconds
+         RERUN_NOT_QUEUED     //Value: runs of the dog, it faulted but its run table has no room for a rerun
+      };
+
+      struct RaceEvent {
+         RaceEventTypes Type;
+         uint8_t DogIndex;
+         uint8_t RunNumber;
+         long Value;
+      };
+
+      typedef void (*RaceEventHandler)(const RaceEvent &Event);
+      bool Subscribe(RaceEventHandler Handler);
+
       RaceStates RaceState = STOP;
       RaceStates PreviousRaceState = STOP;
 
       void TriggerSensor1();
       void TriggerSensor2();
+#ifdef BOX_SENSOR_PIN
+      void TriggerBoxSensor();
+#endif
+      void PushSensorEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime);
       void ResetRace();
-      void StartTimers();
+      void StartTimers(unsigned long GreenTime);
       void Main();
       void SetDogFault(uint8_t DogIndex, DogFaults State = TOGGLE);
       void StopRace();
       void StopRace(unsigned long StopTime);
-      double GetRaceTime();
-      RaceData GetRaceData();
-      RaceData GetRaceData(unsigned int RaceId);
-      long GetTotalCrossingTimeMillis();
-      double GetTotalCrossingTime();
-      double GetDogTime(uint8_t DogIndex, int8_t RunNumber = -1);
-      unsigned long GetDogTimeMillis(uint8_t DogIndex, int8_t RunNumber = -1);
-      String GetCrossingTime(uint8_t DogIndex, int8_t RunNumber = -1);
-      unsigned long GetCrossingTimeMillis(uint8_t DogIndex, int8_t RunNumber = -1);
+      double GetRaceTime() const;
+      const RaceData &GetRaceData() const;
+      bool GetRaceData(unsigned int RaceId, RaceData &Data) const;
+      long GetTotalCrossingTimeMillis() const;
+      double GetTotalCrossingTime() const;
+      double GetDogTime(uint8_t DogIndex, int8_t RunNumber = -1) const;
+      unsigned long GetDogTimeMillis(uint8_t DogIndex, int8_t RunNumber = -1) const;
+      String GetCrossingTime(uint8_t DogIndex, int8_t RunNumber = -1) const;
+      long GetCrossingTimeMillis(uint8_t DogIndex, int8_t RunNumber = -1) const;
+      long GetCrossingTimeMicros(uint8_t DogIndex, int8_t RunNumber = -1) const;
+      CrossingClasses GetCrossingClass(uint8_t DogIndex, int8_t RunNumber = -1) const;
+      static char GetCrossingClassCode(CrossingClasses CrossingClass);
+      void SendCrossingReport();
+      uint8_t GetQueueHighWaterMark();
+      uint8_t GetQueueOverflows();
+      uint8_t GetRunCount(uint8_t DogIndex) const;
+      bool GetNextRerunDog(uint8_t &DogIndex) const;
+      uint8_t GetLargestQueueBatch();
       void StartRace();
-      String GetRerunInfo(uint8_t DogIndex);
+      void SetSensorOffsets(const long Offsets[2][2]);
+      void GetSensorOffsets(long Offsets[2][2]) const;
+      bool StartSensorCalibration();
+      void StopSensorCalibration();
+      bool IsCalibratingSensors() const;
 
       String GetRaceStateString();
 
@@ -60,19 +131,31 @@ class RaceHandlerClass {
       unsigned long _LastTransitionStringUpdate;
       unsigned long _PerfectCrossingTime;
       bool _AreGatesClear = false;
-      bool _DogFaults[4];
-      long _CrossingTimes[4][4];
-      uint8_t _DogRunCounters[4]; //Number of (re-)runs for each dog
-      unsigned long _DogEnterTimes[4];
-      unsigned long _DogExitTimes[4];
-      unsigned long _DogTimes[4][4];
+      bool _DogFaults[RaceRules::DogsPerTeam];
+      long _CrossingTimes[RaceRules::DogsPerTeam][RaceRules::MaxRunsPerDog];
+      uint8_t _CrossingClasses[RaceRules::DogsPerTeam][RaceRules::MaxRunsPerDog];
+      uint8_t _Speeds[RaceRules::DogsPerTeam][RaceRules::MaxRunsPerDog][2]; //0.1 m/s, [dog][run][direction]
+      uint8_t _DogRunCounters[RaceRules::DogsPerTeam]; //Number of (re-)runs for each dog
+      unsigned long _DogEnterTimes[RaceRules::DogsPerTeam];
+      unsigned long _DogExitTimes[RaceRules::DogsPerTeam];
+      unsigned long _DogTimes[RaceRules::DogsPerTeam][RaceRules::MaxRunsPerDog];
+      uint16_t _DogTimesMillis[RaceRules::DogsPerTeam][RaceRules::MaxRunsPerDog]; //Published dog times, crossing deducted
       bool _RerunBusy;
-      unsigned long long _RaceEndTime;
-      unsigned long long _RaceTime;
-      unsigned long long _RaceStartTime;
+      uint8_t _FaultCount; //Number of dogs with a fault set
+
+      //Dogs which still owe a rerun, in the order in which they should run
+      uint8_t _RerunQueue[RaceRules::DogsPerTeam];
+      uint8_t _RerunQueueHead;
+      uint8_t _RerunQueueLength;
+      bool _RerunQueued[RaceRules::DogsPerTeam];
+      //Runs of the heat in the order they were run, dog index << 4 | run number
+      uint8_t _RunOrder[RaceRules::DogsPerTeam * RaceRules::MaxRunsPerDog];
+      uint8_t _RunCount;
+      bool _DogRunCompleted[RaceRules::DogsPerTeam]; //True when the current run of the dog is finished
+      unsigned long _RaceEndTime;
+      unsigned long _RaceTime;      //Milliseconds
+      unsigned long _RaceStartTime;
       unsigned int _CurrentRaceId;
-      unsigned long _LastDogTimeReturnTimeStamp[4];
-      uint8_t _LastReturnedRunNumber[4];
 
       String _Transition;
 
@@ -85,8 +168,8 @@ class RaceHandlerClass {
 
       struct SensorTriggerRecord {
          volatile uint8_t sensorNumber;
-         volatile long long triggerTime;
-         volatile int sensorState;
+         volatile unsigned long triggerTime;
+         volatile uint8_t sensorState;
       };
 
       #define TRIGGER_QUEUE_LENGTH 50
@@ -94,18 +177,83 @@ class RaceHandlerClass {
 
       volatile uint8_t _QueueReadIndex;
       volatile uint8_t _QueueWriteIndex;
+      volatile uint8_t _QueueHighWaterMark;
+      volatile uint8_t _QueueOverflows;   //Records dropped because the queue was full, saturates at 255
+      uint8_t _LargestQueueBatch;
+
+      #ifndef QUEUE_BATCH_BUDGET
+      #define QUEUE_BATCH_BUDGET 2000 //Time (us) Main() may spend on queued records per call
+      #endif
 
       void _QueuePush(SensorTriggerRecord _InterruptTrigger);
       void _ChangeRaceState(RaceStates _NewRaceState);
       bool _QueueEmpty();
       SensorTriggerRecord _QueuePop();
       void _ChangeDogIndex(uint8_t _NewDogIndex);
+      void _HandleSensorQueue();
+      void _MonitorStart();
+      uint8_t _StartMonitorIndex;               //Next queue record to check for a false start
+      unsigned long _FalseStartTriggerTime;     //First handlers side beam break while STARTING, 0 if none
+      void _SetDogTime(uint8_t DogIndex, unsigned long DogTime);
+      bool _HasTurned(uint8_t DogIndex, unsigned long TriggerTime);
+      void _SetBoxDog(uint8_t DogIndex);
+
+#ifdef BOX_SENSOR_PIN
+      //Box sensor hit and release of the current run of each dog, 0 if not seen. Box edges belong to
+      //the dog which went in last, which is not the running dog when a dog crossed early.
+      uint8_t _BoxDogIndex;
+      unsigned long _BoxHitTimes[RaceRules::DogsPerTeam];
+      unsigned long _BoxReleaseTimes[RaceRules::DogsPerTeam];
+      bool _BoxHitsSeen;   //The box sensor saw a dog in this race, from then on it tells which dog turned
+      uint16_t _BoxSplits[RaceRules::DogsPerTeam][RaceRules::MaxRunsPerDog][2]; //Outrun and turn time in ms
+      void _HandleBoxEdge(uint8_t SensorState, unsigned long TriggerTime);
+      void _SetBoxSplits(uint8_t DogIndex);
+#endif
+
+      //Receiver delay (us) per [sensor number - 1][sensor state], subtracted from every trigger time
+      //before it is decoded. The journal keeps the raw trigger times.
+      long _SensorOffsets[2][2] = {};
+      volatile bool _CalibratingSensors = false;  //Sensor edges are sent to SensorCalibration while stopped
+      void _HandleCalibrationQueue();
+
+      //Events are collected while the sensor queue is handled and sent to all subscribers at the end
+      //of Main(), so subscribers always see the state after the whole batch was processed. A batch
+      //stops early when the event queue can't take the events of another record.
+      #define MAX_RACE_EVENT_SUBSCRIBERS 4
+      #define RACE_EVENT_QUEUE_LENGTH 16
+      #define RACE_EVENTS_PER_RECORD 6   //Most events a single sensor record can raise
+      #define RACE_TICK_INTERVAL 100
+      RaceEventHandler _EventSubscribers[MAX_RACE_EVENT_SUBSCRIBERS];
+      uint8_t _EventSubscriberCount = 0;
+      RaceEvent _PendingEvents[RACE_EVENT_QUEUE_LENGTH];
+      uint8_t _PendingEventCount = 0;
+      unsigned long _LastTickTime = 0;
+      void _RaiseEvent(RaceEventTypes Type, uint8_t DogIndex, long Value);
+      void _DispatchEvents();
+      void _SetCrossingTime(uint8_t DogIndex, long CrossingTime, unsigned long EventTime);
+      void _SetCrossingTime(uint8_t DogIndex, long CrossingTime);
+      static CrossingClasses _ClassifyCrossing(long CrossingTime);
+      uint8_t _GetNextDogIndex();
+      void _CompleteDogRun(uint8_t DogIndex);
+      void _EnqueueRerun(uint8_t DogIndex);
+      void _RemoveRerun(uint8_t DogIndex);
+      void _CheckReconstruction();
+      bool _ReconstructionPending = false;   //The heat stopped, the next Main() checks it against the race journal
+      unsigned long _GetExpectedLaneTime(uint8_t DogIndex, unsigned long HeatLaneTime);
+      void _SendDisagreement(uint8_t DogIndex, uint8_t RunNumber, char Field, long LiveValue, long ReconstructedValue);
 
+      //Race data of the last races. The record of the current race is rebuilt by _PublishRaceData()
+      //and read by all getters. Only code running from loop() reads it, so it is never seen half built.
       RaceData _HistoricRaceData[NUM_HISTORIC_RACE_RECORDS];
+      bool _RaceDataChanged = false;   //Set by everything which changes the race data, Main() publishes it
+      void _PublishRaceData();
+      const RaceData &_GetPublishedRaceData() const;
+      const DogTimeData &_GetTiming(uint8_t DogIndex, int8_t RunNumber) const;
 
       void _AddToTransitionString(SensorTriggerRecord _InterruptTrigger);
 
       void _ChangeDogRunDirection(_DogRunDirections NewDogRunDirection);
+      void _MeasureSpeed(uint8_t DogIndex, _DogRunDirections Direction);
 };
 
 extern RaceHandlerClass RaceHandler;
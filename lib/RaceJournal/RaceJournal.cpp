@@ -0,0 +1,417 @@
+#include "RaceJournal.h"
+#include <EEPROM.h>
+#include <Telemetry.h>
+
+/// <summary>
+///   Starts a new journal for a heat, any records of the previous heat which were not flushed yet
+///   are discarded. A flush of the previous heat which is still busy is finished first, which only
+///   blocks when the heat starts within seconds after the previous one was flushed. An export of
+///   the previous heat from RAM is stopped, it ends without JRE frame.
+/// </summary>
+///
+/// <param name="RaceId">     ID of the race this journal belongs to. </param>
+/// <param name="StartTime">  Time base (in microseconds) of the journal. </param>
+void RaceJournalClass::StartHeat(unsigned int RaceId, unsigned long StartTime) {
+   _FinishFlush();
+   if (_Export.EepromAddress < 0) {
+      _Export.Busy = false;
+   }
+
+   _RaceId = RaceId;
+   _StartTime = StartTime;
+   _TailTime = StartTime;
+   _LastTime = StartTime;
+   _Head = 0;
+   _Tail = 0;
+   _Used = 0;
+   _RecordsDropped = false;
+   _HeatStarted = true;
+}
+
+/// <summary>
+///   Logs a sensor edge exactly as it was popped from the sensor trigger queue.
+/// </summary>
+///
+/// <param name="SensorNumber"> The sensor number (1-3). </param>
+/// <param name="SensorState">  The sensor state (HIGH/LOW). </param>
+/// <param name="TriggerTime">  The trigger time in microseconds. </param>
+void RaceJournalClass::LogEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime) {
+   LogRecord(SENSOR_EDGE, (SensorNumber << 1) | (SensorState & 0x01), TriggerTime);
+}
+
+/// <summary>
+///   Appends a timed record to the journal. The time is stored as a varint delta to the previous
+///   timed record, so records which happen at the same time as the last edge only cost 2 bytes.
+/// </summary>
+///
+/// <param name="Type">     The record type. </param>
+/// <param name="Payload">  The payload, only the lower 4 bits are stored. </param>
+/// <param name="Time">     The time of the record in microseconds. </param>
+void RaceJournalClass::LogRecord(RecordTypes Type, uint8_t Payload, unsigned long Time) {
+   if (!_HeatStarted) {
+      return;
+   }
+
+   uint8_t Varint[5];
+   uint8_t VarintLength = 0;
+   unsigned long Delta = Time - _LastTime;
+   do {
+      Varint[VarintLength] = Delta & 0x7F;
+      Delta >>= 7;
+      if (Delta != 0) {
+         Varint[VarintLength] |= 0x80;
+      }
+      VarintLength++;
+   } while (Delta != 0);
+
+   _MakeRoom(1 + VarintLength);
+   _Push((Type << 4) | (Payload & 0x0F));
+   for (uint8_t i = 0; i < VarintLength; i++) {
+      _Push(Varint[i]);
+   }
+   _LastTime = Time;
+}
+
+/// <summary>
+///   Appends a decision record to the journal. Decision records carry no time of their own, they
+///   belong to the timed record (usually the sensor edge) logged right before them.
+/// </summary>
+///
+/// <param name="Type">     The record type. </param>
+/// <param name="Payload">  The payload, only the lower 4 bits are stored. </param>
+void RaceJournalClass::LogRecord(RecordTypes Type, uint8_t Payload) {
+   if (!_HeatStarted) {
+      return;
+   }
+
+   _MakeRoom(1);
+   _Push((Type << 4) | (Payload & 0x0F));
+}
+
+/// <summary>
+///   Starts writing the journal of the current heat to its EEPROM slot, Main() writes it. Every
+///   changed byte takes roughly 3.3ms to write, a full ring over 3 seconds, so Main() writes one
+///   byte per call and a loop never waits longer than one EEPROM write. The records are written
+///   before the header, so the slot only shows up as a journal once it is complete. Flushing the
+///   same heat again (e.g. after records were added) only writes the bytes which changed.
+/// </summary>
+void RaceJournalClass::Flush() {
+   if (!_HeatStarted) {
+      return;
+   }
+
+   JournalSlotHeader Header;
+   EEPROM.get(_GetSlotAddress(_RaceId), Header);
+   _Flush.Invalidate = Header.Magic != JOURNAL_SLOT_MAGIC || Header.RaceId != (uint16_t)_RaceId || Header.TailTime != _TailTime;
+   _Flush.Length = _Used;
+   _Flush.Offset = 0;
+   _Flush.Busy = true;
+}
+
+/// <summary>
+///   Starts the export of the journal of the given race over telemetry, the records are sent by
+///   Main(). The current heat is exported from RAM, older heats are exported from EEPROM if their
+///   slot was not overwritten yet. An export which is still busy is stopped, it ends without JRE
+///   frame. The RAM ring must not change during the export, so don't export the current heat
+///   while it is running.
+/// </summary>
+///
+/// <param name="RaceId">  ID of the race to export. </param>
+///
+/// <returns>
+///   true if a journal was found for the given race, false if not.
+/// </returns>
+bool RaceJournalClass::Export(unsigned int RaceId) {
+   if (_HeatStarted && RaceId == _RaceId) {
+      _StartExport(_RaceId, _StartTime, _TailTime, _Used, _RecordsDropped, -1);
+      return true;
+   }
+
+   int Address = _GetSlotAddress(RaceId);
+   JournalSlotHeader Header;
+   EEPROM.get(Address, Header);
+   if (Header.Magic != JOURNAL_SLOT_MAGIC || Header.RaceId != (uint16_t)RaceId || Header.Length > JOURNAL_BUFFER_SIZE) {
+      return false;
+   }
+
+   _StartExport(RaceId, Header.StartTime, Header.TailTime, Header.Length, Header.RecordsDropped, Address + sizeof(JournalSlotHeader));
+   return true;
+}
+
+/// <summary>
+///   Sends the next records of a busy export, at most JOURNAL_EXPORT_FRAMES frames per call, and
+///   writes the next byte of a busy flush. A whole journal is a few thousand bytes, which would
+///   block the main loop for a few hundred milliseconds if it was sent at once, and for seconds if
+///   it was written to EEPROM at once. This function should be called once every main loop.
+/// </summary>
+void RaceJournalClass::Main() {
+   for (uint8_t Frame = 0; Frame < JOURNAL_EXPORT_FRAMES && _Export.Busy; Frame++) {
+      _ExportNextRecord();
+   }
+
+   //Unchanged bytes cost only a read, stop at the first byte which had to be written
+   for (uint8_t i = 0; i < JOURNAL_FLUSH_BYTES && _Flush.Busy; i++) {
+      if (_FlushNextByte()) {
+         break;
+      }
+   }
+}
+
+/// <summary>
+///   Determines whether the journal is still being written to its EEPROM slot.
+/// </summary>
+bool RaceJournalClass::IsFlushing() {
+   return _Flush.Busy;
+}
+
+/// <summary>
+///   Determines whether an export is still sending records.
+/// </summary>
+bool RaceJournalClass::IsExporting() {
+   return _Export.Busy;
+}
+
+/// <summary>
+///   Gets the number of bytes used in the RAM ring buffer.
+/// </summary>
+uint16_t RaceJournalClass::GetUsedBytes() {
+   return _Used;
+}
+
+/// <summary>
+///   Determines whether the RAM ring still holds every record of the current heat.
+/// </summary>
+bool RaceJournalClass::IsComplete() {
+   return _HeatStarted && !_RecordsDropped;
+}
+
+/// <summary>
+///   Positions a cursor on the oldest record in the RAM ring.
+/// </summary>
+///
+/// <param name="Position">   [out] The cursor. </param>
+void RaceJournalClass::OpenCursor(Cursor &Position) {
+   Position.Offset = 0;
+   Position.Time = _TailTime;
+}
+
+/// <summary>
+///   Reads the next record from the RAM ring. For timed records the time of the cursor is advanced
+///   to the time of the record, decision records keep the time of the timed record before them.
+/// </summary>
+///
+/// <param name="Position">   [in,out] The cursor. </param>
+/// <param name="Type">       [out] The record type. </param>
+/// <param name="Payload">    [out] The payload. </param>
+///
+/// <returns>
+///   true if a record was read, false if the cursor is at the end of the journal.
+/// </returns>
+bool RaceJournalClass::ReadRecord(Cursor &Position, uint8_t &Type, uint8_t &Payload) {
+   if (Position.Offset >= _Used) {
+      return false;
+   }
+
+   uint8_t Header = _PeekAt(Position.Offset++);
+   Type = Header >> 4;
+   Payload = Header & 0x0F;
+
+   if (_IsTimed(Type)) {
+      unsigned long Delta = 0;
+      uint8_t Shift = 0;
+      uint8_t Byte;
+      do {
+         Byte = _PeekAt(Position.Offset++);
+         Delta |= (unsigned long)(Byte & 0x7F) << Shift;
+         Shift += 7;
+      } while ((Byte & 0x80) && Position.Offset < _Used);
+      Position.Time += Delta;
+   }
+   return true;
+}
+
+/// <summary>
+///   Starts an export: sends the JRH header frame (race id, length in bytes, records dropped) and
+///   positions the export on the first record.
+/// </summary>
+///
+/// <param name="EepromAddress">   EEPROM address of the records, or -1 to read the RAM ring. </param>
+void RaceJournalClass::_StartExport(unsigned int RaceId, unsigned long StartTime, unsigned long TailTime, uint16_t Length, bool RecordsDropped, int EepromAddress) {
+   Telemetry.BeginFrame(F("JRH"));
+   Telemetry.AddField(RaceId);
+   Telemetry.AddField(Length);
+   Telemetry.AddField((int)RecordsDropped);
+   Telemetry.EndFrame();
+
+   _Export = {true, RaceId, StartTime, TailTime, Length, 0, 0, EepromAddress};
+}
+
+/// <summary>
+///   Decodes the next record of the export and sends it as a JRN frame (race id, time since start
+///   of heat in microseconds, type, payload). After the last record a JRE frame with the number of
+///   records is sent instead and the export ends.
+/// </summary>
+void RaceJournalClass::_ExportNextRecord() {
+   if (_Export.Offset >= _Export.Length) {
+      Telemetry.BeginFrame(F("JRE"));
+      Telemetry.AddField(_Export.RaceId);
+      Telemetry.AddField(_Export.RecordCount);
+      Telemetry.EndFrame();
+      _Export.Busy = false;
+      return;
+   }
+
+   uint8_t Header = _ReadExportByte();
+   if (_IsTimed(Header >> 4)) {
+      unsigned long Delta = 0;
+      uint8_t Shift = 0;
+      uint8_t Byte;
+      do {
+         Byte = _ReadExportByte();
+         Delta |= (unsigned long)(Byte & 0x7F) << Shift;
+         Shift += 7;
+      } while ((Byte & 0x80) && _Export.Offset < _Export.Length);
+      _Export.Time += Delta;
+   }
+
+   Telemetry.BeginFrame(F("JRN"));
+   Telemetry.AddField(_Export.RaceId);
+   Telemetry.AddField((long)(_Export.Time - _Export.StartTime));
+   Telemetry.AddField(Header >> 4);
+   Telemetry.AddField(Header & 0x0F);
+   Telemetry.EndFrame();
+   _Export.RecordCount++;
+}
+
+/// <summary>
+///   Reads the byte of the export at its offset, from RAM or EEPROM, and advances the offset.
+/// </summary>
+uint8_t RaceJournalClass::_ReadExportByte() {
+   uint16_t Offset = _Export.Offset++;
+   return (_Export.EepromAddress < 0) ? _PeekAt(Offset) : EEPROM.read(_Export.EepromAddress + Offset);
+}
+
+/// <summary>
+///   Determines whether records of the given type are followed by a time delta.
+/// </summary>
+bool RaceJournalClass::_IsTimed(uint8_t Type) {
+   return Type == SENSOR_EDGE || Type == RACE_STATE;
+}
+
+/// <summary>
+///   Gets the EEPROM address of the slot of the given race.
+/// </summary>
+int RaceJournalClass::_GetSlotAddress(unsigned int RaceId) {
+   return EEPROM_JOURNAL_START + (RaceId % JOURNAL_EEPROM_SLOTS) * JOURNAL_SLOT_SIZE;
+}
+
+/// <summary>
+///   Writes the next byte of a busy flush to the EEPROM slot if it changed: first the magic is
+///   cleared when the slot holds another journal, then the records, then the header.
+/// </summary>
+///
+/// <returns>
+///   true if a byte was written, false if the EEPROM already held it.
+/// </returns>
+bool RaceJournalClass::_FlushNextByte() {
+   int Address = _GetSlotAddress(_RaceId);
+   if (_Flush.Invalidate) {
+      _Flush.Invalidate = false;
+      EEPROM.write(Address, 0);
+      return true;
+   }
+
+   uint8_t Byte;
+   if (_Flush.Offset < _Flush.Length) {
+      Byte = _PeekAt(_Flush.Offset);
+      Address += sizeof(JournalSlotHeader) + _Flush.Offset;
+   } else {
+      //Built field by field, so padding (there is none on AVR) compares equal the next time
+      JournalSlotHeader Header;
+      memset(&Header, 0, sizeof(Header));
+      Header.Magic = JOURNAL_SLOT_MAGIC;
+      Header.RaceId = _RaceId;
+      Header.StartTime = _StartTime;
+      Header.TailTime = _TailTime;
+      Header.Length = _Flush.Length;
+      Header.RecordsDropped = _RecordsDropped;
+      uint8_t HeaderOffset = _Flush.Offset - _Flush.Length;
+      Byte = ((const uint8_t *)&Header)[HeaderOffset];
+      Address += HeaderOffset;
+   }
+
+   _Flush.Offset++;
+   _Flush.Busy = _Flush.Offset < _Flush.Length + sizeof(JournalSlotHeader);
+   if (EEPROM.read(Address) == Byte) {
+      return false;
+   }
+   EEPROM.write(Address, Byte);
+   return true;
+}
+
+/// <summary>
+///   Writes the rest of a busy flush at once, before the ring changes in a way the flush can't
+///   follow.
+/// </summary>
+void RaceJournalClass::_FinishFlush() {
+   while (_Flush.Busy) {
+      _FlushNextByte();
+   }
+}
+
+/// <summary>
+///   Drops the oldest records until the ring has room for the given number of bytes. A busy flush
+///   is finished first, dropping records moves the bytes it still has to write.
+/// </summary>
+void RaceJournalClass::_MakeRoom(uint8_t Length) {
+   if (JOURNAL_BUFFER_SIZE - _Used < Length) {
+      _FinishFlush();
+   }
+   while (JOURNAL_BUFFER_SIZE - _Used < Length) {
+      _DropOldest();
+   }
+}
+
+/// <summary>
+///   Drops the oldest record from the ring. The time delta of a dropped timed record is added to
+///   the tail time base, so the remaining records keep their absolute times.
+/// </summary>
+void RaceJournalClass::_DropOldest() {
+   uint8_t Header = _Buffer[_Tail];
+   _Tail = (_Tail + 1) % JOURNAL_BUFFER_SIZE;
+   _Used--;
+
+   if (_IsTimed(Header >> 4)) {
+      unsigned long Delta = 0;
+      uint8_t Shift = 0;
+      uint8_t Byte;
+      do {
+         Byte = _Buffer[_Tail];
+         _Tail = (_Tail + 1) % JOURNAL_BUFFER_SIZE;
+         _Used--;
+         Delta |= (unsigned long)(Byte & 0x7F) << Shift;
+         Shift += 7;
+      } while ((Byte & 0x80) && _Used > 0);
+      _TailTime += Delta;
+   }
+
+   _RecordsDropped = true;
+}
+
+/// <summary>
+///   Appends a single byte at the head of the ring, the caller must have made room for it.
+/// </summary>
+void RaceJournalClass::_Push(uint8_t Byte) {
+   _Buffer[_Head] = Byte;
+   _Head = (_Head + 1) % JOURNAL_BUFFER_SIZE;
+   _Used++;
+}
+
+/// <summary>
+///   Gets the byte at the given offset from the oldest byte in the ring.
+/// </summary>
+uint8_t RaceJournalClass::_PeekAt(uint16_t Offset) {
+   return _Buffer[(_Tail + Offset) % JOURNAL_BUFFER_SIZE];
+}
+
+RaceJournalClass RaceJournal;
@@ -0,0 +1,122 @@
+#ifndef _RACEJOURNAL_h
+#define _RACEJOURNAL_h
+
+#include "Arduino.h"
+#include "EepromLayout.h"
+
+//Room for the longest heat (every dog with all its reruns, roughly 40 bytes per run) plus sensor
+//chatter, so the race reconstruction always gets the whole heat
+#ifndef JOURNAL_BUFFER_SIZE
+#define JOURNAL_BUFFER_SIZE 1024
+#endif
+#ifndef JOURNAL_EXPORT_FRAMES
+#define JOURNAL_EXPORT_FRAMES 2   //Records Main() sends per call, 2 frames fit in the serial transmit buffer
+#endif
+#ifndef JOURNAL_FLUSH_BYTES
+#define JOURNAL_FLUSH_BYTES 32    //Bytes Main() compares with the EEPROM slot per call, at most one of them is written
+#endif
+
+/// <summary>
+///   On-device journal of everything the race handler saw and decided during a heat.
+///   Records are stored in a RAM ring buffer, each record is one header byte (record type in the
+///   upper nibble, payload in the lower nibble), timed records are followed by the time since the
+///   previous timed record as an unsigned LEB128 varint. When the ring is full the oldest records
+///   are dropped. Between heats the ring is flushed to an EEPROM slot by Main(), one written byte
+///   per call.
+/// </summary>
+class RaceJournalClass {
+   public:
+      enum RecordTypes {
+         SENSOR_EDGE,   //Timed, payload: sensor number << 1 | sensor state
+         RACE_STATE,    //Timed, payload: new race state
+         TRANSITION,    //Payload: recognised transition pattern (RaceHandlerClass::TransitionPatterns)
+         DIRECTION,     //Payload: new run direction of current dog
+         DOG_INDEX,     //Payload: new current dog index
+         DOG_FAULT,     //Payload: dog index << 1 | fault state
+         BEAM_CAPTURE   //Payload: beam capture number (BeamRecorderClass)
+      };
+
+      //Read position in the RAM ring, Time is the absolute time of the last timed record read
+      struct Cursor {
+         uint16_t Offset;
+         unsigned long Time;
+      };
+
+      void StartHeat(unsigned int RaceId, unsigned long StartTime);
+      void LogEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime);
+      void LogRecord(RecordTypes Type, uint8_t Payload, unsigned long Time);
+      void LogRecord(RecordTypes Type, uint8_t Payload);
+      void Flush();
+      bool Export(unsigned int RaceId);
+      void Main();
+      bool IsFlushing();
+      bool IsExporting();
+      uint16_t GetUsedBytes();
+      bool IsComplete();
+      void OpenCursor(Cursor &Position);
+      bool ReadRecord(Cursor &Position, uint8_t &Type, uint8_t &Payload);
+
+   private:
+      uint8_t _Buffer[JOURNAL_BUFFER_SIZE];
+      uint16_t _Head;
+      uint16_t _Tail;
+      uint16_t _Used;
+      unsigned int _RaceId;
+      unsigned long _StartTime;
+      unsigned long _TailTime;   //Time base of the oldest record still in the ring
+      unsigned long _LastTime;   //Time base of the newest record
+      bool _RecordsDropped;
+      bool _HeatStarted = false;
+
+      //Export which is being sent by Main()
+      struct ExportState {
+         bool Busy;
+         unsigned int RaceId;
+         unsigned long StartTime;
+         unsigned long Time;        //Absolute time of the last timed record sent
+         uint16_t Length;
+         uint16_t Offset;
+         unsigned int RecordCount;
+         int EepromAddress;         //-1 for the RAM ring
+      };
+      ExportState _Export = {};
+
+      //Flush of the RAM ring to the EEPROM slot of the heat which is being written by Main()
+      struct FlushState {
+         bool Busy;
+         bool Invalidate;           //The slot holds another journal, clear its magic before the records
+         uint16_t Length;           //Bytes of the ring being flushed, the header is written after them
+         uint16_t Offset;
+      };
+      FlushState _Flush = {};
+
+      struct JournalSlotHeader {
+         uint16_t Magic;
+         uint16_t RaceId;
+         unsigned long StartTime;
+         unsigned long TailTime;
+         uint16_t Length;
+         uint8_t RecordsDropped;
+         uint8_t Reserved;
+      };
+
+      #define JOURNAL_SLOT_MAGIC 0x4A31
+      #define JOURNAL_SLOT_SIZE (sizeof(JournalSlotHeader) + JOURNAL_BUFFER_SIZE)
+      #define JOURNAL_EEPROM_SLOTS (EEPROM_JOURNAL_LENGTH / JOURNAL_SLOT_SIZE)
+
+      static bool _IsTimed(uint8_t Type);
+      void _Push(uint8_t Byte);
+      void _MakeRoom(uint8_t Length);
+      void _DropOldest();
+      uint8_t _PeekAt(uint16_t Offset);
+      void _StartExport(unsigned int RaceId, unsigned long StartTime, unsigned long TailTime, uint16_t Length, bool RecordsDropped, int EepromAddress);
+      void _ExportNextRecord();
+      uint8_t _ReadExportByte();
+      int _GetSlotAddress(unsigned int RaceId);
+      bool _FlushNextByte();
+      void _FinishFlush();
+};
+
+extern RaceJournalClass RaceJournal;
+
+#endif
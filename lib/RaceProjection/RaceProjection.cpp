@@ -0,0 +1,176 @@
+#include "RaceProjection.h"
+
+/// <summary>
+///   Starts the projection of a new heat, the first dog is running from race time 0.
+/// </summary>
+///
+/// <param name="ExpectedTimes">   Expected run time of each dog in milliseconds, 0 if unknown: its
+///                                dog time plus the part of its crossing it is late. </param>
+/// <param name="BestTime">        Best team time of earlier heats in milliseconds, 0 if none. </param>
+void RaceProjectionClass::Start(const unsigned long ExpectedTimes[], unsigned long BestTime) {
+   memcpy(_ExpectedTimes, ExpectedTimes, sizeof(_ExpectedTimes));
+   memset(_PendingRuns, 0, sizeof(_PendingRuns));
+   _Faults = 0;
+   _PendingTime = 0;
+   _PendingUnknownRuns = 0;
+   _HeatTime = 0;
+   _HeatRuns = 0;
+   _BestTime = BestTime;
+   _CurrentDog = 0;
+   _CurrentStart = 0;
+   _PaceValid = false;
+
+   for (uint8_t DogIndex = 1; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      _AddPendingRun(DogIndex);
+   }
+}
+
+/// <summary>
+///   Ends the run of the running dog and starts the run of the given dog.
+/// </summary>
+///
+/// <param name="DogIndex">   Zero-based index of the dog which is now running. </param>
+/// <param name="RaceTime">   The race time in milliseconds. </param>
+void RaceProjectionClass::DogStarted(uint8_t DogIndex, unsigned long RaceTime) {
+   if (DogIndex >= RaceRules::DogsPerTeam || RaceTime < _CurrentStart) {
+      return;
+   }
+
+   unsigned long RunTime = RaceTime - _CurrentStart;
+   _HeatTime += RunTime;
+   _HeatRuns++;
+   if (_ExpectedTimes[_CurrentDog] != 0) {
+      _PaceDog = _CurrentDog;
+      _PaceDelta = (long)RunTime - (long)_ExpectedTimes[_CurrentDog];
+      _PaceValid = true;
+   }
+
+   _RemovePendingRun(DogIndex);
+   _CurrentDog = DogIndex;
+   _CurrentStart = RaceTime;
+}
+
+/// <summary>
+///   A fault adds a rerun of the dog, removing the fault before the rerun started takes it away
+///   again. Repeated reports of the same state are ignored.
+/// </summary>
+///
+/// <param name="DogIndex">   Zero-based index of the dog. </param>
+/// <param name="Fault">      The new fault state of the dog. </param>
+void RaceProjectionClass::FaultChanged(uint8_t DogIndex, bool Fault) {
+   if (DogIndex >= RaceRules::DogsPerTeam || Fault == ((_Faults & _BV(DogIndex)) != 0)) {
+      return;
+   }
+
+   if (Fault) {
+      _Faults |= _BV(DogIndex);
+      _AddPendingRun(DogIndex);
+   } else {
+      _Faults &= ~_BV(DogIndex);
+      _RemovePendingRun(DogIndex);
+   }
+}
+
+/// <summary>
+///   Gets the projected team time.
+/// </summary>
+///
+/// <param name="RaceTime">        The race time in milliseconds. </param>
+/// <param name="ProjectedTime">   [out] The projected team time in milliseconds. </param>
+///
+/// <returns>
+///   False if there is nothing to base the projection on yet: a dog without an expected time is
+///   still to run and no run of this heat is finished.
+/// </returns>
+bool RaceProjectionClass::GetProjectedTime(unsigned long RaceTime, unsigned long &ProjectedTime) const {
+   unsigned long CurrentTime = _GetExpectedTime(_CurrentDog);
+   if (_HeatRuns == 0 && (CurrentTime == 0 || _PendingUnknownRuns > 0)) {
+      return false;
+   }
+
+   unsigned long ElapsedTime = (RaceTime > _CurrentStart) ? RaceTime - _CurrentStart : 0;
+   if (ElapsedTime > CurrentTime) {
+      CurrentTime = ElapsedTime;
+   }
+   ProjectedTime = _CurrentStart + CurrentTime + _PendingTime;
+   if (_PendingUnknownRuns > 0) {
+      ProjectedTime += _PendingUnknownRuns * (_HeatTime / _HeatRuns);
+   }
+   return true;
+}
+
+/// <summary>
+///   Gets the difference between the projected team time and the best team time of earlier heats.
+/// </summary>
+///
+/// <param name="RaceTime">  The race time in milliseconds. </param>
+/// <param name="Delta">     [out] The difference in milliseconds, negative if faster than the best heat. </param>
+///
+/// <returns>
+///   False if there is no earlier heat or no projection yet.
+/// </returns>
+bool RaceProjectionClass::GetBestDelta(unsigned long RaceTime, long &Delta) const {
+   unsigned long ProjectedTime;
+   if (_BestTime == 0 || !GetProjectedTime(RaceTime, ProjectedTime)) {
+      return false;
+   }
+
+   Delta = (long)ProjectedTime - (long)_BestTime;
+   return true;
+}
+
+/// <summary>
+///   Gets the pace of the last finished run of a dog with an expected time.
+/// </summary>
+///
+/// <param name="DogIndex">  [out] Zero-based index of the dog. </param>
+/// <param name="Delta">     [out] Run time minus expected time in milliseconds, positive if slower. </param>
+///
+/// <returns>
+///   False if no such run finished in this heat yet.
+/// </returns>
+bool RaceProjectionClass::GetLastPace(uint8_t &DogIndex, long &Delta) const {
+   DogIndex = _PaceDog;
+   Delta = _PaceDelta;
+   return _PaceValid;
+}
+
+/// <summary>
+///   Adds a run of a dog which still has to start.
+/// </summary>
+void RaceProjectionClass::_AddPendingRun(uint8_t DogIndex) {
+   _PendingRuns[DogIndex]++;
+   if (_ExpectedTimes[DogIndex] != 0) {
+      _PendingTime += _ExpectedTimes[DogIndex];
+   } else {
+      _PendingUnknownRuns++;
+   }
+}
+
+/// <summary>
+///   Removes a run of a dog which still had to start, if the dog has one.
+/// </summary>
+void RaceProjectionClass::_RemovePendingRun(uint8_t DogIndex) {
+   if (_PendingRuns[DogIndex] == 0) {
+      return;
+   }
+
+   _PendingRuns[DogIndex]--;
+   if (_ExpectedTimes[DogIndex] != 0) {
+      _PendingTime -= _ExpectedTimes[DogIndex];
+   } else {
+      _PendingUnknownRuns--;
+   }
+}
+
+/// <summary>
+///   Gets the expected run time of a dog, the average run of this heat if the dog has none.
+/// </summary>
+unsigned long RaceProjectionClass::_GetExpectedTime(uint8_t DogIndex) const {
+   if (_ExpectedTimes[DogIndex] != 0 || _HeatRuns == 0) {
+      return _ExpectedTimes[DogIndex];
+   }
+   return _HeatTime / _HeatRuns;
+}
+
+RaceProjectionClass RaceProjection;
@@ -0,0 +1,54 @@
+#ifndef _RACEPROJECTION_h
+#define _RACEPROJECTION_h
+
+#include "Arduino.h"
+#include "RaceRules.h"
+
+/// <summary>
+///   Projects the team time of the running heat. A run lasts from the start of the dog (the race
+///   start or the previous dog coming back) until the next dog starts, which adds up to the team
+///   time. The projection is the start of the running dog, plus its expected run time or its
+///   elapsed time when it is already slower, plus the expected times of all runs still to come
+///   (reruns included). Dogs without an expected time get the average run of this heat so far.
+///   Every event and every projection is O(1) integer math on milliseconds, so it can be asked
+///   for on every loop.
+///
+///   The expected times and the best team time are given once per heat to Start(). The module
+///   doesn't care where they come from, the application takes them from the session statistics
+///   (RaceStatisticsClass::GetExpectedRunTime() and GetBestHeatTime()) when the race starts.
+/// </summary>
+class RaceProjectionClass {
+   public:
+      void Start(const unsigned long ExpectedTimes[], unsigned long BestTime);
+      void DogStarted(uint8_t DogIndex, unsigned long RaceTime);
+      void FaultChanged(uint8_t DogIndex, bool Fault);
+
+      bool GetProjectedTime(unsigned long RaceTime, unsigned long &ProjectedTime) const;
+      bool GetBestDelta(unsigned long RaceTime, long &Delta) const;
+      bool GetLastPace(uint8_t &DogIndex, long &Delta) const;
+
+   private:
+      unsigned long _ExpectedTimes[RaceRules::DogsPerTeam];   //Milliseconds, 0 if unknown
+      uint8_t _PendingRuns[RaceRules::DogsPerTeam];           //Runs still to start per dog
+      uint8_t _Faults;                                        //Bit per dog, as last reported
+      unsigned long _PendingTime;        //Expected time of the pending runs of dogs with an expected time
+      uint8_t _PendingUnknownRuns;       //Pending runs of dogs without an expected time
+      unsigned long _HeatTime;           //Sum of the finished runs of this heat
+      uint8_t _HeatRuns;
+      unsigned long _BestTime;           //Best team time of earlier heats, 0 if none
+
+      uint8_t _CurrentDog;
+      unsigned long _CurrentStart;       //Race time at which the running dog started
+
+      uint8_t _PaceDog;                  //Dog of the last finished run which has an expected time
+      long _PaceDelta;                   //Its run minus its expected time, positive if slower
+      bool _PaceValid;
+
+      void _AddPendingRun(uint8_t DogIndex);
+      void _RemovePendingRun(uint8_t DogIndex);
+      unsigned long _GetExpectedTime(uint8_t DogIndex) const;
+};
+
+extern RaceProjectionClass RaceProjection;
+
+#endif
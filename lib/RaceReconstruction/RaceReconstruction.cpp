@@ -0,0 +1,290 @@
+#include "RaceReconstruction.h"
+
+/// <summary>
+///   Rebuilds the heat in the race journal. The journal has to hold the whole heat.
+/// </summary>
+///
+/// <param name="StartTime">           The time the green light came on, in microseconds. </param>
+/// <param name="SensorOffsets">       The receiver delays which were compensated during the heat,
+///                                    per [sensor number - 1][sensor state]. </param>
+/// <param name="RunCount">            The number of runs (first runs and reruns) in the heat. </param>
+/// <param name="ExpectedLaneTimes">   Expected lane time (beam break going in to beam break coming
+///                                    back) per run in microseconds, 0 if unknown. </param>
+/// <param name="Runs">                [out] The reconstructed runs, RunCount entries. </param>
+///
+/// <returns>
+///   RECONSTRUCTED if Runs was filled, otherwise the reason why the heat could not be rebuilt.
+/// </returns>
+RaceReconstructionClass::ReconstructionResults RaceReconstructionClass::Run(unsigned long StartTime, const long SensorOffsets[2][2], uint8_t RunCount, const unsigned long ExpectedLaneTimes[], ReconstructedRun Runs[]) {
+   if (!RaceJournal.IsComplete()) {
+      return JOURNAL_INCOMPLETE;
+   }
+   if (RunCount == 0 || RunCount > RECONSTRUCTION_MAX_RUNS) {
+      return TOO_MANY_RUNS;
+   }
+
+   //State 2 * n: waiting for run n to go in, state 2 * n + 1: run n is in the lane. Per state the
+   //lowest cost to get there and the time of the last crossing of the best path (the time run n
+   //went in for odd states, the time the previous run came back for even states).
+   uint8_t States = 2 * RunCount + 1;
+   long Cost[RECONSTRUCTION_MAX_STATES];
+   unsigned long Time[RECONSTRUCTION_MAX_STATES];
+   //Per window and state the step (0-2 states) taken to get there, 2 bits each
+   uint8_t Trace[RECONSTRUCTION_MAX_WINDOWS][(RECONSTRUCTION_MAX_STATES + 3) / 4];
+   uint8_t Labels[RECONSTRUCTION_MAX_WINDOWS];
+
+   for (uint8_t State = 0; State < States; State++) {
+      Cost[State] = RECONSTRUCTION_INFINITE;
+   }
+   Cost[0] = 0;
+   Time[0] = StartTime;
+
+   GateWindow Window;
+   uint8_t WindowCount = 0;
+   _OpenJournal(SensorOffsets);
+   while (_NextWindow(Window)) {
+      if (WindowCount == RECONSTRUCTION_MAX_WINDOWS) {
+         return TOO_MANY_WINDOWS;
+      }
+      uint8_t *Steps = Trace[WindowCount++];
+      memset(Steps, 0, sizeof(Trace[0]));
+      long NoiseCost = _PatternCost(Window, NOISE);
+
+      //Every step goes to a higher state, so going down the states Cost and Time can be updated in place
+      for (int8_t State = States - 1; State >= 0; State--) {
+         long Best = Cost[State] + NoiseCost;
+         unsigned long BestTime = Time[State];
+         uint8_t BestStep = 0;
+
+         if (State >= 1 && Cost[State - 1] < RECONSTRUCTION_INFINITE) {
+            uint8_t From = State - 1;
+            long StepCost;
+            unsigned long StepTime;
+            if (From % 2 == 0) {
+               StepCost = _PatternCost(Window, GOING_IN);
+               StepTime = Window.FirstBreak[0];
+            } else {
+               StepCost = _PatternCost(Window, COMING_BACK) + _PaceCost(Window.FirstBreak[1] - Time[From], ExpectedLaneTimes[From / 2]);
+               StepTime = Window.FirstBreak[1];
+            }
+            if (StepCost < RECONSTRUCTION_INFINITE && Cost[From] + StepCost < Best) {
+               Best = Cost[From] + StepCost;
+               BestTime = StepTime;
+               BestStep = 1;
+            }
+         }
+
+         //The dog in the lane comes back while the next one goes in
+         if (State >= 3 && State % 2 == 1 && Cost[State - 2] < RECONSTRUCTION_INFINITE) {
+            uint8_t From = State - 2;
+            long StepCost = _PatternCost(Window, PASSING) + _PaceCost(Window.FirstBreak[1] - Time[From], ExpectedLaneTimes[From / 2]);
+            if (StepCost < RECONSTRUCTION_INFINITE && Cost[From] + StepCost < Best) {
+               Best = Cost[From] + StepCost;
+               BestTime = Window.FirstBreak[1];
+               BestStep = 2;
+            }
+         }
+
+         Cost[State] = min(Best, RECONSTRUCTION_INFINITE);
+         Time[State] = BestTime;
+         Steps[State / 4] |= BestStep << ((State % 4) * 2);
+      }
+   }
+
+   //The race may have been stopped before the last dog came back, or before the last rerun went in
+   uint8_t State = States - 1;
+   for (uint8_t Unfinished = States - 3; Unfinished < States - 1; Unfinished++) {
+      if (Cost[Unfinished] + RECONSTRUCTION_UNFINISHED_COST < Cost[State]) {
+         State = Unfinished;
+      }
+   }
+   if (Cost[State] >= RECONSTRUCTION_INFINITE) {
+      return NO_SOLUTION;
+   }
+
+   for (uint8_t i = WindowCount; i-- > 0;) {
+      uint8_t Step = (Trace[i][State / 4] >> ((State % 4) * 2)) & 0x03;
+      if (Step == 0) {
+         Labels[i] = NOISE;
+      } else if (Step == 2) {
+         Labels[i] = PASSING;
+      } else {
+         Labels[i] = ((State - 1) % 2 == 0) ? GOING_IN : COMING_BACK;
+      }
+      State -= Step;
+   }
+
+   //Replay the windows with their labels to get the times of the runs
+   memset(Runs, 0, RunCount * sizeof(ReconstructedRun));
+   unsigned long LastReturnTime = StartTime;
+   uint8_t WindowIndex = 0;
+   _OpenJournal(SensorOffsets);
+   while (_NextWindow(Window) && WindowIndex < WindowCount) {
+      uint8_t RunIndex = State / 2;
+      switch (Labels[WindowIndex++]) {
+         case GOING_IN:
+            Runs[RunIndex].CrossingTime = Window.FirstBreak[0] - LastReturnTime;
+            Runs[RunIndex].CrossingKnown = true;
+            State++;
+            break;
+
+         case COMING_BACK:
+         case PASSING:
+            Runs[RunIndex].DogTime = Window.FirstBreak[1] - LastReturnTime;
+            Runs[RunIndex].Complete = true;
+            LastReturnTime = Window.FirstBreak[1];
+            State += (Labels[WindowIndex - 1] == PASSING) ? 2 : 1;
+            break;
+
+         default:
+            break;
+      }
+   }
+
+   return RECONSTRUCTED;
+}
+
+/// <summary>
+///   Starts reading gate windows from the oldest record in the journal.
+/// </summary>
+void RaceReconstructionClass::_OpenJournal(const long SensorOffsets[2][2]) {
+   RaceJournal.OpenCursor(_Cursor);
+   _SensorOffsets = SensorOffsets;
+   _EdgePending = false;
+}
+
+/// <summary>
+///   Reads the next gate window from the journal: all edges from the first beam break until both
+///   beams are clear again, or until no edge came for RaceRules::TransitionTimeout.
+/// </summary>
+///
+/// <param name="Window">  [out] The gate window. </param>
+///
+/// <returns>
+///   true if a window was read, false if there are no more edges.
+/// </returns>
+bool RaceReconstructionClass::_NextWindow(GateWindow &Window) {
+   Window.Seen = 0;
+   Window.Truncated = false;
+   _Broken = 0;
+
+   while (true) {
+      uint8_t Sensor;
+      uint8_t State;
+      unsigned long EdgeTime;
+      if (_EdgePending) {
+         Sensor = _PendingSensor;
+         State = _PendingState;
+         EdgeTime = _PendingTime;
+         _EdgePending = false;
+      } else {
+         uint8_t Type;
+         uint8_t Payload;
+         if (!RaceJournal.ReadRecord(_Cursor, Type, Payload)) {
+            //The race stops on the beam break of the last dog, the rest of its pass is not journaled
+            Window.Truncated = true;
+            return Window.Seen != 0;
+         }
+         Sensor = (Payload >> 1) - 1;
+         State = Payload & 0x01;
+         if (Type != RaceJournalClass::SENSOR_EDGE || Sensor > 1) {
+            continue;
+         }
+         EdgeTime = _Cursor.Time - _SensorOffsets[Sensor][State];
+      }
+
+      if (Window.Seen != 0 && (long)(EdgeTime - _LastEdgeTime) > (long)RaceRules::TransitionTimeout) {
+         //The live decoder discards the transition string here, this edge starts the next window
+         _EdgePending = true;
+         _PendingSensor = Sensor;
+         _PendingState = State;
+         _PendingTime = EdgeTime;
+         return true;
+      }
+
+      _LastEdgeTime = EdgeTime;
+      _AddEdge(Window, Sensor, State, EdgeTime);
+      if (State) {
+         _Broken |= _BV(Sensor);
+      } else {
+         _Broken &= ~_BV(Sensor);
+      }
+      if (_Broken == 0) {
+         return true;
+      }
+   }
+}
+
+/// <summary>
+///   Adds an edge to a gate window.
+/// </summary>
+void RaceReconstructionClass::_AddEdge(GateWindow &Window, uint8_t Sensor, uint8_t State, unsigned long Time) {
+   if (State) {
+      if (!(Window.Seen & _BV(Sensor))) {
+         Window.FirstBreak[Sensor] = Time;
+         Window.Seen |= _BV(Sensor);
+      }
+   } else {
+      Window.LastRestore[Sensor] = Time;
+      Window.Seen |= _BV(Sensor + 2);
+   }
+}
+
+/// <summary>
+///   Gets the cost of assigning a gate window to the given kind of pass.
+/// </summary>
+long RaceReconstructionClass::_PatternCost(const GateWindow &Window, WindowLabels Label) {
+   bool Complete = Window.Seen == 0x0F;
+   //One beam was clear again before the other one was broken, too small for a dog (e.g. a ball)
+   bool Small = Complete && ((long)(Window.LastRestore[0] - Window.FirstBreak[1]) < 0 || (long)(Window.LastRestore[1] - Window.FirstBreak[0]) < 0);
+
+   if (Label == NOISE) {
+      return ((Complete && !Small) || Window.Truncated) ? RECONSTRUCTION_NOISE_COST : 0;
+   }
+   if (Window.Truncated) {
+      //Only the beam broken first is known
+      uint8_t FirstSensor = (Label == GOING_IN) ? 0 : 1;
+      bool FirstBroken = (Window.Seen & _BV(FirstSensor)) && (!(Window.Seen & _BV(1 - FirstSensor)) || (long)(Window.FirstBreak[FirstSensor] - Window.FirstBreak[1 - FirstSensor]) <= 0);
+      return (Label != PASSING && FirstBroken) ? 0 : RECONSTRUCTION_INFINITE;
+   }
+   if (!Complete) {
+      return RECONSTRUCTION_INFINITE;
+   }
+
+   long Cost = Small ? RECONSTRUCTION_PATTERN_COST : 0;
+   bool HandlersSideFirst = (long)(Window.FirstBreak[0] - Window.FirstBreak[1]) < 0;
+   bool HandlersSideClearFirst = (long)(Window.LastRestore[0] - Window.LastRestore[1]) < 0;
+   switch (Label) {
+      case GOING_IN:
+         //ABab
+         Cost += (HandlersSideFirst ? 0 : RECONSTRUCTION_PATTERN_COST) + (HandlersSideClearFirst ? 0 : RECONSTRUCTION_PATTERN_COST / 2);
+         break;
+
+      case COMING_BACK:
+         //BAba
+         Cost += (HandlersSideFirst ? RECONSTRUCTION_PATTERN_COST : 0) + (HandlersSideClearFirst ? RECONSTRUCTION_PATTERN_COST / 2 : 0);
+         break;
+
+      default:
+         //Two dogs passing each other: the beam broken first is not the one cleared last (BAab, ABba)
+         Cost += (HandlersSideFirst == HandlersSideClearFirst) ? RECONSTRUCTION_PATTERN_COST : 0;
+         break;
+   }
+   return Cost;
+}
+
+/// <summary>
+///   Gets the cost of a lane time, the further away from the expected lane time of the dog, the
+///   less plausible. Dogs coming back within RaceRules::FalseCrossingWindow are impossible.
+/// </summary>
+long RaceReconstructionClass::_PaceCost(unsigned long LaneTime, unsigned long ExpectedLaneTime) {
+   if ((long)LaneTime < (long)RaceRules::FalseCrossingWindow) {
+      return RECONSTRUCTION_INFINITE;
+   }
+   if (ExpectedLaneTime == 0) {
+      return 0;
+   }
+   return labs((long)(LaneTime - ExpectedLaneTime)) >> RECONSTRUCTION_PACE_SHIFT;
+}
+
+RaceReconstructionClass RaceReconstruction;
@@ -0,0 +1,87 @@
+#ifndef _RACERECONSTRUCTION_h
+#define _RACERECONSTRUCTION_h
+
+#include "Arduino.h"
+#include "RaceRules.h"
+#include <RaceJournal.h>
+
+#define RECONSTRUCTION_MAX_RUNS (RaceRules::DogsPerTeam * RaceRules::MaxRunsPerDog)   //Runs (first runs + reruns) of a heat
+#define RECONSTRUCTION_MAX_STATES (2 * RECONSTRUCTION_MAX_RUNS + 1)
+#define RECONSTRUCTION_MAX_WINDOWS 64                           //Gate windows of a heat, 2 per run plus noise
+#define RECONSTRUCTION_INFINITE 0x3FFFFFFFL
+#define RECONSTRUCTION_TOLERANCE 1000                          //Differences with the live result (us) which are reported
+
+//Costs of the search, one point is roughly 4ms of a dog being off its expected pace
+#define RECONSTRUCTION_PATTERN_COST 1000        //Gate window doesn't look like the assigned pass
+#define RECONSTRUCTION_NOISE_COST 500           //Complete pass through both beams which is ignored
+#define RECONSTRUCTION_UNFINISHED_COST 1000     //Race stopped before the last run was complete
+#define RECONSTRUCTION_PACE_SHIFT 12            //Pace cost is |lane time - expected| >> shift
+
+/// <summary>
+///   Rebuilds a heat from the sensor edges in the race journal once it is over. Unlike the live
+///   decoder, which has to decide at every edge, this looks at the whole heat at once.
+///
+///   The edges are grouped into gate windows (from all beams clear to all beams clear again), and
+///   every window is assigned to one of: dog going in, dog coming back, two dogs passing each other,
+///   or noise. A dynamic programming search over the runs of the heat finds the assignment with the
+///   lowest cost, where the cost counts windows which don't match the pattern of their assignment,
+///   ignored passes, and lane times which are far from the expected lane time of the dog. Runs
+///   which come back within RaceRules::FalseCrossingWindow are impossible.
+///
+///   Memory is O(windows * runs) bits for the trace back, the search takes O(windows * runs). With
+///   the limits below that is roughly 900 bytes of stack while Run() is busy.
+/// </summary>
+class RaceReconstructionClass {
+   public:
+      enum ReconstructionResults {
+         RECONSTRUCTED,
+         JOURNAL_INCOMPLETE,     //Oldest records of the heat were dropped from the journal
+         TOO_MANY_RUNS,
+         TOO_MANY_WINDOWS,
+         NO_SOLUTION             //The edges can't be explained with this number of runs
+      };
+
+      struct ReconstructedRun {
+         unsigned long DogTime;  //Microseconds, from the previous dog coming back to this dog coming back
+         long CrossingTime;      //Microseconds
+         bool Complete;          //The dog came back
+         bool CrossingKnown;     //False if both dogs passed the gates together
+      };
+
+      ReconstructionResults Run(unsigned long StartTime, const long SensorOffsets[2][2], uint8_t RunCount, const unsigned long ExpectedLaneTimes[], ReconstructedRun Runs[]);
+
+   private:
+      enum WindowLabels {
+         NOISE,
+         GOING_IN,
+         COMING_BACK,
+         PASSING
+      };
+
+      struct GateWindow {
+         unsigned long FirstBreak[2];   //[sensor number - 1]
+         unsigned long LastRestore[2];
+         uint8_t Seen;                  //Bit 0-1: sensor broken, bit 2-3: sensor restored
+         bool Truncated;                //The journal ended before the beams were clear (race stopped)
+      };
+
+      //State of reading windows from the journal
+      RaceJournalClass::Cursor _Cursor;
+      const long (*_SensorOffsets)[2];
+      uint8_t _Broken;
+      unsigned long _LastEdgeTime;
+      bool _EdgePending;
+      uint8_t _PendingSensor;
+      uint8_t _PendingState;
+      unsigned long _PendingTime;
+
+      void _OpenJournal(const long SensorOffsets[2][2]);
+      bool _NextWindow(GateWindow &Window);
+      static void _AddEdge(GateWindow &Window, uint8_t Sensor, uint8_t State, unsigned long Time);
+      static long _PatternCost(const GateWindow &Window, WindowLabels Label);
+      static long _PaceCost(unsigned long LaneTime, unsigned long ExpectedLaneTime);
+};
+
+extern RaceReconstructionClass RaceReconstruction;
+
+#endif
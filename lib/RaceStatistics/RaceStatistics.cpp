@@ -0,0 +1,170 @@
+#include "RaceStatistics.h"
+#include <RaceHandler.h>
+
+/// <summary>
+///   Adds the runs of a stopped race. Runs without a time (not finished) and crossings which were
+///   not measured are left out, the heat time only counts when every dog finished without a fault.
+/// </summary>
+///
+/// <param name="Race">   The race data of the stopped race. </param>
+void RaceStatisticsClass::AddRace(const RaceData &Race) {
+   bool Clean = Race.ElapsedTime > 0;
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      const stDogData &DogData = Race.DogData[DogIndex];
+      Clean = Clean && !DogData.Fault && DogData.Timing[DogData.LastRunNumber].Time != 0;
+
+      for (uint8_t RunNumber = 0; RunNumber <= DogData.LastRunNumber; RunNumber++) {
+         const DogTimeData &Timing = DogData.Timing[RunNumber];
+         if (Timing.Time != 0) {
+            _AddSample(_DogSeries[DogIndex][RUN_TIMES], Timing.Time, Timing.Time, STATS_RUN_ORIGIN, STATS_RUN_BIN_WIDTH);
+         }
+         if (Timing.CrossingClass != RaceHandlerClass::CROSSING_NONE) {
+            _AddSample(_DogSeries[DogIndex][CROSSING_TIMES], Timing.CrossingTime, Timing.CrossingTime / 1000, STATS_CROSSING_ORIGIN, STATS_CROSSING_BIN_WIDTH);
+            if (Timing.CrossingTime > 0) {
+               _LateCrossingSums[DogIndex] += (Timing.CrossingTime + 500) / 1000;
+            }
+         }
+      }
+   }
+
+   if (Clean) {
+      _AddSample(_TeamSeries, Race.ElapsedTime, Race.ElapsedTime, STATS_HEAT_ORIGIN, STATS_HEAT_BIN_WIDTH);
+   }
+}
+
+/// <summary>
+///   Clears all statistics.
+/// </summary>
+void RaceStatisticsClass::Clear() {
+   memset(_DogSeries, 0, sizeof(_DogSeries));
+   memset(&_TeamSeries, 0, sizeof(_TeamSeries));
+   memset(_LateCrossingSums, 0, sizeof(_LateCrossingSums));
+}
+
+/// <summary>
+///   Gets the run time (ms) or crossing time (us) statistics of a dog.
+/// </summary>
+const RaceStatisticsClass::Series &RaceStatisticsClass::GetDogSeries(uint8_t DogIndex, SeriesTypes Type) const {
+   return _DogSeries[DogIndex][Type];
+}
+
+/// <summary>
+///   Gets the heat time statistics (ms) of the team.
+/// </summary>
+const RaceStatisticsClass::Series &RaceStatisticsClass::GetTeamSeries() const {
+   return _TeamSeries;
+}
+
+/// <summary>
+///   Gets the mean of a series, rounded to the unit of its samples, 0 without samples.
+/// </summary>
+long RaceStatisticsClass::GetMean(const Series &Statistic) {
+   if (Statistic.Count == 0) {
+      return 0;
+   }
+   int64_t Offset = (Statistic.Sum >= 0) ? Statistic.Sum + Statistic.Count / 2 : Statistic.Sum - Statistic.Count / 2;
+   return Statistic.Shift + (long)(Offset / Statistic.Count);
+}
+
+/// <summary>
+///   Gets the sample standard deviation of a series, 0 with less than 2 samples.
+/// </summary>
+long RaceStatisticsClass::GetStandardDeviation(const Series &Statistic) {
+   if (Statistic.Count < 2) {
+      return 0;
+   }
+   //Sum * (Sum / Count) instead of Sum * Sum / Count, which could overflow for long sessions
+   int64_t SquaredDeviations = Statistic.SquaredSum - Statistic.Sum * (Statistic.Sum / Statistic.Count);
+   if (SquaredDeviations <= 0) {
+      return 0;
+   }
+   return _SquareRoot(SquaredDeviations / (Statistic.Count - 1));
+}
+
+/// <summary>
+///   Gets the time a dog is expected to add to the team time: its mean run time plus the mean late
+///   part of its crossings. Only late crossings add to the team time, an early crossing counts as 0.
+/// </summary>
+///
+/// <returns>
+///   The expected time in milliseconds, 0 if the dog has no runs yet.
+/// </returns>
+unsigned long RaceStatisticsClass::GetExpectedRunTime(uint8_t DogIndex) const {
+   const Series &Runs = _DogSeries[DogIndex][RUN_TIMES];
+   if (Runs.Count == 0) {
+      return 0;
+   }
+
+   unsigned long ExpectedTime = GetMean(Runs);
+   const Series &Crossings = _DogSeries[DogIndex][CROSSING_TIMES];
+   if (Crossings.Count > 0) {
+      ExpectedTime += (_LateCrossingSums[DogIndex] + Crossings.Count / 2) / Crossings.Count;
+   }
+   return ExpectedTime;
+}
+
+/// <summary>
+///   Gets the best heat time of the team in milliseconds, 0 if no heat finished without faults.
+/// </summary>
+unsigned long RaceStatisticsClass::GetBestHeatTime() const {
+   return (_TeamSeries.Count > 0) ? _TeamSeries.Minimum : 0;
+}
+
+/// <summary>
+///   Gets the square root of a value, rounded to the nearest integer.
+/// </summary>
+unsigned long RaceStatisticsClass::_SquareRoot(uint64_t Value) {
+   uint64_t Root = 0;
+   uint64_t Bit = (uint64_t)1 << 62;
+   while (Bit > Value) {
+      Bit >>= 2;
+   }
+   while (Bit != 0) {
+      if (Value >= Root + Bit) {
+         Value -= Root + Bit;
+         Root = (Root >> 1) + Bit;
+      } else {
+         Root >>= 1;
+      }
+      Bit >>= 2;
+   }
+   //Value is now the remainder, (Root + 0.5)^2 = Root^2 + Root + 0.25
+   if (Value > Root) {
+      Root++;
+   }
+   return (unsigned long)Root;
+}
+
+/// <summary>
+///   Adds a sample to a series and counts it in the histogram bin of BinValue: bin 0 below Origin,
+///   then one bin per BinWidth, the last bin also holds the rest.
+/// </summary>
+void RaceStatisticsClass::_AddSample(Series &Statistic, long Value, long BinValue, long Origin, long BinWidth) {
+   if (Statistic.Count == 0xFFFF) {
+      return;
+   }
+
+   if (Statistic.Count == 0) {
+      Statistic.Shift = Value;
+   }
+   Statistic.Count++;
+   int64_t Deviation = (int64_t)Value - Statistic.Shift;
+   Statistic.Sum += Deviation;
+   Statistic.SquaredSum += Deviation * Deviation;
+   if (Statistic.Count == 1 || Value < Statistic.Minimum) {
+      Statistic.Minimum = Value;
+   }
+   if (Statistic.Count == 1 || Value > Statistic.Maximum) {
+      Statistic.Maximum = Value;
+   }
+
+   uint8_t Bin = 0;
+   if (BinValue >= Origin) {
+      Bin = min((BinValue - Origin) / BinWidth + 1, (long)STATS_HISTOGRAM_BINS - 1);
+   }
+   if (Statistic.Histogram[Bin] < 255) {
+      Statistic.Histogram[Bin]++;
+   }
+}
+
+RaceStatisticsClass RaceStatistics;
@@ -0,0 +1,74 @@
+#ifndef _RACESTATISTICS_h
+#define _RACESTATISTICS_h
+
+#include "Arduino.h"
+#include "Structs.h"
+
+//The first histogram bin holds everything below the origin (for crossings: the early ones), the
+//last one everything above the other bins
+#define STATS_HISTOGRAM_BINS 8
+#ifndef STATS_RUN_ORIGIN
+#define STATS_RUN_ORIGIN 3500          //Milliseconds
+#endif
+#ifndef STATS_RUN_BIN_WIDTH
+#define STATS_RUN_BIN_WIDTH 250
+#endif
+#define STATS_CROSSING_ORIGIN 0
+#ifndef STATS_CROSSING_BIN_WIDTH
+#define STATS_CROSSING_BIN_WIDTH 25
+#endif
+#ifndef STATS_HEAT_ORIGIN
+#define STATS_HEAT_ORIGIN 16000
+#endif
+#ifndef STATS_HEAT_BIN_WIDTH
+#define STATS_HEAT_BIN_WIDTH 500
+#endif
+
+/// <summary>
+///   Statistics of the heats of a session, updated once per heat when the race stops. Every dog
+///   has a series of run times (ms) and of crossing times (us), the team a series of heat times
+///   (ms) of the heats which finished without faults. A series keeps the number of samples, the
+///   integer sum and sum of squares of the samples relative to the first one, the minimum, the
+///   maximum and a fixed bin histogram, so the memory use does not grow with the number of heats
+///   and no precision is lost to floating point. The statistics are kept until they are cleared,
+///   e.g. when another team runs.
+/// </summary>
+class RaceStatisticsClass {
+   public:
+      enum SeriesTypes {
+         RUN_TIMES,
+         CROSSING_TIMES
+      };
+
+      struct Series {
+         uint16_t Count;
+         long Shift;             //First sample, the sums are relative to it so they stay small
+         int64_t Sum;            //Sum of (sample - Shift)
+         int64_t SquaredSum;     //Sum of (sample - Shift)^2
+         long Minimum;
+         long Maximum;
+         uint8_t Histogram[STATS_HISTOGRAM_BINS];  //Saturates at 255
+      };
+
+      void AddRace(const RaceData &Race);
+      void Clear();
+
+      const Series &GetDogSeries(uint8_t DogIndex, SeriesTypes Type) const;
+      const Series &GetTeamSeries() const;
+      static long GetMean(const Series &Statistic);
+      static long GetStandardDeviation(const Series &Statistic);
+      unsigned long GetExpectedRunTime(uint8_t DogIndex) const;
+      unsigned long GetBestHeatTime() const;
+
+   private:
+      Series _DogSeries[RaceRules::DogsPerTeam][2];
+      Series _TeamSeries;
+      unsigned long _LateCrossingSums[RaceRules::DogsPerTeam];   //Late part of the crossings (ms), early ones add 0
+
+      static unsigned long _SquareRoot(uint64_t Value);
+      void _AddSample(Series &Statistic, long Value, long BinValue, long Origin, long BinWidth);
+};
+
+extern RaceStatisticsClass RaceStatistics;
+
+#endif
@@ -0,0 +1,71 @@
+#include "RerunCycler.h"
+
+/// <summary>
+///   Shows the first run of every dog again, should be called when the race is reset.
+/// </summary>
+void RerunCyclerClass::Reset() {
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      _ShownRuns[DogIndex] = 0;
+      _LastCycleTimes[DogIndex] = 0;
+   }
+}
+
+/// <summary>
+///   Moves on to the next run for every dog with reruns whose current run has been shown long
+///   enough.
+/// </summary>
+///
+/// <param name="Data">   The race data to cycle through. </param>
+/// <param name="Now">    The current time in milliseconds. </param>
+///
+/// <returns>
+///   A bit mask of the dogs for which another run is shown now (bit 0 for the first dog).
+/// </returns>
+uint8_t RerunCyclerClass::Update(const RaceData &Data, unsigned long Now) {
+   uint8_t ChangedDogs = 0;
+
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      uint8_t LastRunNumber = Data.DogData[DogIndex].LastRunNumber;
+      if (LastRunNumber == 0 || (Now - _LastCycleTimes[DogIndex]) <= RERUN_CYCLE_INTERVAL) {
+         continue;
+      }
+
+      _ShownRuns[DogIndex] = (_ShownRuns[DogIndex] >= LastRunNumber) ? 0 : _ShownRuns[DogIndex] + 1;
+      _LastCycleTimes[DogIndex] = Now;
+      ChangedDogs |= (1 << DogIndex);
+   }
+
+   return ChangedDogs;
+}
+
+/// <summary>
+///   Gets the zero-based run number which should be shown for a dog.
+/// </summary>
+uint8_t RerunCyclerClass::GetShownRun(uint8_t DogIndex) const {
+   return _ShownRuns[DogIndex];
+}
+
+/// <summary>
+///   Gets rerun information to put on LCD. If a dog has done more than 1 run, before the dogs
+///   time we will display and * (asterisk) followed by the run number for which we are showing
+///   the time. If a dog has not done a rerun, the space before the dogs time is empty.
+/// </summary>
+///
+/// <param name="Data">       The race data the shown run belongs to. </param>
+/// <param name="DogIndex">   Zero-based index of the dog number. </param>
+///
+/// <returns>
+///   The rerun information. * (asterisk) followed by run number if there is more than 1 run for
+///   this dog. Empty string if the dog did only do 1 run.
+/// </returns>
+String RerunCyclerClass::GetRerunInfo(const RaceData &Data, uint8_t DogIndex) const {
+   String RerunInfo = F("  ");
+
+   if (Data.DogData[DogIndex].LastRunNumber > 0) {
+      RerunInfo = F("*");
+      RerunInfo += (_ShownRuns[DogIndex] + 1);
+   }
+   return RerunInfo;
+}
+
+RerunCyclerClass RerunCycler;
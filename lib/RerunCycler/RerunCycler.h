@@ -0,0 +1,27 @@
+#ifndef _RERUNCYCLER_h
+#define _RERUNCYCLER_h
+
+#include "Arduino.h"
+#include "Structs.h"
+
+/// <summary>
+///   Decides which run of each dog is shown on the display. Dogs with reruns alternate between
+///   their runs, showing a new run every RERUN_CYCLE_INTERVAL ms. This is display state only, the
+///   race data itself is not touched.
+/// </summary>
+class RerunCyclerClass {
+   public:
+      void Reset();
+      uint8_t Update(const RaceData &Data, unsigned long Now);
+      uint8_t GetShownRun(uint8_t DogIndex) const;
+      String GetRerunInfo(const RaceData &Data, uint8_t DogIndex) const;
+
+   private:
+      #define RERUN_CYCLE_INTERVAL 2000
+      uint8_t _ShownRuns[RaceRules::DogsPerTeam];
+      unsigned long _LastCycleTimes[RaceRules::DogsPerTeam];
+};
+
+extern RerunCyclerClass RerunCycler;
+
+#endif
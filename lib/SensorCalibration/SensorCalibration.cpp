@@ -0,0 +1,176 @@
+#include "SensorCalibration.h"
+#include <EEPROM.h>
+
+/// <summary>
+///   Starts a new calibration, all passes seen so far are discarded. Both beams should be clear.
+/// </summary>
+void SensorCalibrationClass::Reset() {
+   memset(_Sums, 0, sizeof(_Sums));
+   memset(_BeamBroken, 0, sizeof(_BeamBroken));
+   _PassEdges = 0;
+}
+
+/// <summary>
+///   Adds a raw sensor edge (before any offset is applied). Edges which don't belong to a clean
+///   pass are ignored.
+/// </summary>
+///
+/// <param name="SensorNumber"> The sensor number (1-2). </param>
+/// <param name="SensorState">  The sensor state, 1 if the beam was broken. </param>
+/// <param name="TriggerTime">  The trigger time in microseconds. </param>
+void SensorCalibrationClass::AddEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime) {
+   if (SensorNumber < 1 || SensorNumber > SENSOR_CALIBRATION_SENSORS) {
+      return;
+   }
+
+   bool GatesClear = !_BeamBroken[0] && !_BeamBroken[1];
+   _BeamBroken[SensorNumber - 1] = SensorState;
+
+   if (_PassEdges > 0 && (TriggerTime - _PassTimes[0]) > SENSOR_CALIBRATION_PASS_TIMEOUT) {
+      _PassEdges = 0;
+   }
+
+   if (_PassEdges == 0) {
+      if (GatesClear && SensorState) {
+         _FirstSensorNumber = SensorNumber;
+         _PassTimes[0] = TriggerTime;
+         _PassEdges = 1;
+      }
+      return;
+   }
+
+   //A clean pass is: first beam broken, second beam broken, first beam restored, second beam restored
+   bool FirstSensor = (SensorNumber == _FirstSensorNumber);
+   bool Expected = (_PassEdges == 1 && !FirstSensor && SensorState)
+      || (_PassEdges == 2 && FirstSensor && !SensorState)
+      || (_PassEdges == 3 && !FirstSensor && !SensorState);
+   if (!Expected) {
+      _PassEdges = 0;
+      return;
+   }
+
+   _PassTimes[_PassEdges++] = TriggerTime;
+   if (_PassEdges == 4) {
+      _AddPass();
+      _PassEdges = 0;
+   }
+}
+
+/// <summary>
+///   Gets the number of clean passes in one direction.
+/// </summary>
+///
+/// <param name="FirstSensorNumber">   The sensor which was broken first: 1 for passes going in,
+///                                    2 for passes coming back. </param>
+///
+/// <returns>
+///   The number of clean passes.
+/// </returns>
+uint8_t SensorCalibrationClass::GetPassCount(uint8_t FirstSensorNumber) {
+   if (FirstSensorNumber < 1 || FirstSensorNumber > SENSOR_CALIBRATION_SENSORS) {
+      return 0;
+   }
+   return _Sums[FirstSensorNumber - 1].Count;
+}
+
+/// <summary>
+///   Estimates the offsets from the passes seen since Reset(). With L the object length over the
+///   sensor distance, B1/A0/B0 the offsets of the other edges and X the gap between both breaks:
+///     going in:    Y1 = L * X + A0 - L * B1,   Y2 = (1 + L) * X + B0 - (1 + L) * B1
+///     coming back: Y1 = L * X + B0 - B1 + L * B1,   Y2 = (1 + L) * X + A0 + L * B1
+///   L is fitted over the passes of both directions, the four intercepts give the offsets.
+///   Everything is done in 64 bit integers, L in Q16.
+/// </summary>
+///
+/// <param name="Offsets">   [out] The estimated offsets. </param>
+///
+/// <returns>
+///   true if the offsets could be estimated, false if there are not enough passes in each
+///   direction, the speeds didn't vary or the result is not plausible.
+/// </returns>
+bool SensorCalibrationClass::Estimate(long Offsets[SENSOR_CALIBRATION_SENSORS][2]) {
+   const PassSums &In = _Sums[0];
+   const PassSums &Out = _Sums[1];
+   if (In.Count < SENSOR_CALIBRATION_MIN_PASSES || Out.Count < SENSOR_CALIBRATION_MIN_PASSES) {
+      return false;
+   }
+
+   int64_t Variance = (In.XX - In.X * In.X / In.Count) + (Out.XX - Out.X * Out.X / Out.Count);
+   int64_t Covariance = (In.XY1 - In.X * In.Y1 / In.Count) + (Out.XY1 - Out.X * Out.Y1 / Out.Count);
+   if (Variance <= 0 || Covariance <= 0) {
+      return false;
+   }
+   int64_t Length = Covariance * 65536 / Variance;
+
+   long InOccluded = (In.Y1 - ((Length * In.X) >> 16)) / In.Count;
+   long InCleared = (In.Y2 - In.X - ((Length * In.X) >> 16)) / In.Count;
+   long OutOccluded = (Out.Y1 - ((Length * Out.X) >> 16)) / Out.Count;
+   long OutCleared = (Out.Y2 - Out.X - ((Length * Out.X) >> 16)) / Out.Count;
+
+   long Sensor2Broken = (int64_t)(OutCleared - InOccluded) * 32768 / Length;
+   long Estimated[SENSOR_CALIBRATION_SENSORS][2];
+   Estimated[0][1] = 0;
+   Estimated[0][0] = (InOccluded + OutCleared) / 2;
+   Estimated[1][1] = Sensor2Broken;
+   Estimated[1][0] = (InCleared + OutOccluded) / 2 + Sensor2Broken;
+
+   for (uint8_t Sensor = 0; Sensor < SENSOR_CALIBRATION_SENSORS; Sensor++) {
+      for (uint8_t State = 0; State < 2; State++) {
+         if (labs(Estimated[Sensor][State]) > SENSOR_OFFSET_MAX) {
+            return false;
+         }
+      }
+   }
+
+   memcpy(Offsets, Estimated, sizeof(Estimated));
+   return true;
+}
+
+/// <summary>
+///   Loads the offsets from EEPROM, all offsets are 0 if none were stored.
+/// </summary>
+///
+/// <param name="Offsets">   [out] The stored offsets. </param>
+void SensorCalibrationClass::Load(long Offsets[SENSOR_CALIBRATION_SENSORS][2]) {
+   OffsetsRecord Record;
+   EEPROM.get(EEPROM_SENSOR_OFFSETS_START, Record);
+   if (Record.Magic == SENSOR_OFFSETS_MAGIC) {
+      memcpy(Offsets, Record.Offsets, sizeof(Record.Offsets));
+   } else {
+      memset(Offsets, 0, sizeof(Record.Offsets));
+   }
+}
+
+/// <summary>
+///   Stores the offsets in EEPROM.
+/// </summary>
+///
+/// <param name="Offsets">   The offsets to store. </param>
+void SensorCalibrationClass::Save(const long Offsets[SENSOR_CALIBRATION_SENSORS][2]) {
+   OffsetsRecord Record;
+   Record.Magic = SENSOR_OFFSETS_MAGIC;
+   memcpy(Record.Offsets, Offsets, sizeof(Record.Offsets));
+   EEPROM.put(EEPROM_SENSOR_OFFSETS_START, Record);
+}
+
+/// <summary>
+///   Adds the pass in _PassTimes to the sums of its direction.
+/// </summary>
+void SensorCalibrationClass::_AddPass() {
+   PassSums &Sums = _Sums[_FirstSensorNumber - 1];
+   if (Sums.Count >= SENSOR_CALIBRATION_MAX_PASSES) {
+      return;
+   }
+
+   long X = _PassTimes[1] - _PassTimes[0];
+   long Y1 = _PassTimes[2] - _PassTimes[0];
+   long Y2 = _PassTimes[3] - _PassTimes[0];
+   Sums.Count++;
+   Sums.X += X;
+   Sums.Y1 += Y1;
+   Sums.Y2 += Y2;
+   Sums.XX += (int64_t)X * X;
+   Sums.XY1 += (int64_t)X * Y1;
+}
+
+SensorCalibrationClass SensorCalibration;
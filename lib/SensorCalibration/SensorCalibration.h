@@ -0,0 +1,64 @@
+#ifndef _SENSORCALIBRATION_h
+#define _SENSORCALIBRATION_h
+
+#include "Arduino.h"
+#include "EepromLayout.h"
+
+#define SENSOR_CALIBRATION_SENSORS 2
+#define SENSOR_CALIBRATION_MIN_PASSES 10     //Clean passes needed in each direction
+#define SENSOR_CALIBRATION_MAX_PASSES 100    //More passes are ignored, this keeps the sums in 64 bits
+#define SENSOR_CALIBRATION_PASS_TIMEOUT 500000UL
+#define SENSOR_OFFSET_MAX 20000L             //Largest offset (us) accepted
+
+/// <summary>
+///   Estimates the delay of the IR receivers, separately for the beam broken and the beam
+///   restored edge of each sensor, from clean passes (ABab or BAba) of one object through the gates
+///   in both directions at different speeds.
+///
+///   For a pass at constant speed the gap between both beam breaks is proportional to the time the
+///   object takes to cover the sensor distance, the time each beam stays broken to the object length.
+///   Fitting both against each other over passes at different speeds, separately per direction, the
+///   intercepts give the offsets. Only differences between the edges are observable, so the offsets
+///   are relative to the beam broken edge of sensor 1, which has offset 0.
+///   All offsets are in microseconds, indexed by [sensor number - 1][sensor state].
+/// </summary>
+class SensorCalibrationClass {
+   public:
+      void Reset();
+      void AddEdge(uint8_t SensorNumber, uint8_t SensorState, unsigned long TriggerTime);
+      uint8_t GetPassCount(uint8_t FirstSensorNumber);
+      bool Estimate(long Offsets[SENSOR_CALIBRATION_SENSORS][2]);
+      void Load(long Offsets[SENSOR_CALIBRATION_SENSORS][2]);
+      void Save(const long Offsets[SENSOR_CALIBRATION_SENSORS][2]);
+
+   private:
+      //Sums over all clean passes in one direction. X: gap between the breaks of the first and
+      //second beam, Y1: time the first beam was broken, Y2: time until the second beam was restored
+      struct PassSums {
+         uint8_t Count;
+         int64_t X;
+         int64_t Y1;
+         int64_t Y2;
+         int64_t XX;
+         int64_t XY1;
+      };
+      PassSums _Sums[SENSOR_CALIBRATION_SENSORS];
+
+      bool _BeamBroken[SENSOR_CALIBRATION_SENSORS];
+      uint8_t _PassEdges;                 //Edges of the current pass seen so far, 0 if no pass is going on
+      uint8_t _FirstSensorNumber;
+      unsigned long _PassTimes[4];
+
+      struct OffsetsRecord {
+         uint16_t Magic;
+         long Offsets[SENSOR_CALIBRATION_SENSORS][2];
+      };
+
+      #define SENSOR_OFFSETS_MAGIC 0x4F46
+
+      void _AddPass();
+};
+
+extern SensorCalibrationClass SensorCalibration;
+
+#endif
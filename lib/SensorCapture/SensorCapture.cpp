@@ -0,0 +1,40 @@
+#include "SensorCapture.h"
+
+/// <summary>
+///   Looks up the input register and bit of all sensor pins, so they can be sampled without
+///   digitalRead().
+/// </summary>
+void SensorCaptureClass::_InitPins(uint8_t Sensor1Pin, uint8_t Sensor2Pin) {
+#ifdef BOX_SENSOR_PIN
+   const uint8_t Pins[NUM_CAPTURED_SENSORS] = {Sensor1Pin, Sensor2Pin, BOX_SENSOR_PIN};
+#else
+   const uint8_t Pins[NUM_CAPTURED_SENSORS] = {Sensor1Pin, Sensor2Pin};
+#endif
+   for (uint8_t Sensor = 0; Sensor < NUM_CAPTURED_SENSORS; Sensor++) {
+      pinMode(Pins[Sensor], INPUT);
+      _InputRegisters[Sensor] = portInputRegister(digitalPinToPort(Pins[Sensor]));
+      _BitMasks[Sensor] = digitalPinToBitMask(Pins[Sensor]);
+   }
+}
+
+/// <summary>
+///   Starts Timer2 in CTC mode with prescaler 8 (2MHz), HandleSample() is called SampleRate times
+///   per second.
+/// </summary>
+///
+/// <param name="SampleRate">   The sample rate, at least 7813Hz. </param>
+void SensorCaptureClass::_StartSampleTimer(uint16_t SampleRate) {
+   noInterrupts();
+   TCCR2A = _BV(WGM21);
+   TCCR2B = _BV(CS21);
+   OCR2A = F_CPU / 8 / SampleRate - 1;
+   TCNT2 = 0;
+   TIMSK2 = _BV(OCIE2A);
+   interrupts();
+}
+
+ISR(TIMER2_COMPA_vect) {
+   SensorCapture.HandleSample();
+}
+
+SensorCaptureClass SensorCapture;
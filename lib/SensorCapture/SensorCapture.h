@@ -0,0 +1,57 @@
+#ifndef _SENSORCAPTURE_h
+#define _SENSORCAPTURE_h
+
+#include "Arduino.h"
+#include <BeamRecorder.h>
+
+//The gate sensors come first, the optional box sensor (BOX_SENSOR_PIN) is captured after them
+#define NUM_GATE_SENSORS 2
+#ifdef BOX_SENSOR_PIN
+#define NUM_CAPTURED_SENSORS 3
+#else
+#define NUM_CAPTURED_SENSORS 2
+#endif
+
+#ifndef SENSOR_SAMPLE_RATE
+#define SENSOR_SAMPLE_RATE 20000   //Samples per second per sensor, sampled backend only
+#endif
+
+#ifndef SENSOR_STABLE_SAMPLES
+#define SENSOR_STABLE_SAMPLES 4    //Equal samples (1-8) needed before an edge is accepted, sampled backend only
+#endif
+
+/// <summary>
+///   Captures the edges of the sensors and pushes them to RaceHandler. The default backend uses a
+///   pin change interrupt per sensor, so every edge is timestamped within a few microseconds, but
+///   a chattering sensor can raise any number of interrupts. When built with SENSOR_CAPTURE_SAMPLED,
+///   Timer2 samples both sensors at SENSOR_SAMPLE_RATE instead and an edge is only pushed after
+///   SENSOR_STABLE_SAMPLES equal samples. The CPU load is then fixed whatever the sensors do, the
+///   timestamp resolution is one sample period (50us at 20kHz).
+///   Both backends feed the raw beam states to BeamRecorder at BEAM_SAMPLE_RATE, the interrupt
+///   backend runs Timer2 for that alone.
+///   With BOX_SENSOR_PIN the box sensor is captured the same way as sensor 3, it is not recorded
+///   by BeamRecorder.
+/// </summary>
+class SensorCaptureClass {
+   public:
+      void Init(uint8_t Sensor1Pin, uint8_t Sensor2Pin);
+
+      void HandleSample();
+
+   private:
+      volatile uint8_t *_InputRegisters[NUM_CAPTURED_SENSORS];
+      uint8_t _BitMasks[NUM_CAPTURED_SENSORS];
+
+      void _InitPins(uint8_t Sensor1Pin, uint8_t Sensor2Pin);
+      void _StartSampleTimer(uint16_t SampleRate);
+
+#ifdef SENSOR_CAPTURE_SAMPLED
+      uint8_t _History[NUM_CAPTURED_SENSORS];      //Last 8 samples, newest in bit 0
+      uint8_t _StableState[NUM_CAPTURED_SENSORS];
+      uint8_t _BeamSampleCountdown = 1;
+#endif
+};
+
+extern SensorCaptureClass SensorCapture;
+
+#endif
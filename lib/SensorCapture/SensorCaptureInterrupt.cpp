@@ -0,0 +1,52 @@
+#ifndef SENSOR_CAPTURE_SAMPLED
+#include "SensorCapture.h"
+#include <RaceHandler.h>
+
+#if F_CPU / 8 / BEAM_SAMPLE_RATE > 256
+#error "BEAM_SAMPLE_RATE is too low for Timer2"
+#endif
+
+static void Sensor1Edge() {
+   RaceHandler.TriggerSensor1();
+}
+
+static void Sensor2Edge() {
+   RaceHandler.TriggerSensor2();
+}
+
+#ifdef BOX_SENSOR_PIN
+static void BoxSensorEdge() {
+   RaceHandler.TriggerBoxSensor();
+}
+#endif
+
+/// <summary>
+///   Initialises this object, the sensors trigger an interrupt on every change.
+/// </summary>
+///
+/// <param name="Sensor1Pin">  The pin of sensor 1, needs an external interrupt. </param>
+/// <param name="Sensor2Pin">  The pin of sensor 2, needs an external interrupt. </param>
+void SensorCaptureClass::Init(uint8_t Sensor1Pin, uint8_t Sensor2Pin) {
+   _InitPins(Sensor1Pin, Sensor2Pin);
+   attachInterrupt(digitalPinToInterrupt(Sensor1Pin), Sensor1Edge, CHANGE);
+   attachInterrupt(digitalPinToInterrupt(Sensor2Pin), Sensor2Edge, CHANGE);
+#ifdef BOX_SENSOR_PIN
+   attachInterrupt(digitalPinToInterrupt(BOX_SENSOR_PIN), BoxSensorEdge, CHANGE);
+#endif
+   _StartSampleTimer(BEAM_SAMPLE_RATE);
+}
+
+/// <summary>
+///   Samples both gate beams for BeamRecorder, called from the Timer2 compare interrupt.
+/// </summary>
+void SensorCaptureClass::HandleSample() {
+   uint8_t Beams = 0;
+   for (uint8_t Sensor = 0; Sensor < NUM_GATE_SENSORS; Sensor++) {
+      if (*_InputRegisters[Sensor] & _BitMasks[Sensor]) {
+         Beams |= 1 << Sensor;
+      }
+   }
+   BeamRecorder.Sample(Beams);
+}
+
+#endif
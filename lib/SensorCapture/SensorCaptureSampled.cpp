@@ -0,0 +1,69 @@
+#ifdef SENSOR_CAPTURE_SAMPLED
+#include "SensorCapture.h"
+#include <RaceHandler.h>
+
+#define SAMPLE_PERIOD (1000000UL / SENSOR_SAMPLE_RATE)
+#define STABLE_MASK ((uint8_t)((1 << SENSOR_STABLE_SAMPLES) - 1))
+
+//A new state was first seen SENSOR_STABLE_SAMPLES - 1 samples before it is accepted, the edge
+//itself happened somewhere in the sample period before that
+#define EDGE_DELAY ((SENSOR_STABLE_SAMPLES - 1) * SAMPLE_PERIOD + SAMPLE_PERIOD / 2)
+
+#if SENSOR_STABLE_SAMPLES < 1 || SENSOR_STABLE_SAMPLES > 8
+#error "SENSOR_STABLE_SAMPLES must be between 1 and 8"
+#endif
+
+#if F_CPU / 8 / SENSOR_SAMPLE_RATE > 256
+#error "SENSOR_SAMPLE_RATE is too low for Timer2"
+#endif
+
+#if SENSOR_SAMPLE_RATE % BEAM_SAMPLE_RATE != 0
+#error "SENSOR_SAMPLE_RATE must be a multiple of BEAM_SAMPLE_RATE"
+#endif
+
+/// <summary>
+///   Initialises this object and starts sampling the sensors with Timer2.
+/// </summary>
+///
+/// <param name="Sensor1Pin">  The pin of sensor 1. </param>
+/// <param name="Sensor2Pin">  The pin of sensor 2. </param>
+void SensorCaptureClass::Init(uint8_t Sensor1Pin, uint8_t Sensor2Pin) {
+   _InitPins(Sensor1Pin, Sensor2Pin);
+   for (uint8_t Sensor = 0; Sensor < NUM_CAPTURED_SENSORS; Sensor++) {
+      //Start from the current state so no edge is pushed at power up
+      _StableState[Sensor] = (*_InputRegisters[Sensor] & _BitMasks[Sensor]) ? 1 : 0;
+      _History[Sensor] = _StableState[Sensor] ? 0xFF : 0x00;
+   }
+
+   _StartSampleTimer(SENSOR_SAMPLE_RATE);
+}
+
+/// <summary>
+///   Takes one sample of each sensor, called from the Timer2 compare interrupt. Pushes an edge to
+///   RaceHandler when a sensor has been in a new state for SENSOR_STABLE_SAMPLES samples, shorter
+///   pulses (chatter) are never seen by RaceHandler. Every SENSOR_SAMPLE_RATE / BEAM_SAMPLE_RATE
+///   samples the raw beam states also go to BeamRecorder.
+/// </summary>
+void SensorCaptureClass::HandleSample() {
+   uint8_t Beams = 0;
+   for (uint8_t Sensor = 0; Sensor < NUM_CAPTURED_SENSORS; Sensor++) {
+      uint8_t History = (_History[Sensor] << 1) | ((*_InputRegisters[Sensor] & _BitMasks[Sensor]) ? 1 : 0);
+      _History[Sensor] = History;
+      if (Sensor < NUM_GATE_SENSORS) {
+         Beams |= (History & 1) << Sensor;
+      }
+
+      uint8_t Recent = History & STABLE_MASK;
+      if ((Recent == STABLE_MASK && !_StableState[Sensor]) || (Recent == 0 && _StableState[Sensor])) {
+         _StableState[Sensor] = !_StableState[Sensor];
+         RaceHandler.PushSensorEdge(Sensor + 1, _StableState[Sensor], micros() - EDGE_DELAY);
+      }
+   }
+
+   if (--_BeamSampleCountdown == 0) {
+      _BeamSampleCountdown = SENSOR_SAMPLE_RATE / BEAM_SAMPLE_RATE;
+      BeamRecorder.Sample(Beams);
+   }
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include "SerialCommands.h"
+#include <Telemetry.h>
+
+/// <summary>
+///   Initialises this object.
+/// </summary>
+///
+/// <param name="Input">   The stream to read commands from. </param>
+void SerialCommandsClass::Init(Stream *Input) {
+   _Input = Input;
+}
+
+/// <summary>
+///   Registers a command. The name is compared case insensitive and is kept in flash.
+/// </summary>
+///
+/// <param name="Name">      The command name, e.g. F("START"). </param>
+/// <param name="Handler">   The function which executes the command. </param>
+///
+/// <returns>
+///   true if the command was added, false if the command table is full.
+/// </returns>
+bool SerialCommandsClass::AddCommand(const __FlashStringHelper *Name, CommandHandler Handler) {
+   if (_CommandCount >= MAX_SERIAL_COMMANDS) {
+      return false;
+   }
+
+   _Commands[_CommandCount++] = {Name, Handler};
+   return true;
+}
+
+/// <summary>
+///   Sets the reason which is sent with the ERR reply, for use by command handlers which fail.
+/// </summary>
+///
+/// <param name="Reason">  Short upper case reason in flash, e.g. F("STATE"). </param>
+void SerialCommandsClass::SetError(const __FlashStringHelper *Reason) {
+   _Error = Reason;
+}
+
+/// <summary>
+///   Main entry-point for this object, should be called once every main loop. Reads the characters
+///   which are waiting on the serial port (at most SERIAL_COMMAND_BYTES_PER_CALL) and executes the
+///   command once a complete line was received. Lines which don't fit in the buffer are dropped.
+/// </summary>
+void SerialCommandsClass::Main() {
+   for (uint8_t i = 0; i < SERIAL_COMMAND_BYTES_PER_CALL && _Input->available() > 0; i++) {
+      char Character = _Input->read();
+
+      if (Character == '\r' || Character == '\n') {
+         if (_LineOverflow) {
+            Telemetry.BeginFrame(F("ERR"));
+            Telemetry.AddField(F("LINE"));
+            Telemetry.AddField(F("LENGTH"));
+            Telemetry.EndFrame();
+         } else if (_LineLength > 0) {
+            _Line[_LineLength] = '\0';
+            _Execute();
+         }
+         _LineLength = 0;
+         _LineOverflow = false;
+      } else if (_LineLength < SERIAL_COMMAND_BUFFER_LENGTH - 1) {
+         _Line[_LineLength++] = Character;
+      } else {
+         _LineOverflow = true;
+      }
+   }
+}
+
+/// <summary>
+///   Splits the received line in the command name and arguments, and calls the command handler.
+/// </summary>
+void SerialCommandsClass::_Execute() {
+   char *Arguments[SERIAL_COMMAND_MAX_ARGUMENTS + 1];
+   uint8_t ArgumentCount = 0;
+   const char *Separators = " ,";
+
+   char *Token = strtok(_Line, Separators);
+   while (Token != NULL && ArgumentCount <= SERIAL_COMMAND_MAX_ARGUMENTS) {
+      Arguments[ArgumentCount++] = Token;
+      Token = strtok(NULL, Separators);
+   }
+
+   if (ArgumentCount == 0) {
+      return;
+   }
+
+   const char *Name = Arguments[0];
+   for (uint8_t CommandIndex = 0; CommandIndex < _CommandCount; CommandIndex++) {
+      if (strcasecmp_P(Name, reinterpret_cast<PGM_P>(_Commands[CommandIndex].Name)) != 0) {
+         continue;
+      }
+
+      _Error = NULL;
+      if (Token != NULL) {
+         //More arguments than we have room for
+         _Error = F("ARG");
+      } else if (!_Commands[CommandIndex].Handler(ArgumentCount - 1, &Arguments[1]) && _Error == NULL) {
+         _Error = F("ARG");
+      }
+      _BeginReply();
+      Telemetry.AddField(_Commands[CommandIndex].Name);
+      _EndReply();
+      return;
+   }
+
+   _Error = F("UNKNOWN");
+   _BeginReply();
+   Telemetry.AddField(Name);
+   _EndReply();
+}
+
+/// <summary>
+///   Starts the reply for a command: "$ACK,NAME" if it succeeded or "$ERR,NAME,REASON" if it did
+///   not. The caller adds the name, which is in flash for known commands and in the line buffer
+///   for unknown ones.
+/// </summary>
+void SerialCommandsClass::_BeginReply() {
+   if (_Error == NULL) {
+      Telemetry.BeginFrame(F("ACK"));
+   } else {
+      Telemetry.BeginFrame(F("ERR"));
+   }
+}
+
+/// <summary>
+///   Finishes the reply for a command with the reason it failed, if it did.
+/// </summary>
+void SerialCommandsClass::_EndReply() {
+   if (_Error != NULL) {
+      Telemetry.AddField(_Error);
+   }
+   Telemetry.EndFrame();
+}
+
+SerialCommandsClass SerialCommands;
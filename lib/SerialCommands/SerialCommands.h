@@ -0,0 +1,49 @@
+#ifndef _SERIALCOMMANDS_h
+#define _SERIALCOMMANDS_h
+
+#include "Arduino.h"
+
+/// <summary>
+///   Non-blocking parser for text commands on a serial port. A command is one line: the command
+///   name followed by arguments separated by spaces or commas (e.g. "FAULT 2 ON"). Lines are
+///   collected in a fixed buffer and at most SERIAL_COMMAND_BYTES_PER_CALL characters are read per
+///   call to Main(). Every command is answered with an ACK or ERR telemetry frame.
+/// </summary>
+class SerialCommandsClass {
+   public:
+      //Command handlers get the arguments after the command name, Arguments[0] is the first one.
+      //Returning false makes the command fail with reason "ARG" unless the handler set another one.
+      typedef bool (*CommandHandler)(uint8_t ArgumentCount, char *Arguments[]);
+
+      void Init(Stream *Input);
+      bool AddCommand(const __FlashStringHelper *Name, CommandHandler Handler);
+      void SetError(const __FlashStringHelper *Reason);
+      void Main();
+
+   private:
+      #define SERIAL_COMMAND_BUFFER_LENGTH 32
+      #define SERIAL_COMMAND_MAX_ARGUMENTS 4
+      #define MAX_SERIAL_COMMANDS 16
+      #define SERIAL_COMMAND_BYTES_PER_CALL 16
+
+      struct Command {
+         const __FlashStringHelper *Name;
+         CommandHandler Handler;
+      };
+
+      Stream *_Input = &Serial;
+      Command _Commands[MAX_SERIAL_COMMANDS];
+      uint8_t _CommandCount = 0;
+      char _Line[SERIAL_COMMAND_BUFFER_LENGTH];
+      uint8_t _LineLength = 0;
+      bool _LineOverflow = false;
+      const __FlashStringHelper *_Error;
+
+      void _Execute();
+      void _BeginReply();
+      void _EndReply();
+};
+
+extern SerialCommandsClass SerialCommands;
+
+#endif
@@ -0,0 +1,54 @@
+#include "SpeedEstimator.h"
+
+/// <summary>
+///   Adds a clean pass of a dog.
+/// </summary>
+///
+/// <param name="DogIndex">   Zero-based index of the dog. </param>
+/// <param name="Direction">  The direction of the pass. </param>
+/// <param name="PassTime">   Time the dog needed from one beam to the other in microseconds. </param>
+///
+/// <returns>
+///   The speed of the pass in mm/s, 0 if the pass time is not plausible (the pass is not added).
+/// </returns>
+uint16_t SpeedEstimatorClass::AddPass(uint8_t DogIndex, PassDirections Direction, long PassTime) {
+   if (DogIndex >= RaceRules::DogsPerTeam || PassTime <= 0) {
+      return 0;
+   }
+
+   unsigned long Speed = (GATE_SENSOR_DISTANCE * 1000000UL) / (unsigned long)PassTime;
+   if (Speed > SPEED_MAX) {
+      return 0;
+   }
+
+   if (_PassCounts[DogIndex][Direction] < SPEED_AVERAGE_WINDOW) {
+      _PassCounts[DogIndex][Direction]++;
+   }
+   long Difference = (long)(Speed << 4) - (long)_Averages[DogIndex][Direction];
+   _Averages[DogIndex][Direction] += Difference / _PassCounts[DogIndex][Direction];
+   return Speed;
+}
+
+/// <summary>
+///   Gets the average speed of a dog in mm/s, 0 if the dog has no passes in this direction.
+/// </summary>
+uint16_t SpeedEstimatorClass::GetAverage(uint8_t DogIndex, PassDirections Direction) {
+   return (_Averages[DogIndex][Direction] + 8) >> 4;
+}
+
+/// <summary>
+///   Gets the number of passes in the average of a dog, at most SPEED_AVERAGE_WINDOW.
+/// </summary>
+uint8_t SpeedEstimatorClass::GetPassCount(uint8_t DogIndex, PassDirections Direction) {
+   return _PassCounts[DogIndex][Direction];
+}
+
+/// <summary>
+///   Clears the averages of all dogs.
+/// </summary>
+void SpeedEstimatorClass::Clear() {
+   memset(_Averages, 0, sizeof(_Averages));
+   memset(_PassCounts, 0, sizeof(_PassCounts));
+}
+
+SpeedEstimatorClass SpeedEstimator;
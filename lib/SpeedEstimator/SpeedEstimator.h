@@ -0,0 +1,39 @@
+#ifndef _SPEEDESTIMATOR_h
+#define _SPEEDESTIMATOR_h
+
+#include "Arduino.h"
+#include "RaceRules.h"
+
+#ifndef GATE_SENSOR_DISTANCE
+#define GATE_SENSOR_DISTANCE 150   //Distance between the beams of sensor 1 and sensor 2 in millimeters
+#endif
+#define SPEED_MAX 20000             //Faster passes (mm/s) are measurement errors
+#define SPEED_AVERAGE_WINDOW 16     //After this many passes the average becomes a moving average
+
+/// <summary>
+///   Speed of the dogs through the gates. The time a dog needs from one beam to the other is the
+///   average of the delay between both beam breaks (nose) and both beam restores (tail) of a clean
+///   pass. Speeds are in millimeters per second. Every dog has a running average per direction,
+///   which is kept across heats until it is cleared (e.g. for another team). The average is stored
+///   with 4 fractional bits.
+/// </summary>
+class SpeedEstimatorClass {
+   public:
+      enum PassDirections {
+         GOING_IN,
+         COMING_BACK
+      };
+
+      uint16_t AddPass(uint8_t DogIndex, PassDirections Direction, long PassTime);
+      uint16_t GetAverage(uint8_t DogIndex, PassDirections Direction);
+      uint8_t GetPassCount(uint8_t DogIndex, PassDirections Direction);
+      void Clear();
+
+   private:
+      unsigned long _Averages[RaceRules::DogsPerTeam][2];
+      uint8_t _PassCounts[RaceRules::DogsPerTeam][2];
+};
+
+extern SpeedEstimatorClass SpeedEstimator;
+
+#endif
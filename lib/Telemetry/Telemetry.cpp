@@ -0,0 +1,95 @@
+#include "Telemetry.h"
+
+/// <summary>
+///   Initialises this object.
+/// </summary>
+///
+/// <param name="Output">   The stream all frames should be written to. </param>
+void TelemetryClass::Init(Print *Output) {
+   _Output = Output;
+}
+
+/// <summary>
+///   Starts a new frame with the given tag. Fields are added with AddField() and the frame must be
+///   finished with EndFrame().
+/// </summary>
+///
+/// <param name="Tag">  Short upper case tag identifying the frame type (e.g. F("JRN")). </param>
+void TelemetryClass::BeginFrame(const __FlashStringHelper *Tag) {
+   _Checksum = 0;
+   _Output->write('$');
+   _Write(Tag);
+}
+
+void TelemetryClass::AddField(const char *Value) {
+   _Write(",");
+   _Write(Value);
+}
+
+void TelemetryClass::AddField(const __FlashStringHelper *Value) {
+   _Write(",");
+   _Write(Value);
+}
+
+void TelemetryClass::AddField(char Value) {
+   char Text[2] = {Value, '\0'};
+   AddField(Text);
+}
+
+void TelemetryClass::AddField(int Value) {
+   AddField((long)Value);
+}
+
+void TelemetryClass::AddField(unsigned int Value) {
+   AddField((unsigned long)Value);
+}
+
+void TelemetryClass::AddField(long Value) {
+   char Text[12];
+   ltoa(Value, Text, 10);
+   AddField(Text);
+}
+
+void TelemetryClass::AddField(unsigned long Value) {
+   char Text[11];
+   ultoa(Value, Text, 10);
+   AddField(Text);
+}
+
+/// <summary>
+///   Finishes the current frame by writing the checksum and line ending.
+/// </summary>
+void TelemetryClass::EndFrame() {
+   static const char HexDigits[] PROGMEM = "0123456789ABCDEF";
+
+   _Output->write('*');
+   _Output->write(pgm_read_byte(&HexDigits[_Checksum >> 4]));
+   _Output->write(pgm_read_byte(&HexDigits[_Checksum & 0x0F]));
+   _Output->write('\r');
+   _Output->write('\n');
+}
+
+/// <summary>
+///   Writes text to the output and adds it to the running checksum.
+/// </summary>
+void TelemetryClass::_Write(const char *Text) {
+   while (*Text != '\0') {
+      _Checksum ^= (uint8_t)*Text;
+      _Output->write((uint8_t)*Text);
+      Text++;
+   }
+}
+
+/// <summary>
+///   Writes text from flash to the output and adds it to the running checksum.
+/// </summary>
+void TelemetryClass::_Write(const __FlashStringHelper *Text) {
+   PGM_P Character = reinterpret_cast<PGM_P>(Text);
+   uint8_t Byte;
+   while ((Byte = pgm_read_byte(Character++)) != '\0') {
+      _Checksum ^= Byte;
+      _Output->write(Byte);
+   }
+}
+
+TelemetryClass Telemetry;
@@ -0,0 +1,35 @@
+#ifndef _TELEMETRY_h
+#define _TELEMETRY_h
+
+#include "Arduino.h"
+
+/// <summary>
+///   Writes compact, checksummed frames to a serial port. A frame looks like
+///   "$TAG,field1,field2*CS" followed by CR/LF, where CS is the hexadecimal XOR of all characters
+///   between '$' and '*' (same scheme as NMEA sentences). Tags and fixed texts are read from flash
+///   (F("...")) so they don't take SRAM.
+/// </summary>
+class TelemetryClass {
+   public:
+      void Init(Print *Output);
+      void BeginFrame(const __FlashStringHelper *Tag);
+      void AddField(const char *Value);
+      void AddField(const __FlashStringHelper *Value);
+      void AddField(char Value);
+      void AddField(int Value);
+      void AddField(unsigned int Value);
+      void AddField(long Value);
+      void AddField(unsigned long Value);
+      void EndFrame();
+
+   private:
+      Print *_Output = &Serial;
+      uint8_t _Checksum;
+
+      void _Write(const char *Text);
+      void _Write(const __FlashStringHelper *Text);
+};
+
+extern TelemetryClass Telemetry;
+
+#endif
@@ -0,0 +1,170 @@
+# memory_report.py
+# PlatformIO extra script which adds a "memreport" target:
+#
+#   pio run -t memreport
+#
+# It reports the static SRAM usage (.data + .bss) per class/global using avr-size and avr-nm, the
+# worst case stack depth per call chain (main and every ISR) using the -fstack-usage files and
+# the call graph from avr-objdump, and fails when the SRAM headroom left for the heap and
+# unknown stack usage is below custom_memory_min_headroom (platformio.ini, in bytes).
+
+import glob
+import os
+import re
+import subprocess
+from collections import defaultdict
+
+Import("env")
+
+SRAM_SIZE = 8192           # ATmega2560
+RETURN_ADDRESS_SIZE = 3    # 22 bit program counter
+ISR_CONTEXT_SIZE = 16      # Registers saved by an ISR prologue on top of its own frame (estimate)
+
+
+def run_tool(tool, *args):
+   return subprocess.check_output([tool] + list(args), universal_newlines=True)
+
+
+def tool_path(name):
+   return os.path.join(env.subst("$PROJECT_PACKAGES_DIR"), "toolchain-atmelavr", "bin", name)
+
+
+def normalize(function):
+   # "void RaceHandlerClass::Main()" (.su) and "RaceHandlerClass::Main()" (objdump) should match.
+   # Parameter lists are dropped since both tools print typedefs differently, overloads share
+   # the largest frame.
+   function = function.strip()
+   paren = function.find("(")
+   if paren >= 0:
+      function = function[:paren]
+   return function[function.rfind(" ") + 1:]
+
+
+def read_static_usage(elf):
+   sections = {}
+   for line in run_tool(tool_path("avr-size"), "-A", elf).splitlines():
+      fields = line.split()
+      if len(fields) >= 2 and fields[0] in (".data", ".bss", ".noinit"):
+         sections[fields[0]] = int(fields[1])
+
+   owners = defaultdict(int)
+   for line in run_tool(tool_path("avr-nm"), "-C", "-S", "--size-sort", elf).splitlines():
+      fields = line.split(None, 3)
+      if len(fields) < 4 or fields[2].lower() not in ("b", "d"):
+         continue
+      name = fields[3]
+      owner = name.split("::")[0] if "::" in name else name
+      owners[owner] += int(fields[1], 16)
+
+   return sections, owners
+
+
+def read_stack_usage(build_dir):
+   frames = {}
+   for su_file in glob.glob(os.path.join(build_dir, "**", "*.su"), recursive=True):
+      with open(su_file) as su:
+         for line in su:
+            parts = line.rstrip("\n").split("\t")
+            if len(parts) < 3:
+               continue
+            function = normalize(parts[0].split(":", 3)[-1])
+            frames[function] = max(frames.get(function, 0), int(parts[1]))
+   return frames
+
+
+def read_call_graph(elf):
+   calls = defaultdict(set)
+   indirect = set()
+   current = None
+   label = re.compile(r"^[0-9a-f]+ <(.+)>:$")
+   call = re.compile(r"\s(?:r?call|r?jmp)\s.*<([^+>]+)(?:\+0x[0-9a-f]+)?>")
+   for line in run_tool(tool_path("avr-objdump"), "-d", "-C", elf).splitlines():
+      match = label.match(line)
+      if match:
+         current = normalize(match.group(1))
+         continue
+      if current is None:
+         continue
+      match = call.search(line)
+      if match:
+         target = normalize(match.group(1))
+         if target != current:
+            calls[current].add(target)
+      elif re.search(r"\se?icall\b", line):
+         indirect.add(current)
+   return calls, indirect
+
+
+def worst_chain(function, calls, frames, unknown, memo, visiting=None):
+   visiting = set() if visiting is None else visiting
+   if function in memo:
+      return memo[function]
+   if function in visiting:
+      return 0, [function + " (recursion)"]
+
+   visiting.add(function)
+   frame = frames.get(function)
+   if frame is None:
+      unknown.add(function)
+      frame = 0
+   deepest, deepest_chain = 0, []
+   for callee in calls.get(function, ()):
+      depth, chain = worst_chain(callee, calls, frames, unknown, memo, visiting)
+      if depth > deepest:
+         deepest, deepest_chain = depth, chain
+   visiting.discard(function)
+
+   memo[function] = (frame + RETURN_ADDRESS_SIZE + deepest, [function] + deepest_chain)
+   return memo[function]
+
+
+def memory_report(target, source, env):
+   elf = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+   build_dir = env.subst("$BUILD_DIR")
+   min_headroom = int(env.GetProjectOption("custom_memory_min_headroom", "1024"))
+
+   sections, owners = read_static_usage(elf)
+   static_ram = sum(sections.values())
+   print("Static SRAM: %d bytes (%s)" % (static_ram, ", ".join("%s %d" % item for item in sorted(sections.items()))))
+   print("Largest owners:")
+   for owner, size in sorted(owners.items(), key=lambda item: -item[1])[:20]:
+      print("  %6d  %s" % (size, owner))
+
+   frames = read_stack_usage(build_dir)
+   calls, indirect = read_call_graph(elf)
+   unknown = set()
+   memo = {}
+
+   main_depth, main_chain = worst_chain("main", calls, frames, unknown, memo)
+   print("Worst stack depth main: %d bytes" % main_depth)
+   print("  " + " > ".join(main_chain))
+
+   isr_depth = 0
+   for isr in sorted(function for function in calls if function.startswith("__vector_")):
+      depth, chain = worst_chain(isr, calls, frames, unknown, memo)
+      depth += ISR_CONTEXT_SIZE
+      print("Worst stack depth %s: %d bytes" % (isr, depth))
+      print("  " + " > ".join(chain))
+      isr_depth = max(isr_depth, depth)
+
+   if indirect:
+      print("Not followed (calls through function pointers): " + ", ".join(sorted(indirect)))
+   if unknown:
+      print("No stack usage data for: " + ", ".join(sorted(unknown)[:20]) + (" ..." if len(unknown) > 20 else ""))
+
+   # ISRs don't nest, so at most one of them adds to the deepest main chain
+   worst_stack = main_depth + isr_depth
+   headroom = SRAM_SIZE - static_ram - worst_stack
+   print("SRAM %d - static %d - worst stack %d = headroom %d bytes (minimum %d)" % (SRAM_SIZE, static_ram, worst_stack, headroom, min_headroom))
+   if headroom < min_headroom:
+      print("Memory headroom below minimum!")
+      env.Exit(1)
+
+
+env.Append(CCFLAGS=["-fstack-usage"])
+env.AddCustomTarget(
+   name="memreport",
+   dependencies="$BUILD_DIR/${PROGNAME}.elf",
+   actions=memory_report,
+   title="Memory report",
+   description="Static SRAM usage, worst case stack depth and headroom check")
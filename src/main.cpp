@@ -7,6 +7,19 @@
 #include <RaceHandler.h>
 #include <LightsController.h>
 #include <LCDController.h>
+#include <RaceJournal.h>
+#include <Telemetry.h>
+#include <RerunCycler.h>
+#include <SerialCommands.h>
+#include <Button.h>
+#include <MemoryMonitor.h>
+#include <ClockCalibration.h>
+#include <SensorCalibration.h>
+#include <SensorCapture.h>
+#include <BeamRecorder.h>
+#include <SpeedEstimator.h>
+#include <RaceProjection.h>
+#include <RaceStatistics.h>
 
 LiquidCrystal_I2C lcd(0x27,20,4);
 
@@ -18,31 +31,75 @@ LiquidCrystal_I2C lcd(0x27,20,4);
 #define LIGHT_PIN_3 12
 #define LIGHT_PIN_4 5
 
-#define BUTTON_PIN 7
-
-unsigned long lastButtonPressTime;
-
-unsigned long msButtonDelay = 300;
+//Needs an external interrupt, pin 7 can't be used since it has no pin change interrupt
+#define BUTTON_PIN 19
 
 char * TimeToString(unsigned long givenMsTime);
-void CheckButtonTrigger();
+void HandleButton();
 void StartStopRace();
-void ResetRace();
-
-
-uint8_t CurrentDogIndex;
-uint8_t CurrentRaceState;
+bool StartRace();
+bool StopRace();
+bool ResetRace();
+void SendRaceData(const RaceData &Data);
+bool CommandStart(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandStop(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandReset(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandFault(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandRace(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandJournal(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandBrightness(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandMemory(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandCalibration(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandOffset(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandBeam(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandSpeed(uint8_t ArgumentCount, char *Arguments[]);
+bool CommandStats(uint8_t ArgumentCount, char *Arguments[]);
+void AddStatisticsFields(const RaceStatisticsClass::Series &Statistic);
+void SendSensorOffsets();
+
+void UpdateDogFields(uint8_t DogIndex);
+void UpdateRunningDog(uint8_t DogIndex);
+#ifdef BOX_SENSOR_PIN
+void UpdateBoxSplits(uint8_t DogIndex, uint8_t RunNumber);
+#endif
+void HandleRaceEventLCD(const RaceHandlerClass::RaceEvent &Event);
+void HandleRaceEventTelemetry(const RaceHandlerClass::RaceEvent &Event);
+void HandleRaceEventLights(const RaceHandlerClass::RaceEvent &Event);
+void UpdateRerunLight();
+void HandleRaceEventProjection(const RaceHandlerClass::RaceEvent &Event);
+void StartProjection();
+void UpdateProjectionFields(unsigned long RaceTime);
+void FormatSignedSeconds(char *Text, size_t Size, long TimeMillis);
+
+//LCD fields of each dog, indexed by dog index
+const LCDControllerClass::LCDFields DogTimeFields[] = {LCDControllerClass::D1Time, LCDControllerClass::D2Time, LCDControllerClass::D3Time, LCDControllerClass::D4Time};
+const LCDControllerClass::LCDFields DogCrossTimeFields[] = {LCDControllerClass::D1CrossTime, LCDControllerClass::D2CrossTime, LCDControllerClass::D3CrossTime, LCDControllerClass::D4CrossTime};
+const LCDControllerClass::LCDFields DogCrossClassFields[] = {LCDControllerClass::D1CrossClass, LCDControllerClass::D2CrossClass, LCDControllerClass::D3CrossClass, LCDControllerClass::D4CrossClass};
+const LCDControllerClass::LCDFields DogRerunInfoFields[] = {LCDControllerClass::D1RerunInfo, LCDControllerClass::D2RerunInfo, LCDControllerClass::D3RerunInfo, LCDControllerClass::D4RerunInfo};
 
 char DogTime[8];
-char DogCrossingTime[8];
 char ElapsedRaceTime[8];
 char TotalCrossingTime[8];
 
-void Sensor1Wrapper();
-void Sensor2Wrapper();
+void ButtonWrapper();
 
 void setup() {
-  Serial.begin(9600);
+  Serial.begin(115200);
+  Telemetry.Init(&Serial);
+  SerialCommands.Init(&Serial);
+  SerialCommands.AddCommand(F("START"), CommandStart);
+  SerialCommands.AddCommand(F("STOP"), CommandStop);
+  SerialCommands.AddCommand(F("RESET"), CommandReset);
+  SerialCommands.AddCommand(F("FAULT"), CommandFault);
+  SerialCommands.AddCommand(F("RACE"), CommandRace);
+  SerialCommands.AddCommand(F("JOURNAL"), CommandJournal);
+  SerialCommands.AddCommand(F("BRIGHTNESS"), CommandBrightness);
+  SerialCommands.AddCommand(F("MEM"), CommandMemory);
+  SerialCommands.AddCommand(F("CAL"), CommandCalibration);
+  SerialCommands.AddCommand(F("OFFSET"), CommandOffset);
+  SerialCommands.AddCommand(F("BEAM"), CommandBeam);
+  SerialCommands.AddCommand(F("SPEED"), CommandSpeed);
+  SerialCommands.AddCommand(F("STATS"), CommandStats);
 
   pinMode(LIGHT_PIN_1, OUTPUT);
   pinMode(LIGHT_PIN_2, OUTPUT);
@@ -54,8 +111,20 @@ void setup() {
 
   LCDController.init(&lcd);
 
-  attachInterrupt(digitalPinToInterrupt(SENSOR_1_PIN), Sensor1Wrapper, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(SENSOR_2_PIN), Sensor2Wrapper, CHANGE);
+  ClockCalibration.Init();
+  RaceHandler.init(SENSOR_1_PIN, SENSOR_2_PIN);
+  long SensorOffsets[2][2];
+  SensorCalibration.Load(SensorOffsets);
+  RaceHandler.SetSensorOffsets(SensorOffsets);
+  RaceHandler.Subscribe(HandleRaceEventLCD);
+  RaceHandler.Subscribe(HandleRaceEventTelemetry);
+  RaceHandler.Subscribe(HandleRaceEventLights);
+  RaceHandler.Subscribe(HandleRaceEventProjection);
+  //With BOX_SENSOR_PIN the box sensor is captured as well
+  SensorCapture.Init(SENSOR_1_PIN, SENSOR_2_PIN);
+
+  Button.Init(BUTTON_PIN);
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), ButtonWrapper, CHANGE);
 
   LightsController.Init(LIGHT_PIN_1, LIGHT_PIN_2, LIGHT_PIN_3, LIGHT_PIN_4);
 }
@@ -69,108 +138,806 @@ void loop() {
   //Handle Race main processing
   RaceHandler.Main();
 
+  //Compress beam captures around crossings
+  BeamRecorder.Main();
+
+  //Send the journal export a few records at a time
+  RaceJournal.Main();
+
   //Handle LCD processing
   LCDController.Main();
 
   /* 
-   *  Checking button trigger action and determining state
+   *  Handle button presses
   */
-  CheckButtonTrigger();
+  HandleButton();
+
+  //Handle commands from the judge's table
+  SerialCommands.Main();
+}
+
+/// <summary>
+///   Puts the times, crossing and rerun info of one dog on the LCD.
+/// </summary>
+void UpdateDogFields(uint8_t DogIndex) {
+   uint8_t RunNumber = RerunCycler.GetShownRun(DogIndex);
+   dtostrf(RaceHandler.GetDogTime(DogIndex, RunNumber), 7, 3, DogTime);
+   LCDController.UpdateField(DogTimeFields[DogIndex], DogTime);
+   LCDController.UpdateField(DogCrossTimeFields[DogIndex], RaceHandler.GetCrossingTime(DogIndex, RunNumber));
+   LCDController.UpdateField(DogCrossClassFields[DogIndex], String(RaceHandler.GetCrossingClassCode(RaceHandler.GetCrossingClass(DogIndex, RunNumber))));
+   LCDController.UpdateField(DogRerunInfoFields[DogIndex], RerunCycler.GetRerunInfo(RaceHandler.GetRaceData(), DogIndex));
+}
+
+/// <summary>
+///   Puts the running dog above the big team time.
+/// </summary>
+void UpdateRunningDog(uint8_t DogIndex) {
+   String RunningDog = F("Dog ");
+   RunningDog += (DogIndex + 1);
+   LCDController.UpdateField(LCDController.BigRunningDog, RunningDog);
+}
+
+#ifdef BOX_SENSOR_PIN
+/// <summary>
+///   Shows the outrun, turn and return time of a run in seconds, e.g. "2 1.52 .31 1.70" for dog 2.
+///   The field is cleared when the box sensor saw no hit in that run.
+/// </summary>
+void UpdateBoxSplits(uint8_t DogIndex, uint8_t RunNumber) {
+   const DogTimeData &Timing = RaceHandler.GetRaceData().DogData[DogIndex].Timing[RunNumber];
+   if (Timing.OutrunTime == 0 || Timing.Time <= (unsigned long)Timing.OutrunTime + Timing.TurnTime) {
+      LCDController.UpdateField(LCDController.BoxDirection, "");
+      return;
+   }
 
-  //Update LCD Display fields
-  //Update team time to display
-  dtostrf(RaceHandler.GetRaceTime(), 7, 3, ElapsedRaceTime);
-  LCDController.UpdateField(LCDController.TeamTime, ElapsedRaceTime);
+   //Hundredths of a second, capped to what fits in the field
+   unsigned int Outrun = min((unsigned int)(Timing.OutrunTime / 10), 999U);
+   unsigned int Turn = min((unsigned int)(Timing.TurnTime / 10), 99U);
+   unsigned int Return = min((Timing.Time - Timing.OutrunTime - Timing.TurnTime) / 10, 999UL);
+   char Splits[16];
+   snprintf_P(Splits, sizeof(Splits), PSTR("%u %u.%02u .%02u %u.%02u"), DogIndex + 1, Outrun / 100, Outrun % 100, Turn, Return / 100, Return % 100);
+   LCDController.UpdateField(LCDController.BoxDirection, Splits);
+}
+#endif
 
-  //Update total crossing time
-   dtostrf(RaceHandler.GetTotalCrossingTime(), 7, 3, TotalCrossingTime);
-   LCDController.UpdateField(LCDController.TotalCrossTime, TotalCrossingTime);
+/// <summary>
+///   Race event subscriber which keeps the projection of the team time up to date.
+/// </summary>
+void HandleRaceEventProjection(const RaceHandlerClass::RaceEvent &Event) {
+   switch (Event.Type) {
+   case RaceHandler.STATE_CHANGED:
+      if (Event.Value == RaceHandler.STARTING) {
+         StartProjection();
+      }
+      break;
+
+   case RaceHandler.DOG_CHANGED:
+      RaceProjection.DogStarted(Event.DogIndex, Event.Value);
+      break;
+
+   case RaceHandler.FAULT_CHANGED:
+      RaceProjection.FaultChanged(Event.DogIndex, Event.Value);
+      break;
+
+   default:
+      break;
+   }
+}
 
-   //Update race status to display
-   LCDController.UpdateField(LCDController.RaceState, RaceHandler.GetRaceStateString());
+/// <summary>
+///   Starts the projection of the team time of the heat which is starting, based on the statistics
+///   of the earlier heats of the session (STATS). Clearing the statistics also clears what the
+///   projection knows about the dogs.
+/// </summary>
+void StartProjection() {
+   unsigned long ExpectedTimes[RaceRules::DogsPerTeam];
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      ExpectedTimes[DogIndex] = RaceStatistics.GetExpectedRunTime(DogIndex);
+   }
+   RaceProjection.Start(ExpectedTimes, RaceStatistics.GetBestHeatTime());
+
+   LCDController.UpdateField(LCDController.BigDogPace, "");
+   LCDController.UpdateField(LCDController.BigProjectedTime, "");
+   LCDController.UpdateField(LCDController.BigBestDelta, "");
+}
+
+/// <summary>
+///   Shows the projected team time, the difference with the best heat and the pace of the last dog
+///   back below the big team time.
+/// </summary>
+///
+/// <param name="RaceTime">   The race time in milliseconds. </param>
+void UpdateProjectionFields(unsigned long RaceTime) {
+   char Text[12];
+   unsigned long ProjectedTime;
+   if (RaceProjection.GetProjectedTime(RaceTime, ProjectedTime)) {
+      ProjectedTime = min(ProjectedTime, 999999UL);
+      snprintf_P(Text, sizeof(Text), PSTR("Fin %3lu.%02lu"), ProjectedTime / 1000, (ProjectedTime % 1000) / 10);
+      LCDController.UpdateField(LCDController.BigProjectedTime, Text);
+   }
+
+   long Delta;
+   if (RaceProjection.GetBestDelta(RaceTime, Delta)) {
+      strcpy_P(Text, PSTR("Best "));
+      FormatSignedSeconds(Text + 5, sizeof(Text) - 5, Delta);
+      LCDController.UpdateField(LCDController.BigBestDelta, Text);
+   }
+
+   uint8_t DogIndex;
+   if (RaceProjection.GetLastPace(DogIndex, Delta)) {
+      snprintf_P(Text, sizeof(Text), PSTR("D%u "), DogIndex + 1);
+      FormatSignedSeconds(Text + 3, sizeof(Text) - 3, Delta);
+      LCDController.UpdateField(LCDController.BigDogPace, Text);
+   }
+}
+
+/// <summary>
+///   Formats a signed time as seconds with two decimals and a sign, e.g. "+0.12" or "-1.05".
+/// </summary>
+void FormatSignedSeconds(char *Text, size_t Size, long TimeMillis) {
+   unsigned long Hundredths = min((unsigned long)labs(TimeMillis) / 10, 9999UL);
+   snprintf_P(Text, Size, PSTR("%c%lu.%02lu"), (TimeMillis < 0) ? '-' : '+', Hundredths / 100, Hundredths % 100);
+}
+
+/// <summary>
+///   Race event subscriber which keeps the LCD up to date. Only the fields affected by an event are
+///   refreshed, the running times are refreshed on every tick.
+/// </summary>
+void HandleRaceEventLCD(const RaceHandlerClass::RaceEvent &Event) {
+   switch (Event.Type) {
+   case RaceHandler.TICK: {
+      dtostrf(RaceHandler.GetRaceTime(), 7, 3, ElapsedRaceTime);
+      LCDController.UpdateField(LCDController.TeamTime, ElapsedRaceTime);
+      LCDController.UpdateBigTime(Event.Value);
+      if (RaceHandler.RaceState == RaceHandler.RACING) {
+         UpdateProjectionFields(Event.Value);
+      }
+
+      //Dogs with reruns cycle through their runs, refresh the ones which show another run now
+      uint8_t CycledDogs = RerunCycler.Update(RaceHandler.GetRaceData(), millis());
+      if (RaceHandler.RaceState != RaceHandler.STOP) {
+         CycledDogs |= (1 << Event.DogIndex);
+      }
+      for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+         if (CycledDogs & (1 << DogIndex)) {
+            UpdateDogFields(DogIndex);
+         }
+      }
+      break;
+   }
+
+   case RaceHandler.DOG_FINISHED:
+#ifdef BOX_SENSOR_PIN
+      UpdateBoxSplits(Event.DogIndex, Event.RunNumber);
+#endif
+      UpdateDogFields(Event.DogIndex);
+      break;
+
+   case RaceHandler.FAULT_CHANGED:
+      UpdateDogFields(Event.DogIndex);
+      break;
+
+   case RaceHandler.CROSSING_MEASURED:
+      UpdateDogFields(Event.DogIndex);
+      dtostrf(RaceHandler.GetTotalCrossingTime(), 7, 3, TotalCrossingTime);
+      LCDController.UpdateField(LCDController.TotalCrossTime, TotalCrossingTime);
+      break;
+
+   case RaceHandler.DOG_CHANGED:
+      UpdateRunningDog(Event.DogIndex);
+      break;
+
+   case RaceHandler.STATE_CHANGED:
+      LCDController.UpdateField(LCDController.RaceState, RaceHandler.GetRaceStateString());
+      UpdateRunningDog(Event.DogIndex);
+      //Show the team time in big digits while racing, and all details once the race is stopped
+      if (Event.Value == RaceHandler.RACING) {
+         LCDController.SetDisplayMode(LCDController.BIG_TIME);
+      } else if (Event.Value == RaceHandler.STOP) {
+         LCDController.SetDisplayMode(LCDController.DETAILED);
+      }
+#ifdef BOX_SENSOR_PIN
+      //The splits of the last dog of the previous race stay until the next race starts
+      if (Event.Value == RaceHandler.STARTING) {
+         LCDController.UpdateField(LCDController.BoxDirection, "");
+      }
+#endif
 
-   //Handle individual dog info
-   dtostrf(RaceHandler.GetDogTime(0), 7, 3, DogTime);
-   LCDController.UpdateField(LCDController.D1Time, DogTime);
-   LCDController.UpdateField(LCDController.D1CrossTime, RaceHandler.GetCrossingTime(0));
-   LCDController.UpdateField(LCDController.D1RerunInfo, RaceHandler.GetRerunInfo(0));
+      //State changes also happen on reset, so refresh everything
+      for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+         UpdateDogFields(DogIndex);
+      }
+      dtostrf(RaceHandler.GetTotalCrossingTime(), 7, 3, TotalCrossingTime);
+      LCDController.UpdateField(LCDController.TotalCrossTime, TotalCrossingTime);
+      break;
 
-   dtostrf(RaceHandler.GetDogTime(1), 7, 3, DogTime);
-   LCDController.UpdateField(LCDController.D2Time, DogTime);
-   LCDController.UpdateField(LCDController.D2CrossTime, RaceHandler.GetCrossingTime(1));
-   LCDController.UpdateField(LCDController.D2RerunInfo, RaceHandler.GetRerunInfo(1));
+   default:
+      //False starts are shown by the lights and end up in the crossing of the first dog
+      break;
+   }
+}
 
-   dtostrf(RaceHandler.GetDogTime(2), 7, 3, DogTime);
-   LCDController.UpdateField(LCDController.D3Time, DogTime);
-   LCDController.UpdateField(LCDController.D3CrossTime, RaceHandler.GetCrossingTime(2));
-   LCDController.UpdateField(LCDController.D3RerunInfo, RaceHandler.GetRerunInfo(2));
+/// <summary>
+///   Race event subscriber which drives the lights: a false start flashes the RED light, a fault
+///   flashes the light of the dog, the light of the dog which reruns first keeps blinking until its
+///   rerun starts, and the end of a race flashes all lights.
+/// </summary>
+void HandleRaceEventLights(const RaceHandlerClass::RaceEvent &Event) {
+   switch (Event.Type) {
+   case RaceHandler.FALSE_START:
+      LightsController.ShowFalseStart();
+      break;
+
+   case RaceHandler.FAULT_CHANGED:
+      if (Event.Value) {
+         LightsController.RunProgram(LightsController.FAULT_FLASH, Event.DogIndex);
+      }
+      UpdateRerunLight();
+      break;
 
-   dtostrf(RaceHandler.GetDogTime(3), 7, 3, DogTime);
-   LCDController.UpdateField(LCDController.D4Time, DogTime);
-   LCDController.UpdateField(LCDController.D4CrossTime, RaceHandler.GetCrossingTime(3));
-   LCDController.UpdateField(LCDController.D4RerunInfo, RaceHandler.GetRerunInfo(3));
+   case RaceHandler.DOG_CHANGED:
+      UpdateRerunLight();
+      break;
 
-  if (CurrentRaceState != RaceHandler.RaceState) {
-    // TODO: do logging
-      if (RaceHandler.RaceState == RaceHandler.STOP) {
-         //Race is finished, put final data on screen
-        //  dtostrf(RaceHandler.GetDogTime(RaceHandler.CurrentDogIndex, -2), 7, 3, DogTime);
-        //  ESP_LOGI(__FILE__, "D%i: %s|CR: %s", RaceHandler.CurrentDogIndex, DogTime, RaceHandler.GetCrossingTime(RaceHandler.CurrentDogIndex, -2).c_str());
-        //  ESP_LOGI(__FILE__, "RT:%s", ElapsedRaceTime);
+   case RaceHandler.STATE_CHANGED:
+      if (Event.Value == RaceHandler.STOP && RaceHandler.GetRaceTime() != 0) {
+         LightsController.ClearBackgroundProgram();
+         LightsController.RunProgram(LightsController.RACE_COMPLETE);
       }
-      // ESP_LOGI(__FILE__, "RS: %i", RaceHandler.RaceState);
+      break;
+
+   default:
+      break;
    }
+}
 
-   if (RaceHandler.CurrentDogIndex != CurrentDogIndex) {
-    //  TODO: do logging
-      // dtostrf(RaceHandler.GetDogTime(RaceHandler.iPreviousDog, -2), 7, 3, DogTime);
-      // ESP_LOGI(__FILE__, "D%i: %s|CR: %s", RaceHandler.iPreviousDog, DogTime, RaceHandler.GetCrossingTime(RaceHandler.iPreviousDog, -2).c_str());
-      // ESP_LOGI(__FILE__, "D: %i", RaceHandler.CurrentDogIndex);
-      // ESP_LOGI(__FILE__, "RT:%s", ElapsedRaceTime);
+/// <summary>
+///   Blinks the light of the dog at the front of the rerun queue, or stops blinking when no dog
+///   waits for a rerun.
+/// </summary>
+void UpdateRerunLight() {
+   uint8_t DogIndex;
+   if (RaceHandler.RaceState == RaceHandler.RACING && RaceHandler.GetNextRerunDog(DogIndex)) {
+      LightsController.SetBackgroundProgram(LightsController.RERUN_PENDING, DogIndex);
+   } else {
+      LightsController.ClearBackgroundProgram();
+   }
+}
+
+/// <summary>
+///   Race event subscriber which sends every event (except ticks) over the serial port, and the
+///   race reports once a race is stopped.
+/// </summary>
+void HandleRaceEventTelemetry(const RaceHandlerClass::RaceEvent &Event) {
+   if (Event.Type == RaceHandler.TICK) {
+      return;
    }
 
-   //Cleanup variables used for checking if something changed
-   CurrentDogIndex = RaceHandler.CurrentDogIndex;
-   CurrentRaceState = RaceHandler.RaceState;
+   Telemetry.BeginFrame(F("EVT"));
+   Telemetry.AddField(Event.Type);
+   Telemetry.AddField(Event.DogIndex);
+   Telemetry.AddField(Event.RunNumber);
+   Telemetry.AddField(Event.Value);
+   Telemetry.EndFrame();
+
+   //Race is finished, send the journal (over the next loops) and reports of this heat. A reset also
+   //raises a STOP state change, but then the race time is zero and there is nothing to report.
+   if (Event.Type == RaceHandler.STATE_CHANGED && Event.Value == RaceHandler.STOP
+      && RaceHandler.GetRaceTime() != 0) {
+      RaceJournal.Export(RaceHandler.GetRaceData().Id);
+      RaceHandler.SendCrossingReport();
+      Telemetry.BeginFrame(F("QUE"));
+      Telemetry.AddField(RaceHandler.GetRaceData().Id);
+      Telemetry.AddField(RaceHandler.GetQueueHighWaterMark());
+      Telemetry.AddField(RaceHandler.GetLargestQueueBatch());
+      Telemetry.AddField(TRIGGER_QUEUE_LENGTH);
+      Telemetry.AddField(RaceHandler.GetQueueOverflows());
+      Telemetry.EndFrame();
+      MemoryMonitor.SendReport();
+   }
 }
 
-void CheckButtonTrigger() {
-  int buttonState = digitalRead(BUTTON_PIN);
+/// <summary>
+///   Handles button presses: a short press starts or stops the race, a long press resets it and a
+///   double press toggles the fault of the running dog. Every press is reported over telemetry as
+///   a BTN frame (event, latency in us, highest latency in us).
+/// </summary>
+void HandleButton() {
+   ButtonClass::ButtonEvents Event = Button.Main();
+   switch (Event) {
+   case Button.SHORT_PRESS:
+      StartStopRace();
+      break;
+
+   case Button.LONG_PRESS:
+      ResetRace();
+      break;
+
+   case Button.DOUBLE_PRESS:
+      RaceHandler.SetDogFault(RaceHandler.CurrentDogIndex);
+      break;
+
+   default:
+      return;
+   }
 
-  if (buttonState == HIGH && (millis() - lastButtonPressTime >= msButtonDelay)) {
-    StartStopRace();
-  };
+   Telemetry.BeginFrame(F("BTN"));
+   Telemetry.AddField(Event);
+   Telemetry.AddField(Button.GetLastLatency());
+   Telemetry.AddField(Button.GetMaxLatency());
+   Telemetry.EndFrame();
 }
 
 /// <summary>
 ///   Starts (if stopped) or stops (if started) a race. Start is only allowed if race is stopped and reset.
 /// </summary>
 void StartStopRace() {
-   lastButtonPressTime = millis();
-  //If race is stopped and timers are zero
-  if (RaceHandler.RaceState == RaceHandler.STOP && RaceHandler.GetRaceTime() == 0) {
-      //Then start the race
-      // ESP_LOGD(__FILE__, "%lu: START!", millis());
-      LightsController.InitiateStartSequence();
-      RaceHandler.StartRace();
-   } else if (RaceHandler.RaceState == RaceHandler.STOP && RaceHandler.GetRaceTime() != 0) {
-     ResetRace();
-   } else {
-      RaceHandler.StopRace();
-      LightsController.DeleteSchedules();
+   if (!StartRace()) {
+      StopRace();
    }
 }
 
+/// <summary>
+///   Starts the light sequence and the race, this is only allowed if race is stopped and reset.
+/// </summary>
+///
+/// <returns>
+///   true if the race was started.
+/// </returns>
+bool StartRace() {
+   //If race is stopped and timers are zero
+   if (RaceHandler.RaceState != RaceHandler.STOP || RaceHandler.GetRaceTime() != 0 || RaceHandler.IsCalibratingSensors()) {
+      return false;
+   }
+
+   // ESP_LOGD(__FILE__, "%lu: START!", millis());
+   LightsController.InitiateStartSequence();
+   RaceHandler.StartRace();
+   return true;
+}
+
+/// <summary>
+///   Stops a starting or running race.
+/// </summary>
+///
+/// <returns>
+///   true if the race was stopped.
+/// </returns>
+bool StopRace() {
+   if (RaceHandler.RaceState == RaceHandler.STOP) {
+      return false;
+   }
+
+   RaceHandler.StopRace();
+   LightsController.StopPrograms();
+   return true;
+}
+
 /// <summary>
 ///   Reset race so new one can be started, reset is only allowed when race is stopped
 /// </summary>
-void ResetRace() {
+///
+/// <returns>
+///   true if the race was reset.
+/// </returns>
+bool ResetRace() {
    if (RaceHandler.RaceState != RaceHandler.STOP) {
-      return;
+      return false;
    }
    
    LightsController.ResetLights();
+   //The journal of the finished heat is written again for the records added since it stopped,
+   //only those bytes change. RaceJournal.Main() writes it, the next heat finishes it if needed.
+   RaceJournal.Flush();
+   RerunCycler.Reset();
    RaceHandler.ResetRace();
+   return true;
+}
+
+/// <summary>
+///   Sends race data over telemetry: one RAC frame (race, state, elapsed time in ms, total crossing
+///   time in ms, false start in us) followed by a RDG frame (race, dog, run, time in ms, crossing time in us, class,
+///   fault, speed going in and coming back in 0.1 m/s, with a box sensor also outrun and turn time in ms) for
+///   every run of every dog.
+/// </summary>
+void SendRaceData(const RaceData &Data) {
+   Telemetry.BeginFrame(F("RAC"));
+   Telemetry.AddField(Data.Id);
+   Telemetry.AddField(Data.RaceState);
+   Telemetry.AddField(Data.ElapsedTime);
+   Telemetry.AddField(Data.TotalCrossingTime);
+   Telemetry.AddField(Data.FalseStartTime);
+   Telemetry.EndFrame();
+
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      const stDogData &DogData = Data.DogData[DogIndex];
+      for (uint8_t RunNumber = 0; RunNumber <= DogData.LastRunNumber; RunNumber++) {
+         Telemetry.BeginFrame(F("RDG"));
+         Telemetry.AddField(Data.Id);
+         Telemetry.AddField(DogIndex);
+         Telemetry.AddField(RunNumber);
+         Telemetry.AddField(DogData.Timing[RunNumber].Time);
+         Telemetry.AddField(DogData.Timing[RunNumber].CrossingTime);
+         Telemetry.AddField(RaceHandler.GetCrossingClassCode((RaceHandlerClass::CrossingClasses)DogData.Timing[RunNumber].CrossingClass));
+         Telemetry.AddField(DogData.Fault);
+         Telemetry.AddField(DogData.Timing[RunNumber].EnterSpeed);
+         Telemetry.AddField(DogData.Timing[RunNumber].ReturnSpeed);
+#ifdef BOX_SENSOR_PIN
+         Telemetry.AddField(DogData.Timing[RunNumber].OutrunTime);
+         Telemetry.AddField(DogData.Timing[RunNumber].TurnTime);
+#endif
+         Telemetry.EndFrame();
+      }
+   }
+}
+
+/// <summary>
+///   START: starts the race.
+/// </summary>
+bool CommandStart(uint8_t ArgumentCount, char *Arguments[]) {
+   if (!StartRace()) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+   return true;
+}
+
+/// <summary>
+///   STOP: stops the race.
+/// </summary>
+bool CommandStop(uint8_t ArgumentCount, char *Arguments[]) {
+   if (!StopRace()) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+   return true;
+}
+
+/// <summary>
+///   RESET: resets a stopped race.
+/// </summary>
+bool CommandReset(uint8_t ArgumentCount, char *Arguments[]) {
+   if (!ResetRace()) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+   return true;
+}
+
+/// <summary>
+///   FAULT dog [ON|OFF|TOGGLE]: sets, clears or toggles (default) the fault of a dog. Dogs are
+///   numbered 1 to DogsPerTeam, as on the display.
+/// </summary>
+bool CommandFault(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount < 1 || ArgumentCount > 2) {
+      return false;
+   }
+
+   int DogNumber = atoi(Arguments[0]);
+   if (DogNumber < 1 || DogNumber > RaceRules::DogsPerTeam) {
+      return false;
+   }
+
+   RaceHandlerClass::DogFaults State = RaceHandler.TOGGLE;
+   if (ArgumentCount == 2) {
+      if (strcasecmp_P(Arguments[1], PSTR("ON")) == 0) {
+         State = RaceHandler.ON;
+      } else if (strcasecmp_P(Arguments[1], PSTR("OFF")) == 0) {
+         State = RaceHandler.OFF;
+      } else if (strcasecmp_P(Arguments[1], PSTR("TOGGLE")) != 0) {
+         return false;
+      }
+   }
+
+   if (RaceHandler.RaceState == RaceHandler.STOP) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+
+   RaceHandler.SetDogFault(DogNumber - 1, State);
+   return true;
+}
+
+/// <summary>
+///   RACE [id]: sends the data of the given race, or of the current race if no ID is given. This
+///   is up to a kilobyte of frames, which would hold up the main loop, so it isn't allowed while a
+///   race is starting or running.
+/// </summary>
+bool CommandRace(uint8_t ArgumentCount, char *Arguments[]) {
+   if (RaceHandler.RaceState != RaceHandler.STOP) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+
+   if (ArgumentCount == 0) {
+      SendRaceData(RaceHandler.GetRaceData());
+      return true;
+   }
+
+   if (ArgumentCount > 1) {
+      return false;
+   }
+
+   RaceData Data;
+   if (!RaceHandler.GetRaceData(atoi(Arguments[0]), Data)) {
+      SerialCommands.SetError(F("NODATA"));
+      return false;
+   }
+
+   SendRaceData(Data);
+   return true;
+}
+
+/// <summary>
+///   JOURNAL [id]: exports the journal of the given race, or of the current race if no ID is given.
+///   The records follow over the next loops. The journal of a race which is starting or running is
+///   still changing, so exports aren't allowed then.
+/// </summary>
+bool CommandJournal(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount > 1) {
+      return false;
+   }
+
+   if (RaceHandler.RaceState != RaceHandler.STOP) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+
+   unsigned int RaceId = (ArgumentCount == 0) ? RaceHandler.GetRaceData().Id : atoi(Arguments[0]);
+   if (!RaceJournal.Export(RaceId)) {
+      SerialCommands.SetError(F("NODATA"));
+      return false;
+   }
+   return true;
+}
+
+/// <summary>
+///   BRIGHTNESS level [light]: sets the brightness (0-255) of all lights, or of one light (1-4).
+/// </summary>
+bool CommandBrightness(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount < 1 || ArgumentCount > 2) {
+      return false;
+   }
+
+   int Brightness = atoi(Arguments[0]);
+   if (Brightness < 0 || Brightness > 255) {
+      return false;
+   }
+
+   if (ArgumentCount == 1) {
+      LightsController.SetBrightness(Brightness);
+      return true;
+   }
+
+   int LightNumber = atoi(Arguments[1]);
+   if (LightNumber < 1 || LightNumber > NUM_LIGHTS) {
+      return false;
+   }
+
+   LightsController.SetBrightness(LightNumber - 1, Brightness);
+   return true;
+}
+
+/// <summary>
+///   MEM: sends the memory usage report.
+/// </summary>
+bool CommandMemory(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount > 0) {
+      return false;
+   }
+
+   MemoryMonitor.SendReport();
+   return true;
+}
+
+/// <summary>
+///   CAL [SYNC|SET ppm|CLEAR]: without arguments sends the current clock correction ($CAL,ppm).
+///   SYNC sends the raw micros() value ($CAL,SYNC,us) for tools/clock_calibration.py, SET stores a
+///   new correction and CLEAR removes it. The correction can't be changed during a race.
+/// </summary>
+bool CommandCalibration(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("SYNC")) == 0) {
+      unsigned long Now = micros();
+      Telemetry.BeginFrame(F("CAL"));
+      Telemetry.AddField(F("SYNC"));
+      Telemetry.AddField(Now);
+      Telemetry.EndFrame();
+      return true;
+   }
+
+   long Ppm;
+   if (ArgumentCount == 0) {
+      Ppm = ClockCalibration.GetPpm();
+   } else if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("CLEAR")) == 0) {
+      Ppm = 0;
+   } else if (ArgumentCount == 2 && strcasecmp_P(Arguments[0], PSTR("SET")) == 0) {
+      Ppm = atol(Arguments[1]);
+   } else {
+      return false;
+   }
+
+   if (ArgumentCount > 0) {
+      if (RaceHandler.RaceState != RaceHandler.STOP) {
+         SerialCommands.SetError(F("STATE"));
+         return false;
+      }
+      if (!ClockCalibration.SetPpm(Ppm)) {
+         return false;
+      }
+   }
+
+   Telemetry.BeginFrame(F("CAL"));
+   Telemetry.AddField(ClockCalibration.GetPpm());
+   Telemetry.EndFrame();
+   return true;
+}
+
+/// <summary>
+///   OFFSET [SET sensor state us|CLEAR|CAL|DONE]: without arguments sends the receiver delays
+///   ($OFS, sensor 1 broken, sensor 1 restored, sensor 2 broken, sensor 2 restored, in us). SET
+///   changes one delay (state 1 is beam broken, 0 beam restored) and CLEAR removes all of them.
+///   CAL starts a calibration: pass one object through the gates in both directions at different
+///   speeds, then DONE reports the clean passes per direction ($OFC,in,out) and stores the
+///   estimated delays.
+/// </summary>
+bool CommandOffset(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount == 0) {
+      SendSensorOffsets();
+      return true;
+   }
+
+   long Offsets[2][2];
+   RaceHandler.GetSensorOffsets(Offsets);
+   if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("CAL")) == 0) {
+      if (!RaceHandler.StartSensorCalibration()) {
+         SerialCommands.SetError(F("STATE"));
+         return false;
+      }
+      return true;
+   } else if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("DONE")) == 0) {
+      if (!RaceHandler.IsCalibratingSensors()) {
+         SerialCommands.SetError(F("STATE"));
+         return false;
+      }
+      RaceHandler.StopSensorCalibration();
+      Telemetry.BeginFrame(F("OFC"));
+      Telemetry.AddField(SensorCalibration.GetPassCount(1));
+      Telemetry.AddField(SensorCalibration.GetPassCount(2));
+      Telemetry.EndFrame();
+      if (!SensorCalibration.Estimate(Offsets)) {
+         SerialCommands.SetError(F("NODATA"));
+         return false;
+      }
+   } else if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("CLEAR")) == 0) {
+      memset(Offsets, 0, sizeof(Offsets));
+   } else if (ArgumentCount == 4 && strcasecmp_P(Arguments[0], PSTR("SET")) == 0) {
+      int SensorNumber = atoi(Arguments[1]);
+      int SensorState = atoi(Arguments[2]);
+      long Offset = atol(Arguments[3]);
+      if (SensorNumber < 1 || SensorNumber > 2 || SensorState < 0 || SensorState > 1 || labs(Offset) > SENSOR_OFFSET_MAX) {
+         return false;
+      }
+      Offsets[SensorNumber - 1][SensorState] = Offset;
+   } else {
+      return false;
+   }
+
+   //Changing the offsets during a race would mix corrected and uncorrected edges
+   if (RaceHandler.RaceState != RaceHandler.STOP) {
+      SerialCommands.SetError(F("STATE"));
+      return false;
+   }
+
+   RaceHandler.SetSensorOffsets(Offsets);
+   SensorCalibration.Save(Offsets);
+   SendSensorOffsets();
+   return true;
+}
+
+/// <summary>
+///   Sends the receiver delays which are compensated on every sensor edge.
+/// </summary>
+void SendSensorOffsets() {
+   long Offsets[2][2];
+   RaceHandler.GetSensorOffsets(Offsets);
+   Telemetry.BeginFrame(F("OFS"));
+   Telemetry.AddField(Offsets[0][1]);
+   Telemetry.AddField(Offsets[0][0]);
+   Telemetry.AddField(Offsets[1][1]);
+   Telemetry.AddField(Offsets[1][0]);
+   Telemetry.EndFrame();
+}
+
+/// <summary>
+///   BEAM number [race]: sends a beam capture of the given race, or of the current race if no ID is
+///   given. The capture numbers are logged in the journal of the race (BEAM_CAPTURE records). See
+///   tools/beam_plot.py.
+/// </summary>
+bool CommandBeam(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount < 1 || ArgumentCount > 2) {
+      return false;
+   }
+
+   int CaptureNumber = atoi(Arguments[0]);
+   if (CaptureNumber < 0 || CaptureNumber >= BEAM_CAPTURES_PER_HEAT) {
+      return false;
+   }
+
+   unsigned int RaceId = (ArgumentCount == 2) ? atoi(Arguments[1]) : RaceHandler.GetRaceData().Id;
+   if (!BeamRecorder.Export(RaceId, CaptureNumber)) {
+      SerialCommands.SetError(F("NODATA"));
+      return false;
+   }
+   return true;
+}
+
+/// <summary>
+///   SPEED [CLEAR]: sends the average speed of every dog through the gates ($SPA, dog, average going
+///   in, passes, average coming back, passes, speeds in mm/s). CLEAR starts new averages, e.g. when
+///   another team runs.
+/// </summary>
+bool CommandSpeed(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("CLEAR")) == 0) {
+      SpeedEstimator.Clear();
+   } else if (ArgumentCount != 0) {
+      return false;
+   }
+
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      Telemetry.BeginFrame(F("SPA"));
+      Telemetry.AddField(DogIndex);
+      Telemetry.AddField(SpeedEstimator.GetAverage(DogIndex, SpeedEstimator.GOING_IN));
+      Telemetry.AddField(SpeedEstimator.GetPassCount(DogIndex, SpeedEstimator.GOING_IN));
+      Telemetry.AddField(SpeedEstimator.GetAverage(DogIndex, SpeedEstimator.COMING_BACK));
+      Telemetry.AddField(SpeedEstimator.GetPassCount(DogIndex, SpeedEstimator.COMING_BACK));
+      Telemetry.EndFrame();
+   }
+   return true;
+}
+
+/// <summary>
+///   STATS [CLEAR]: sends the statistics of the session. A $STT frame for the heats of the team
+///   which finished without faults (heats, mean, standard deviation, best, worst in ms) and per dog
+///   a $STR frame for the run times (dog, runs, mean, standard deviation, min, max in ms) and a
+///   $STC frame for the crossings (the same in us). Every frame ends with the 8 histogram bins.
+///   CLEAR starts a new session, e.g. when another team runs.
+/// </summary>
+bool CommandStats(uint8_t ArgumentCount, char *Arguments[]) {
+   if (ArgumentCount == 1 && strcasecmp_P(Arguments[0], PSTR("CLEAR")) == 0) {
+      RaceStatistics.Clear();
+   } else if (ArgumentCount != 0) {
+      return false;
+   }
+
+   Telemetry.BeginFrame(F("STT"));
+   AddStatisticsFields(RaceStatistics.GetTeamSeries());
+   Telemetry.EndFrame();
+
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      Telemetry.BeginFrame(F("STR"));
+      Telemetry.AddField(DogIndex);
+      AddStatisticsFields(RaceStatistics.GetDogSeries(DogIndex, RaceStatistics.RUN_TIMES));
+      Telemetry.EndFrame();
+
+      Telemetry.BeginFrame(F("STC"));
+      Telemetry.AddField(DogIndex);
+      AddStatisticsFields(RaceStatistics.GetDogSeries(DogIndex, RaceStatistics.CROSSING_TIMES));
+      Telemetry.EndFrame();
+   }
+   return true;
+}
+
+/// <summary>
+///   Adds the fields of a statistics series to the telemetry frame which is being sent.
+/// </summary>
+void AddStatisticsFields(const RaceStatisticsClass::Series &Statistic) {
+   Telemetry.AddField(Statistic.Count);
+   Telemetry.AddField(RaceStatistics.GetMean(Statistic));
+   Telemetry.AddField(RaceStatistics.GetStandardDeviation(Statistic));
+   Telemetry.AddField(Statistic.Minimum);
+   Telemetry.AddField(Statistic.Maximum);
+   for (uint8_t Bin = 0; Bin < STATS_HISTOGRAM_BINS; Bin++) {
+      Telemetry.AddField(Statistic.Histogram[Bin]);
+   }
 }
 
 char * TimeToString(unsigned long givenMsTime) {
@@ -179,15 +946,11 @@ char * TimeToString(unsigned long givenMsTime) {
   int seconds = givenMsTime / 1000;
   int ms = givenMsTime % 1000;
 
-  sprintf(str, "%01ds %02dms", seconds, ms);
+  sprintf_P(str, PSTR("%01ds %02dms"), seconds, ms);
 
   return str;
 }
 
-void Sensor2Wrapper() {
-   RaceHandler.TriggerSensor2();
-}
-
-void Sensor1Wrapper() {
-   RaceHandler.TriggerSensor1();
+void ButtonWrapper() {
+   Button.HandleEdge();
 }
\ No newline at end of file
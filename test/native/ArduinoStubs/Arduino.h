@@ -0,0 +1,139 @@
+#ifndef _ARDUINO_STUBS_h
+#define _ARDUINO_STUBS_h
+
+// Host stand-in for the parts of the Arduino core the libraries use, so they can be unit tested
+// with "pio test -e native". Time and input pins are set by the tests (ArduinoStubs.h), serial
+// output is discarded.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(a, low, high) ((a) < (low) ? (low) : ((a) > (high) ? (high) : (a)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bit(b) (1UL << (b))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long Milliseconds);
+void delayMicroseconds(unsigned int Microseconds);
+void pinMode(uint8_t Pin, uint8_t Mode);
+int digitalRead(uint8_t Pin);
+void digitalWrite(uint8_t Pin, uint8_t Value);
+void analogWrite(uint8_t Pin, int Value);
+int digitalPinToInterrupt(uint8_t Pin);
+void attachInterrupt(uint8_t Interrupt, void (*Handler)(void), int Mode);
+void detachInterrupt(uint8_t Interrupt);
+void noInterrupts();
+void interrupts();
+
+char *ltoa(long Value, char *Text, int Radix);
+char *ultoa(unsigned long Value, char *Text, int Radix);
+char *itoa(int Value, char *Text, int Radix);
+char *dtostrf(double Value, signed char Width, unsigned char Precision, char *Text);
+
+class __FlashStringHelper;
+#define F(Text) (reinterpret_cast<const __FlashStringHelper *>(Text))
+
+/// <summary>
+///   Fixed size String, long enough for the transition strings and the LCD fields.
+/// </summary>
+class String {
+   public:
+      String(const char *Text = "");
+      String(const __FlashStringHelper *Text);
+      String(char Character);
+      String(int Value);
+      String(unsigned int Value);
+      String(long Value);
+      String(unsigned long Value);
+      String(double Value, unsigned char Decimals = 2);
+
+      String &operator+=(const String &Other);
+      String &operator+=(const char *Text);
+      String &operator+=(char Character);
+      friend String operator+(const String &Left, const String &Right);
+      bool operator==(const String &Other) const;
+      bool operator==(const char *Text) const;
+      bool operator!=(const String &Other) const;
+      bool operator!=(const char *Text) const;
+      char operator[](unsigned int Index) const;
+
+      unsigned int length() const;
+      const char *c_str() const;
+      String substring(unsigned int From) const;
+      String substring(unsigned int From, unsigned int To) const;
+      void toCharArray(char *Buffer, unsigned int Size) const;
+      bool reserve(unsigned int Size);
+      void replace(const char *Find, const char *Replacement);
+
+   private:
+      char _Text[128];
+};
+
+class Print {
+   public:
+      virtual size_t write(uint8_t Character) = 0;
+      size_t write(const char *Text);
+      size_t write(const uint8_t *Buffer, size_t Size);
+      size_t print(const char *Text);
+      size_t print(const String &Text);
+      size_t print(char Character);
+      size_t print(long Value, int Radix = 10);
+      size_t print(unsigned long Value, int Radix = 10);
+      size_t print(int Value, int Radix = 10);
+      size_t print(unsigned int Value, int Radix = 10);
+      size_t println(const char *Text = "");
+      size_t println(const String &Text);
+      size_t println(long Value, int Radix = 10);
+      size_t println(unsigned long Value, int Radix = 10);
+      size_t println(int Value, int Radix = 10);
+};
+
+class Stream : public Print {
+   public:
+      virtual int available() = 0;
+      virtual int read() = 0;
+      virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+   public:
+      void begin(unsigned long Baud);
+      size_t write(uint8_t Character);
+      using Print::write;
+      int available();
+      int read();
+      int peek();
+      int availableForWrite();
+      operator bool();
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,326 @@
+#include "ArduinoStubs.h"
+#include <EEPROM.h>
+
+static unsigned long CurrentMicros = 0;
+static uint8_t PinStates[70];
+static uint8_t PinOutputs[70];
+static uint8_t EepromBytes[4096];
+
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2, TCNT2;
+volatile uint8_t TCCR3A, TCCR3B, TIMSK3;
+volatile uint16_t OCR1A, OCR1B, OCR3A, OCR3B;
+volatile uint8_t SREG;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+void SetMicros(unsigned long Time) {
+   CurrentMicros = Time;
+}
+
+void SetPinState(uint8_t Pin, uint8_t State) {
+   PinStates[Pin] = State;
+}
+
+uint8_t GetPinOutput(uint8_t Pin) {
+   return PinOutputs[Pin];
+}
+
+void ClearEeprom() {
+   memset(EepromBytes, 0xFF, sizeof(EepromBytes));
+}
+
+unsigned long millis() {
+   return CurrentMicros / 1000;
+}
+
+unsigned long micros() {
+   return CurrentMicros;
+}
+
+void delay(unsigned long Milliseconds) {
+   CurrentMicros += Milliseconds * 1000;
+}
+
+void delayMicroseconds(unsigned int Microseconds) {
+   CurrentMicros += Microseconds;
+}
+
+void pinMode(uint8_t Pin, uint8_t Mode) {
+}
+
+int digitalRead(uint8_t Pin) {
+   return PinStates[Pin];
+}
+
+void digitalWrite(uint8_t Pin, uint8_t Value) {
+   PinOutputs[Pin] = Value;
+}
+
+void analogWrite(uint8_t Pin, int Value) {
+   PinOutputs[Pin] = (Value > 0) ? HIGH : LOW;
+}
+
+int digitalPinToInterrupt(uint8_t Pin) {
+   return Pin;
+}
+
+void attachInterrupt(uint8_t Interrupt, void (*Handler)(void), int Mode) {
+}
+
+void detachInterrupt(uint8_t Interrupt) {
+}
+
+void noInterrupts() {
+}
+
+void interrupts() {
+}
+
+char *ltoa(long Value, char *Text, int Radix) {
+   sprintf(Text, "%ld", Value);
+   return Text;
+}
+
+char *ultoa(unsigned long Value, char *Text, int Radix) {
+   sprintf(Text, "%lu", Value);
+   return Text;
+}
+
+char *itoa(int Value, char *Text, int Radix) {
+   sprintf(Text, "%d", Value);
+   return Text;
+}
+
+char *dtostrf(double Value, signed char Width, unsigned char Precision, char *Text) {
+   sprintf(Text, "%*.*f", Width, Precision, Value);
+   return Text;
+}
+
+String::String(const char *Text) {
+   strncpy(_Text, Text, sizeof(_Text) - 1);
+   _Text[sizeof(_Text) - 1] = '\0';
+}
+
+String::String(const __FlashStringHelper *Text) : String(reinterpret_cast<const char *>(Text)) {
+}
+
+String::String(char Character) {
+   _Text[0] = Character;
+   _Text[1] = '\0';
+}
+
+String::String(int Value) {
+   snprintf(_Text, sizeof(_Text), "%d", Value);
+}
+
+String::String(unsigned int Value) {
+   snprintf(_Text, sizeof(_Text), "%u", Value);
+}
+
+String::String(long Value) {
+   snprintf(_Text, sizeof(_Text), "%ld", Value);
+}
+
+String::String(unsigned long Value) {
+   snprintf(_Text, sizeof(_Text), "%lu", Value);
+}
+
+String::String(double Value, unsigned char Decimals) {
+   snprintf(_Text, sizeof(_Text), "%.*f", Decimals, Value);
+}
+
+String &String::operator+=(const String &Other) {
+   return *this += Other._Text;
+}
+
+String &String::operator+=(const char *Text) {
+   strncat(_Text, Text, sizeof(_Text) - 1 - strlen(_Text));
+   return *this;
+}
+
+String &String::operator+=(char Character) {
+   char Text[2] = {Character, '\0'};
+   return *this += Text;
+}
+
+String operator+(const String &Left, const String &Right) {
+   String Result(Left);
+   Result += Right;
+   return Result;
+}
+
+bool String::operator==(const String &Other) const {
+   return strcmp(_Text, Other._Text) == 0;
+}
+
+bool String::operator==(const char *Text) const {
+   return strcmp(_Text, Text) == 0;
+}
+
+bool String::operator!=(const String &Other) const {
+   return !(*this == Other);
+}
+
+bool String::operator!=(const char *Text) const {
+   return !(*this == Text);
+}
+
+char String::operator[](unsigned int Index) const {
+   return (Index < length()) ? _Text[Index] : '\0';
+}
+
+unsigned int String::length() const {
+   return strlen(_Text);
+}
+
+const char *String::c_str() const {
+   return _Text;
+}
+
+String String::substring(unsigned int From) const {
+   return substring(From, length());
+}
+
+String String::substring(unsigned int From, unsigned int To) const {
+   String Result;
+   To = min(To, length());
+   if (From < To) {
+      memcpy(Result._Text, _Text + From, To - From);
+      Result._Text[To - From] = '\0';
+   }
+   return Result;
+}
+
+void String::toCharArray(char *Buffer, unsigned int Size) const {
+   strncpy(Buffer, _Text, Size);
+   Buffer[Size - 1] = '\0';
+}
+
+void String::replace(const char *Find, const char *Replacement) {
+   size_t FindLength = strlen(Find);
+   if (FindLength == 0) {
+      return;
+   }
+
+   char Result[sizeof(_Text)] = "";
+   const char *Position = _Text;
+   const char *Match;
+   while ((Match = strstr(Position, Find)) != NULL) {
+      strncat(Result, Position, min((size_t)(Match - Position), sizeof(Result) - 1 - strlen(Result)));
+      strncat(Result, Replacement, sizeof(Result) - 1 - strlen(Result));
+      Position = Match + FindLength;
+   }
+   strncat(Result, Position, sizeof(Result) - 1 - strlen(Result));
+   strcpy(_Text, Result);
+}
+
+bool String::reserve(unsigned int Size) {
+   return Size < sizeof(_Text);
+}
+
+size_t Print::write(const char *Text) {
+   return write((const uint8_t *)Text, strlen(Text));
+}
+
+size_t Print::write(const uint8_t *Buffer, size_t Size) {
+   for (size_t i = 0; i < Size; i++) {
+      write(Buffer[i]);
+   }
+   return Size;
+}
+
+size_t Print::print(const char *Text) {
+   return write(Text);
+}
+
+size_t Print::print(const String &Text) {
+   return write(Text.c_str());
+}
+
+size_t Print::print(char Character) {
+   return write((uint8_t)Character);
+}
+
+size_t Print::print(long Value, int Radix) {
+   char Text[24];
+   return write(ltoa(Value, Text, Radix));
+}
+
+size_t Print::print(unsigned long Value, int Radix) {
+   char Text[24];
+   return write(ultoa(Value, Text, Radix));
+}
+
+size_t Print::print(int Value, int Radix) {
+   return print((long)Value, Radix);
+}
+
+size_t Print::print(unsigned int Value, int Radix) {
+   return print((unsigned long)Value, Radix);
+}
+
+size_t Print::println(const char *Text) {
+   return print(Text) + write("\r\n");
+}
+
+size_t Print::println(const String &Text) {
+   return println(Text.c_str());
+}
+
+size_t Print::println(long Value, int Radix) {
+   return print(Value, Radix) + write("\r\n");
+}
+
+size_t Print::println(unsigned long Value, int Radix) {
+   return print(Value, Radix) + write("\r\n");
+}
+
+size_t Print::println(int Value, int Radix) {
+   return print(Value, Radix) + write("\r\n");
+}
+
+void HardwareSerial::begin(unsigned long Baud) {
+}
+
+size_t HardwareSerial::write(uint8_t Character) {
+   return 1;
+}
+
+int HardwareSerial::available() {
+   return 0;
+}
+
+int HardwareSerial::read() {
+   return -1;
+}
+
+int HardwareSerial::peek() {
+   return -1;
+}
+
+int HardwareSerial::availableForWrite() {
+   return 64;
+}
+
+HardwareSerial::operator bool() {
+   return true;
+}
+
+EEPROMClass::EEPROMClass() {
+   ClearEeprom();
+}
+
+uint8_t EEPROMClass::read(int Address) {
+   return EepromBytes[Address];
+}
+
+void EEPROMClass::write(int Address, uint8_t Value) {
+   EepromBytes[Address] = Value;
+}
+
+void EEPROMClass::update(int Address, uint8_t Value) {
+   EepromBytes[Address] = Value;
+}
@@ -0,0 +1,17 @@
+#ifndef _ARDUINOSTUBS_h
+#define _ARDUINOSTUBS_h
+
+#include "Arduino.h"
+
+// Controls of the host Arduino stand-in, for the tests.
+
+//Sets the time returned by micros() and millis()
+void SetMicros(unsigned long Time);
+//Sets the level digitalRead() returns for a pin
+void SetPinState(uint8_t Pin, uint8_t State);
+//Gets the level last written to a pin with digitalWrite()
+uint8_t GetPinOutput(uint8_t Pin);
+//Erases the EEPROM (all bytes 0xFF)
+void ClearEeprom();
+
+#endif
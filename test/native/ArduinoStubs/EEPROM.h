@@ -0,0 +1,36 @@
+#ifndef _EEPROM_STUBS_h
+#define _EEPROM_STUBS_h
+
+#include <stdint.h>
+
+/// <summary>
+///   The 4 KB EEPROM of the ATmega2560, kept in RAM. It starts erased (all bytes 0xFF).
+/// </summary>
+class EEPROMClass {
+   public:
+      EEPROMClass();
+      uint8_t read(int Address);
+      void write(int Address, uint8_t Value);
+      void update(int Address, uint8_t Value);
+      uint16_t length() { return 4096; }
+
+      template <typename T> T &get(int Address, T &Value) {
+         uint8_t *Bytes = (uint8_t *)&Value;
+         for (unsigned int i = 0; i < sizeof(T); i++) {
+            Bytes[i] = read(Address + i);
+         }
+         return Value;
+      }
+
+      template <typename T> const T &put(int Address, const T &Value) {
+         const uint8_t *Bytes = (const uint8_t *)&Value;
+         for (unsigned int i = 0; i < sizeof(T); i++) {
+            update(Address + i, Bytes[i]);
+         }
+         return Value;
+      }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _INTERRUPT_STUBS_h
+#define _INTERRUPT_STUBS_h
+
+//Interrupt handlers become plain functions the tests can call
+#define ISR(Vector) extern "C" void Vector(void)
+#define cli()
+#define sei()
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _IO_STUBS_h
+#define _IO_STUBS_h
+
+#include <stdint.h>
+
+//Timer registers of the ATmega2560 used by the libraries, as plain variables
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2, TCNT2;
+extern volatile uint8_t TCCR3A, TCCR3B, TIMSK3;
+extern volatile uint16_t OCR1A, OCR1B, OCR3A, OCR3B;
+extern volatile uint8_t SREG;
+
+#define _BV(Bit) (1 << (Bit))
+
+#define COM0B1 5
+#define COM1A1 7
+#define COM1B1 5
+#define COM3A1 7
+#define TOIE1 0
+#define WGM21 1
+#define CS21 1
+#define OCIE2A 1
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _PGMSPACE_STUBS_h
+#define _PGMSPACE_STUBS_h
+
+#include <string.h>
+#include <strings.h>
+
+//Host code and data share one address space
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(Text) (Text)
+#define pgm_read_byte(Address) (*(const uint8_t *)(Address))
+#define pgm_read_word(Address) (*(const uint16_t *)(Address))
+#define pgm_read_dword(Address) (*(const uint32_t *)(Address))
+#define pgm_read_ptr(Address) (*(const void *const *)(Address))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define snprintf_P snprintf
+#define sprintf_P sprintf
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _ATOMIC_STUBS_h
+#define _ATOMIC_STUBS_h
+
+#include <stdint.h>
+
+//Nothing interrupts the host tests
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(Type) for (uint8_t _AtomicOnce = 1; _AtomicOnce; _AtomicOnce = 0)
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _RACETRACE_h
+#define _RACETRACE_h
+
+#include <ArduinoStubs.h>
+#include <RaceHandler.h>
+
+// Synthetic sensor traces for the race handler tests. Sensor 1 is the handler side beam on pin 3,
+// sensor 2 the box side beam on pin 2, as wired in main.cpp. Every edge is handled right away.
+
+#define TRACE_SENSOR1_PIN 3
+#define TRACE_SENSOR2_PIN 2
+#define TRACE_GREEN_TIME 3000100UL     //Green light of StartHeat()
+
+/// <summary>
+///   Feeds one sensor edge to the race handler at the given time.
+/// </summary>
+static inline void TraceEdge(unsigned long Time, uint8_t SensorNumber, uint8_t State) {
+   SetMicros(Time);
+   if (SensorNumber == 1) {
+      SetPinState(TRACE_SENSOR1_PIN, State);
+      RaceHandler.TriggerSensor1();
+   } else {
+      SetPinState(TRACE_SENSOR2_PIN, State);
+      RaceHandler.TriggerSensor2();
+   }
+   RaceHandler.Main();
+}
+
+/// <summary>
+///   A dog going in: handler side beam first (ABab), both beams clear after 80ms.
+/// </summary>
+static inline void TraceGoingIn(unsigned long Time) {
+   TraceEdge(Time, 1, 1);
+   TraceEdge(Time + 20000, 2, 1);
+   TraceEdge(Time + 60000, 1, 0);
+   TraceEdge(Time + 80000, 2, 0);
+}
+
+/// <summary>
+///   A dog coming back: box side beam first (BAba), both beams clear after 80ms.
+/// </summary>
+static inline void TraceComingBack(unsigned long Time) {
+   TraceEdge(Time, 2, 1);
+   TraceEdge(Time + 20000, 1, 1);
+   TraceEdge(Time + 60000, 2, 0);
+   TraceEdge(Time + 80000, 1, 0);
+}
+
+/// <summary>
+///   Resets the race and starts a heat, the green light comes on at TRACE_GREEN_TIME.
+/// </summary>
+static inline void TraceStartHeat() {
+   RaceHandler.ResetRace();
+   SetMicros(100);
+   RaceHandler.StartRace();
+   SetMicros(TRACE_GREEN_TIME);
+   RaceHandler.StartTimers(TRACE_GREEN_TIME);
+   RaceHandler.Main();
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include <unity.h>
+#include <ArduinoStubs.h>
+#include <LightsBackend.h>
+
+// Duty cycles of the PWM lights backend (env:native_pwm, built with LIGHTS_BACKEND_PWM).
+
+//Pins 4, 11 and 12 have a PWM channel (OC0B, OC1A, OC1B), pin 13 has none
+static const uint8_t LightPins[NUM_LIGHTS] = {4, 11, 12, 13};
+
+/// <summary>
+///   Runs the Timer1 overflow interrupt until no light is fading anymore.
+/// </summary>
+///
+/// <returns>
+///   The number of overflows the fade took.
+/// </returns>
+static unsigned int RunFade() {
+   unsigned int Steps = 0;
+   while ((TIMSK1 & _BV(TOIE1)) && Steps < 1000) {
+      LightsBackend.HandleTimerOverflow();
+      Steps++;
+   }
+   return Steps;
+}
+
+void setUp() {
+   TCCR0A = 0;
+   TCCR1A = 0;
+   TIMSK1 = 0;
+   LightsBackend.SetFadeTime(0);
+   LightsBackend.Init(LightPins);
+}
+
+void tearDown() {
+}
+
+void test_light_switches_immediately_without_fade_time() {
+   LightsBackend.SetLight(0, true);
+   TEST_ASSERT_EQUAL(255, LightsBackend.GetDuty(0));
+   TEST_ASSERT_EQUAL(255, OCR0B);
+   TEST_ASSERT_TRUE(TCCR0A & _BV(COM0B1));
+   TEST_ASSERT_FALSE(TIMSK1 & _BV(TOIE1));
+
+   //At duty 0 the output is disconnected from the timer
+   LightsBackend.SetLight(0, false);
+   TEST_ASSERT_EQUAL(0, OCR0B);
+   TEST_ASSERT_FALSE(TCCR0A & _BV(COM0B1));
+}
+
+void test_fade_in_rises_every_overflow() {
+   LightsBackend.SetFadeTime(20);
+   LightsBackend.SetLight(1, true);
+   TEST_ASSERT_TRUE(TIMSK1 & _BV(TOIE1));
+
+   uint8_t LastDuty = 0;
+   unsigned int Steps = 0;
+   while (TIMSK1 & _BV(TOIE1)) {
+      LightsBackend.HandleTimerOverflow();
+      Steps++;
+      TEST_ASSERT_GREATER_THAN(LastDuty, LightsBackend.GetDuty(1));
+      TEST_ASSERT_EQUAL(LightsBackend.GetDuty(1), OCR1A);
+      LastDuty = LightsBackend.GetDuty(1);
+   }
+
+   //20ms at 2.04ms per overflow, the last step ends on the target
+   TEST_ASSERT_INT_WITHIN(1, 10, Steps);
+   TEST_ASSERT_EQUAL(255, OCR1A);
+   TEST_ASSERT_TRUE(TCCR1A & _BV(COM1A1));
+}
+
+void test_brightness_fades_a_light_which_is_on() {
+   LightsBackend.SetFadeTime(20);
+   LightsBackend.SetLight(2, true);
+   RunFade();
+
+   LightsBackend.SetBrightness(2, 64);
+   RunFade();
+   TEST_ASSERT_EQUAL(64, LightsBackend.GetDuty(2));
+   TEST_ASSERT_EQUAL(64, OCR1B);
+
+   LightsBackend.SetLight(2, false);
+   RunFade();
+   TEST_ASSERT_EQUAL(0, OCR1B);
+   TEST_ASSERT_FALSE(TCCR1A & _BV(COM1B1));
+
+   //Switching it on again uses the new brightness
+   LightsBackend.SetLight(2, true);
+   RunFade();
+   TEST_ASSERT_EQUAL(64, OCR1B);
+}
+
+void test_fade_time_sets_the_number_of_steps() {
+   LightsBackend.SetFadeTime(1000);
+   LightsBackend.SetLight(1, true);
+   TEST_ASSERT_INT_WITHIN(2, 1000000 / 2040, RunFade());
+   TEST_ASSERT_EQUAL(255, LightsBackend.GetDuty(1));
+}
+
+void test_pin_without_pwm_channel_switches() {
+   LightsBackend.SetFadeTime(20);
+   LightsBackend.SetLight(3, true);
+   TEST_ASSERT_EQUAL(HIGH, GetPinOutput(13));
+   TEST_ASSERT_FALSE(TIMSK1 & _BV(TOIE1));
+
+   LightsBackend.SetBrightness(3, 10);
+   TEST_ASSERT_EQUAL(HIGH, GetPinOutput(13));
+   LightsBackend.SetLight(3, false);
+   TEST_ASSERT_EQUAL(LOW, GetPinOutput(13));
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_light_switches_immediately_without_fade_time);
+   RUN_TEST(test_fade_in_rises_every_overflow);
+   RUN_TEST(test_brightness_fades_a_light_which_is_on);
+   RUN_TEST(test_fade_time_sets_the_number_of_steps);
+   RUN_TEST(test_pin_without_pwm_channel_switches);
+   return UNITY_END();
+}
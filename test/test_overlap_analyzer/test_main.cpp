@@ -0,0 +1,155 @@
+#include <unity.h>
+#include <ArduinoStubs.h>
+#include <OverlapAnalyzer.h>
+
+// Pass-over crossings: the returning dog (0) is still in the gates when the entering dog (1)
+// breaks the handlers side beam, the analyzer only sees the union of both dogs on each beam.
+
+#define WINDOW_START 1000000UL
+#define SWEEP_CASES 2000
+#define SWEEP_MAX_ERROR 25000L   //Microseconds
+
+struct BeamEdge {
+   long Time;              //Relative to the window start
+   uint8_t SensorNumber;
+   uint8_t SensorState;
+};
+
+static BeamEdge Edges[8];
+static uint8_t EdgeCount;
+static unsigned long RandomState;
+
+/// <summary>
+///   Small LCG, so the sweep is the same with every C library.
+/// </summary>
+static long Random(long Range) {
+   RandomState = RandomState * 1103515245UL + 12345UL;
+   return (long)((RandomState >> 8) % (unsigned long)Range);
+}
+
+/// <summary>
+///   Changes a time by up to +-10% (speed of the dog) and +-1ms (jitter).
+/// </summary>
+static long Vary(long Time) {
+   return Time + (Random(2001) - 1000) + Time * (Random(21) - 10) / 100;
+}
+
+/// <summary>
+///   Adds the beam edges of a dog passing the gates, FirstSensor is the beam the dog breaks first.
+/// </summary>
+static void AddPass(long Start, uint8_t FirstSensor, long Gap, long FirstOccluded, long SecondOccluded) {
+   uint8_t SecondSensor = 3 - FirstSensor;
+   Edges[EdgeCount++] = {Start, FirstSensor, 1};
+   Edges[EdgeCount++] = {Start + FirstOccluded, FirstSensor, 0};
+   Edges[EdgeCount++] = {Start + Gap, SecondSensor, 1};
+   Edges[EdgeCount++] = {Start + Gap + SecondOccluded, SecondSensor, 0};
+}
+
+/// <summary>
+///   Feeds the added edges as the gates see them: a beam is broken while any dog breaks it.
+/// </summary>
+static void FeedWindow() {
+   for (uint8_t i = 1; i < EdgeCount; i++) {
+      BeamEdge Edge = Edges[i];
+      uint8_t j = i;
+      for (; j > 0 && Edges[j - 1].Time > Edge.Time; j--) {
+         Edges[j] = Edges[j - 1];
+      }
+      Edges[j] = Edge;
+   }
+
+   uint8_t Occluding[3] = {0, 0, 0};
+   OverlapAnalyzer.StartWindow();
+   for (uint8_t i = 0; i < EdgeCount; i++) {
+      const BeamEdge &Edge = Edges[i];
+      if (Edge.SensorState == 1) {
+         if (Occluding[Edge.SensorNumber]++ == 0) {
+            OverlapAnalyzer.AddEdge(Edge.SensorNumber, 1, WINDOW_START + Edge.Time);
+         }
+      } else if (--Occluding[Edge.SensorNumber] == 0) {
+         OverlapAnalyzer.AddEdge(Edge.SensorNumber, 0, WINDOW_START + Edge.Time);
+      }
+   }
+   EdgeCount = 0;
+}
+
+void setUp() {
+   OverlapAnalyzer.Reset();
+   EdgeCount = 0;
+   RandomState = 1;
+}
+
+void tearDown() {
+}
+
+void test_no_estimate_without_clean_passes() {
+   long CrossingTime;
+   AddPass(0, 2, 20000, 50000, 50000);
+   AddPass(-30000, 1, 20000, 50000, 50000);
+   FeedWindow();
+   TEST_ASSERT_FALSE(OverlapAnalyzer.EstimateCrossingTime(0, 1, CrossingTime));
+}
+
+void test_exact_profiles_give_exact_crossing() {
+   //Returning dog breaks beam 2 first, the entering dog beam 1
+   AddPass(0, 2, 20000, 50000, 60000);
+   FeedWindow();
+   OverlapAnalyzer.RecordCleanPass(0);
+   AddPass(0, 1, 25000, 45000, 55000);
+   FeedWindow();
+   OverlapAnalyzer.RecordCleanPass(1);
+
+   const long Crossings[] = {-150000, -30000, 10000, 120000};
+   for (uint8_t i = 0; i < sizeof(Crossings) / sizeof(Crossings[0]); i++) {
+      long CrossingTime;
+      AddPass(0, 2, 20000, 50000, 60000);
+      AddPass(Crossings[i], 1, 25000, 45000, 55000);
+      FeedWindow();
+      TEST_ASSERT_TRUE(OverlapAnalyzer.EstimateCrossingTime(0, 1, CrossingTime));
+      TEST_ASSERT_INT_WITHIN(1000, Crossings[i], CrossingTime);
+   }
+}
+
+void test_crossing_sweep_with_varying_dogs() {
+   long WorstError = 0;
+   unsigned int Failures = 0;
+   for (unsigned int Case = 0; Case < SWEEP_CASES; Case++) {
+      OverlapAnalyzer.Reset();
+      long ReturnGap = 15000 + Random(15000), ReturnOccluded1 = 40000 + Random(30000), ReturnOccluded2 = 40000 + Random(30000);
+      long EnterGap = 15000 + Random(15000), EnterOccluded1 = 40000 + Random(30000), EnterOccluded2 = 40000 + Random(30000);
+
+      AddPass(0, 2, ReturnGap, ReturnOccluded1, ReturnOccluded2);
+      FeedWindow();
+      OverlapAnalyzer.RecordCleanPass(0);
+      AddPass(0, 1, EnterGap, EnterOccluded1, EnterOccluded2);
+      FeedWindow();
+      OverlapAnalyzer.RecordCleanPass(1);
+
+      long Crossing = Random(400001) - 200000;
+      AddPass(0, 2, Vary(ReturnGap), Vary(ReturnOccluded1), Vary(ReturnOccluded2));
+      AddPass(Crossing, 1, Vary(EnterGap), Vary(EnterOccluded1), Vary(EnterOccluded2));
+      FeedWindow();
+
+      long CrossingTime;
+      if (!OverlapAnalyzer.EstimateCrossingTime(0, 1, CrossingTime)) {
+         Failures++;
+         continue;
+      }
+      long Error = labs(CrossingTime - Crossing);
+      if (Error > WorstError) {
+         WorstError = Error;
+      }
+   }
+
+   TEST_PRINTF("%u crossings, worst error %ld us", SWEEP_CASES, WorstError);
+   TEST_ASSERT_EQUAL(0, Failures);
+   TEST_ASSERT_LESS_OR_EQUAL(SWEEP_MAX_ERROR, WorstError);
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_no_estimate_without_clean_passes);
+   RUN_TEST(test_exact_profiles_give_exact_crossing);
+   RUN_TEST(test_crossing_sweep_with_varying_dogs);
+   return UNITY_END();
+}
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <unity.h>
+#include <RaceTrace.h>
+#include <RaceJournal.h>
+#include <RaceReconstruction.h>
+
+// Rebuilding heats from the race journal after they are over.
+
+#define LANE_TIME 2400000UL        //Going in to coming back of every dog in the traces
+#define BENCHMARK_RUNS 200
+
+static const long NoSensorOffsets[2][2] = {{0, 0}, {0, 0}};
+static uint8_t RunCount;
+
+/// <summary>
+///   Runs a heat where every dog comes back after LANE_TIME and the next dog crosses 200ms later.
+///   Each of the first FaultRuns runs gets a fault. With Chatter, the box side beam blips twice
+///   shortly after every dog went in. Each blip is a gate window of its own.
+/// </summary>
+static void RunHeat(uint8_t FaultRuns, bool Chatter) {
+   TraceStartHeat();
+   RunCount = 0;
+   unsigned long Time = TRACE_GREEN_TIME + 200000;
+   while (RaceHandler.RaceState != RaceHandlerClass::STOP && RunCount < RECONSTRUCTION_MAX_RUNS) {
+      uint8_t DogIndex = RaceHandler.CurrentDogIndex;
+      RunCount++;
+      TraceGoingIn(Time);
+      if (Chatter) {
+         for (uint8_t Blip = 0; Blip < 2; Blip++) {
+            unsigned long BlipTime = Time + 300000 + Blip * 50000UL;
+            TraceEdge(BlipTime, 2, 1);
+            TraceEdge(BlipTime + 3000, 2, 0);
+         }
+      }
+      if (RunCount <= FaultRuns) {
+         RaceHandler.SetDogFault(DogIndex, RaceHandlerClass::ON);
+      }
+      Time += LANE_TIME;
+      TraceComingBack(Time);
+      Time += 200000;
+   }
+}
+
+/// <summary>
+///   Reconstructs the last heat and checks every run against the trace: each dog crossed 200ms late
+///   and came back after LANE_TIME.
+/// </summary>
+static void CheckReconstruction() {
+   unsigned long ExpectedLaneTimes[RECONSTRUCTION_MAX_RUNS];
+   for (uint8_t i = 0; i < RunCount; i++) {
+      ExpectedLaneTimes[i] = LANE_TIME;
+   }
+
+   RaceReconstructionClass::ReconstructedRun Runs[RECONSTRUCTION_MAX_RUNS];
+   TEST_ASSERT_EQUAL(RaceReconstructionClass::RECONSTRUCTED, RaceReconstruction.Run(TRACE_GREEN_TIME, NoSensorOffsets, RunCount, ExpectedLaneTimes, Runs));
+   for (uint8_t i = 0; i < RunCount; i++) {
+      TEST_ASSERT_TRUE(Runs[i].Complete);
+      TEST_ASSERT_TRUE(Runs[i].CrossingKnown);
+      TEST_ASSERT_INT_WITHIN(RECONSTRUCTION_TOLERANCE, 200000 + LANE_TIME, Runs[i].DogTime);
+      TEST_ASSERT_INT_WITHIN(RECONSTRUCTION_TOLERANCE, 200000, Runs[i].CrossingTime);
+   }
+}
+
+void setUp() {
+   RaceHandler.init(TRACE_SENSOR1_PIN, TRACE_SENSOR2_PIN);
+}
+
+void tearDown() {
+}
+
+void test_clean_heat_is_reconstructed() {
+   RunHeat(0, false);
+
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+   TEST_ASSERT_EQUAL(RaceRules::DogsPerTeam, RunCount);
+   CheckReconstruction();
+
+   //The live result agrees, its dog times leave out the part of the crossing the dog was late
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      const DogTimeData &Timing = RaceHandler.GetRaceData().DogData[DogIndex].Timing[0];
+      TEST_ASSERT_EQUAL(LANE_TIME / 1000, Timing.Time);
+      TEST_ASSERT_EQUAL(200000, Timing.CrossingTime);
+   }
+}
+
+void test_long_heat_with_chatter_fits_the_journal() {
+   //Every dog runs 3 times and one dog a 4th time: 13 runs, 26 blips
+   RunHeat(9, true);
+
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+   TEST_ASSERT_EQUAL(13, RunCount);
+   TEST_ASSERT_TRUE(RaceJournal.IsComplete());
+   TEST_PRINTF("%u runs used %u of %u journal bytes", RunCount, RaceJournal.GetUsedBytes(), JOURNAL_BUFFER_SIZE);
+   CheckReconstruction();
+}
+
+void test_journal_is_written_to_eeprom_a_byte_per_loop() {
+   RunHeat(9, true);
+   unsigned int RaceId = RaceHandler.GetRaceData().Id;
+   uint16_t JournalBytes = RaceJournal.GetUsedBytes();
+
+   //The Main() after the one which stopped the heat checked it and started the flush
+   TEST_ASSERT_TRUE(RaceJournal.IsFlushing());
+   unsigned int Calls = 0;
+   while (RaceJournal.IsFlushing() && Calls < 2 * JournalBytes) {
+      RaceJournal.Main();
+      Calls++;
+   }
+   TEST_ASSERT_FALSE(RaceJournal.IsFlushing());
+   TEST_PRINTF("%u journal bytes written in %u loops", JournalBytes, Calls);
+
+   //Flushing it again only compares, JOURNAL_FLUSH_BYTES per loop (plus one loop for the header)
+   RaceJournal.Flush();
+   Calls = 0;
+   while (RaceJournal.IsFlushing()) {
+      RaceJournal.Main();
+      Calls++;
+   }
+   TEST_ASSERT_LESS_OR_EQUAL(JournalBytes / JOURNAL_FLUSH_BYTES + 2, Calls);
+
+   //Once the next heat runs the journal comes from EEPROM
+   TraceStartHeat();
+   TEST_ASSERT_TRUE(RaceJournal.Export(RaceId));
+}
+
+void test_reconstruction_run_time() {
+   RunHeat(9, true);
+
+   unsigned long ExpectedLaneTimes[RECONSTRUCTION_MAX_RUNS];
+   for (uint8_t i = 0; i < RunCount; i++) {
+      ExpectedLaneTimes[i] = LANE_TIME;
+   }
+   RaceReconstructionClass::ReconstructedRun Runs[RECONSTRUCTION_MAX_RUNS];
+   std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+   RaceReconstructionClass::ReconstructionResults Result = RaceReconstructionClass::RECONSTRUCTED;
+   for (unsigned int i = 0; i < BENCHMARK_RUNS; i++) {
+      Result = RaceReconstruction.Run(TRACE_GREEN_TIME, NoSensorOffsets, RunCount, ExpectedLaneTimes, Runs);
+   }
+   long Elapsed = (long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+
+   //Host time only, the ATmega2560 is orders of magnitude slower
+   TEST_PRINTF("%u runs with chatter: %ld ns per Run() on the host", RunCount, Elapsed / BENCHMARK_RUNS);
+   TEST_ASSERT_EQUAL(RaceReconstructionClass::RECONSTRUCTED, Result);
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_clean_heat_is_reconstructed);
+   RUN_TEST(test_long_heat_with_chatter_fits_the_journal);
+   RUN_TEST(test_journal_is_written_to_eeprom_a_byte_per_loop);
+   RUN_TEST(test_reconstruction_run_time);
+   return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <RaceTrace.h>
+
+// The FCI rules profile, and the race handler applying it to sensor traces.
+
+static long DogChangedTimes[RaceRules::DogsPerTeam];
+
+static void HandleRaceEvent(const RaceHandlerClass::RaceEvent &Event) {
+   if (Event.Type == RaceHandlerClass::DOG_CHANGED) {
+      DogChangedTimes[Event.DogIndex] = Event.Value;
+   }
+}
+
+void setUp() {
+   RaceHandler.init(TRACE_SENSOR1_PIN, TRACE_SENSOR2_PIN);
+}
+
+void tearDown() {
+}
+
+void test_green_light_comes_on_after_the_start_delay() {
+   RaceHandler.ResetRace();
+   SetMicros(100);
+   RaceHandler.StartRace();
+   RaceHandler.Main();
+
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STARTING, RaceHandler.RaceState);
+   TEST_ASSERT_EQUAL((100 + RaceRules::StartDelay) / 1000, RaceHandler.GetRaceData().StartTime);
+}
+
+void test_team_finishes_after_every_dog_ran_once() {
+   TraceStartHeat();
+   unsigned long Time = TRACE_GREEN_TIME + 5000;
+   for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+      TEST_ASSERT_EQUAL(RaceHandlerClass::RACING, RaceHandler.RaceState);
+      TEST_ASSERT_EQUAL(DogIndex, RaceHandler.CurrentDogIndex);
+      TraceGoingIn(Time);
+      Time += 4000000;
+      TraceComingBack(Time);
+      Time += 100000;
+   }
+
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+}
+
+void test_previous_race_is_kept_after_the_reset() {
+   test_team_finishes_after_every_dog_ran_once();
+   RaceData Finished = RaceHandler.GetRaceData();
+
+   TraceStartHeat();
+   RaceData Previous;
+   TEST_ASSERT_NOT_EQUAL(Finished.Id, RaceHandler.GetRaceData().Id);
+   TEST_ASSERT_TRUE(RaceHandler.GetRaceData(Finished.Id, Previous));
+   TEST_ASSERT_EQUAL(Finished.ElapsedTime, Previous.ElapsedTime);
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, Previous.RaceState);
+}
+
+void test_return_within_false_crossing_window_is_not_timed() {
+   unsigned long Time = TRACE_GREEN_TIME + 5000;
+   TraceStartHeat();
+   TraceGoingIn(Time);
+   TraceComingBack(Time + RaceRules::FalseCrossingWindow - 100000);
+   TEST_ASSERT_EQUAL(0, RaceHandler.GetRaceData().DogData[0].Timing[0].Time);
+
+   TraceStartHeat();
+   TraceGoingIn(Time);
+   TraceComingBack(Time + RaceRules::FalseCrossingWindow + 100000);
+   TEST_ASSERT_EQUAL((RaceRules::FalseCrossingWindow + 100000) / 1000, RaceHandler.GetRaceData().DogData[0].Timing[0].Time);
+}
+
+void test_crossings_are_classified_by_the_profile_limits() {
+   const long Crossings[] = {RaceRules::PerfectCrossingLimit - 1000, RaceRules::PerfectCrossingLimit + 1000, RaceRules::LateCrossingLimit + 1000};
+   const uint8_t Classes[] = {RaceHandlerClass::CROSSING_PERFECT, RaceHandlerClass::CROSSING_OK, RaceHandlerClass::CROSSING_LATE};
+
+   TraceStartHeat();
+   unsigned long Time = TRACE_GREEN_TIME + 5000;
+   TraceGoingIn(Time);
+   for (uint8_t i = 0; i < 3; i++) {
+      Time += 4000000;
+      TraceComingBack(Time);
+      TraceGoingIn(Time + Crossings[i]);
+      Time += Crossings[i];
+   }
+
+   for (uint8_t i = 0; i < 3; i++) {
+      const DogTimeData &Timing = RaceHandler.GetRaceData().DogData[i + 1].Timing[0];
+      TEST_ASSERT_EQUAL(Crossings[i], Timing.CrossingTime);
+      TEST_ASSERT_EQUAL(Classes[i], Timing.CrossingClass);
+   }
+}
+
+void test_first_dog_crossing_before_green_is_a_fault() {
+   TraceStartHeat();
+   //Edge queued before the green light, the handler sees it after the lights changed
+   TraceGoingIn(TRACE_GREEN_TIME - 20000);
+
+   const stDogData &DogData = RaceHandler.GetRaceData().DogData[0];
+   TEST_ASSERT_TRUE(DogData.Fault);
+   TEST_ASSERT_EQUAL(-20000, DogData.Timing[0].CrossingTime);
+   TEST_ASSERT_EQUAL(RaceHandlerClass::CROSSING_EARLY, DogData.Timing[0].CrossingClass);
+}
+
+void test_pass_over_without_profiles_leaves_the_crossing_unknown() {
+   TraceStartHeat();
+   //Dog 0 went in unseen, so no dog passed the gates alone yet when dog 1 goes in while dog 0
+   //is still in the gates (BAab)
+   unsigned long Time = TRACE_GREEN_TIME + 4000000;
+   TraceEdge(Time, 2, 1);
+   TraceEdge(Time + 20000, 1, 1);
+   TraceEdge(Time + 60000, 1, 0);
+   TraceEdge(Time + 80000, 2, 0);
+
+   const DogTimeData &Timing = RaceHandler.GetRaceData().DogData[1].Timing[0];
+   TEST_ASSERT_EQUAL(1, RaceHandler.CurrentDogIndex);
+   TEST_ASSERT_EQUAL(0, Timing.CrossingTime);
+   TEST_ASSERT_EQUAL(RaceHandlerClass::CROSSING_NONE, Timing.CrossingClass);
+}
+
+void test_dog_changed_reports_when_the_run_started() {
+   TraceStartHeat();
+   memset(DogChangedTimes, 0, sizeof(DogChangedTimes));
+   unsigned long Time = TRACE_GREEN_TIME + 5000;
+   TraceGoingIn(Time);
+   Time += 4000000;
+   TraceComingBack(Time);
+
+   //Dog 1 starts when dog 0 breaks the box side beam, not when the gates are clear again
+   TEST_ASSERT_EQUAL(1, RaceHandler.CurrentDogIndex);
+   TEST_ASSERT_EQUAL((Time - TRACE_GREEN_TIME) / 1000, DogChangedTimes[1]);
+}
+
+int main() {
+   RaceHandler.Subscribe(HandleRaceEvent);
+   UNITY_BEGIN();
+   RUN_TEST(test_green_light_comes_on_after_the_start_delay);
+   RUN_TEST(test_team_finishes_after_every_dog_ran_once);
+   RUN_TEST(test_previous_race_is_kept_after_the_reset);
+   RUN_TEST(test_return_within_false_crossing_window_is_not_timed);
+   RUN_TEST(test_crossings_are_classified_by_the_profile_limits);
+   RUN_TEST(test_first_dog_crossing_before_green_is_a_fault);
+   RUN_TEST(test_pass_over_without_profiles_leaves_the_crossing_unknown);
+   RUN_TEST(test_dog_changed_reports_when_the_run_started);
+   return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <RaceTrace.h>
+
+// Rerun scheduling: dogs which faulted run again after the last dog, in the order they faulted.
+
+#define MAX_TRACE_RUNS 16
+
+static uint8_t RunOrder[MAX_TRACE_RUNS];
+static uint8_t RunCount;
+static uint8_t RerunsNotQueued[RaceRules::DogsPerTeam];
+
+static void HandleRaceEvent(const RaceHandlerClass::RaceEvent &Event) {
+   if (Event.Type == RaceHandlerClass::RERUN_NOT_QUEUED) {
+      RerunsNotQueued[Event.DogIndex] = Event.Value;
+   }
+}
+
+/// <summary>
+///   Runs a heat where every dog takes 2.5s and the next dog crosses 200ms after it came back.
+///   Dogs in FaultMask get a fault during their first run, the dog of run FaultAgainRun (1-based,
+///   0 for none) also gets one. Dogs in RepeatFaultMask get a fault during every run.
+/// </summary>
+static void RunHeat(uint8_t FaultMask, uint8_t FaultAgainRun, uint8_t RepeatFaultMask = 0) {
+   TraceStartHeat();
+   RunCount = 0;
+   memset(RerunsNotQueued, 0, sizeof(RerunsNotQueued));
+   unsigned long Time = TRACE_GREEN_TIME + 200000;
+   while (RaceHandler.RaceState != RaceHandlerClass::STOP && RunCount < MAX_TRACE_RUNS) {
+      uint8_t DogIndex = RaceHandler.CurrentDogIndex;
+      RunOrder[RunCount++] = DogIndex;
+      TraceGoingIn(Time);
+      Time += 2500000;
+      if ((RunCount <= RaceRules::DogsPerTeam && (FaultMask & _BV(DogIndex))) || RunCount == FaultAgainRun
+         || (RepeatFaultMask & _BV(DogIndex))) {
+         RaceHandler.SetDogFault(DogIndex, RaceHandlerClass::ON);
+      }
+      TraceComingBack(Time);
+      Time += 200000;
+   }
+}
+
+void setUp() {
+   RaceHandler.init(TRACE_SENSOR1_PIN, TRACE_SENSOR2_PIN);
+}
+
+void tearDown() {
+}
+
+void test_clean_heat_has_no_reruns() {
+   RunHeat(0, 0);
+
+   const uint8_t Expected[] = {0, 1, 2, 3};
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+   TEST_ASSERT_EQUAL(sizeof(Expected), RunCount);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(Expected, RunOrder, sizeof(Expected));
+}
+
+void test_faulted_dogs_rerun_in_fault_order() {
+   for (uint8_t FaultMask = 1; FaultMask < _BV(RaceRules::DogsPerTeam); FaultMask++) {
+      RunHeat(FaultMask, 0);
+
+      uint8_t Expected[MAX_TRACE_RUNS];
+      uint8_t ExpectedCount = 0;
+      for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+         Expected[ExpectedCount++] = DogIndex;
+      }
+      for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+         if (FaultMask & _BV(DogIndex)) {
+            Expected[ExpectedCount++] = DogIndex;
+         }
+      }
+
+      TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+      TEST_ASSERT_EQUAL(ExpectedCount, RunCount);
+      TEST_ASSERT_EQUAL_UINT8_ARRAY(Expected, RunOrder, ExpectedCount);
+      for (uint8_t DogIndex = 0; DogIndex < RaceRules::DogsPerTeam; DogIndex++) {
+         const stDogData &DogData = RaceHandler.GetRaceData().DogData[DogIndex];
+         TEST_ASSERT_EQUAL((FaultMask & _BV(DogIndex)) ? 1 : 0, DogData.LastRunNumber);
+         TEST_ASSERT_FALSE(DogData.Fault);
+      }
+   }
+}
+
+void test_dog_faulting_on_its_rerun_goes_to_the_back_of_the_queue() {
+   //Dogs 1 and 3 fault, dog 1 faults again on its rerun (run 5)
+   RunHeat(_BV(1) | _BV(3), 5);
+
+   const uint8_t Expected[] = {0, 1, 2, 3, 1, 3, 1};
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+   TEST_ASSERT_EQUAL(sizeof(Expected), RunCount);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(Expected, RunOrder, sizeof(Expected));
+   TEST_ASSERT_EQUAL(2, RaceHandler.GetRaceData().DogData[1].LastRunNumber);
+}
+
+void test_front_of_the_rerun_queue() {
+   TraceStartHeat();
+   uint8_t DogIndex;
+   TEST_ASSERT_FALSE(RaceHandler.GetNextRerunDog(DogIndex));
+
+   //Dog 0 faults during its run, it is queued once its run completes
+   unsigned long Time = TRACE_GREEN_TIME + 200000;
+   TraceGoingIn(Time);
+   RaceHandler.SetDogFault(0, RaceHandlerClass::ON);
+   TraceComingBack(Time + 2500000);
+   TEST_ASSERT_TRUE(RaceHandler.GetNextRerunDog(DogIndex));
+   TEST_ASSERT_EQUAL(0, DogIndex);
+
+   //Taking the fault away again takes the rerun away
+   RaceHandler.SetDogFault(0, RaceHandlerClass::OFF);
+   TEST_ASSERT_FALSE(RaceHandler.GetNextRerunDog(DogIndex));
+}
+
+void test_fault_on_the_last_allowed_run_is_reported() {
+   //Dog 0 faults on every run, its last run still has a fault once its run table is full
+   RunHeat(0, 0, _BV(0));
+
+   const uint8_t Expected[] = {0, 1, 2, 3, 0, 0, 0};
+   TEST_ASSERT_EQUAL(RaceHandlerClass::STOP, RaceHandler.RaceState);
+   TEST_ASSERT_EQUAL(sizeof(Expected), RunCount);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(Expected, RunOrder, sizeof(Expected));
+   TEST_ASSERT_TRUE(RaceHandler.GetRaceData().DogData[0].Fault);
+   TEST_ASSERT_EQUAL(RaceRules::MaxRunsPerDog, RerunsNotQueued[0]);
+   TEST_ASSERT_EQUAL(0, RerunsNotQueued[1]);
+}
+
+int main() {
+   RaceHandler.Subscribe(HandleRaceEvent);
+   UNITY_BEGIN();
+   RUN_TEST(test_clean_heat_has_no_reruns);
+   RUN_TEST(test_faulted_dogs_rerun_in_fault_order);
+   RUN_TEST(test_dog_faulting_on_its_rerun_goes_to_the_back_of_the_queue);
+   RUN_TEST(test_front_of_the_rerun_queue);
+   RUN_TEST(test_fault_on_the_last_allowed_run_is_reported);
+   return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+# beam_plot.py
+# Downloads a beam capture from the timing box and draws the beam waveforms of both sensors
+# around the crossing:
+#
+#   python3 tools/beam_plot.py /dev/ttyACM0 3
+#   python3 tools/beam_plot.py /dev/ttyACM0 3 --race 12
+#   python3 tools/beam_plot.py --log session.txt 3 --race 12 --text
+#
+# The capture numbers are in the BEAM_CAPTURE records (type 6) of the journal of a race, they
+# start at 0 in every race. Without --race the box sends the capture of the current race, and a
+# log is searched for the last capture with the number. With --log the frames are read from a
+# saved serial log instead of the box. Without matplotlib, or with --text, the runs are printed
+# instead.
+
+import argparse
+import sys
+import time
+
+
+def checksum_ok(frame):
+   if not frame.startswith("$") or "*" not in frame:
+      return False
+   body, checksum = frame[1:].rsplit("*", 1)
+   value = 0
+   for character in body:
+      value ^= ord(character)
+   try:
+      return value == int(checksum, 16)
+   except ValueError:
+      return False
+
+
+def parse_frames(lines, number, race=None):
+   header, data, length, complete = None, {}, None, None
+   for line in lines:
+      line = line.strip()
+      if not checksum_ok(line):
+         continue
+      fields = line[1:line.index("*")].split(",")
+      if fields[0] == "BMH" and int(fields[1]) == number and (race is None or int(fields[2]) == race):
+         header, data, length = fields, {}, None
+      elif fields[0] == "BMD" and header is not None and length is None and int(fields[1]) == number:
+         data[int(fields[2])] = bytes.fromhex(fields[3])
+      elif fields[0] == "BME" and header is not None and length is None and int(fields[1]) == number:
+         length = int(fields[2])
+         complete = (header, data, length)
+         if race is not None:
+            break
+      elif fields[0] == "ERR" and fields[1] == "BEAM":
+         sys.exit("Capture %d not available" % number)
+   if complete is None:
+      sys.exit("Capture %d not found" % number)
+   header, data, length = complete
+
+   raw = b"".join(data[offset] for offset in sorted(data))
+   if len(raw) != length:
+      sys.exit("Capture %d is incomplete" % number)
+
+   return {
+      "race": int(header[2]),
+      "dog": int(header[3]),
+      "trigger_time": int(header[4]),
+      "pre_samples": int(header[5]),
+      "samples": int(header[6]),
+      "period": int(header[7]),
+      "truncated": header[8] != "0",
+      "runs": decode_runs(raw),
+   }
+
+
+def decode_runs(raw):
+   # One byte per run: beams in bits 6-7, low 5 bits of the length in bits 0-4, bit 5 set if the
+   # rest of the length follows as LEB128
+   runs = []
+   position = 0
+   while position < len(raw):
+      first = raw[position]
+      position += 1
+      length = first & 0x1F
+      if first & 0x20:
+         rest, shift = 0, 0
+         while True:
+            byte = raw[position]
+            position += 1
+            rest |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+               break
+         length |= rest << 5
+      runs.append((first >> 6, length))
+   return runs
+
+
+def read_from_box(port_name, baud, number, race):
+   import serial
+   port = serial.Serial(port_name, baud, timeout=0.5)
+   time.sleep(2)   #Opening the port resets the board
+   port.reset_input_buffer()
+   command = "BEAM %d" % number if race is None else "BEAM %d %d" % (number, race)
+   port.write((command + "\n").encode("ascii"))
+   lines = []
+   deadline = time.monotonic() + 5
+   while time.monotonic() < deadline:
+      line = port.readline().decode("ascii", "replace")
+      lines.append(line)
+      if line.startswith("$BME") or line.startswith("$ERR"):
+         break
+   return lines
+
+
+def print_runs(capture):
+   time_us = -capture["pre_samples"] * capture["period"]
+   for beams, length in capture["runs"]:
+      print("%+9d us  %6d us  S1 %s  S2 %s" % (time_us, length * capture["period"],
+            "broken " if beams & 1 else "clear  ", "broken" if beams & 2 else "clear"))
+      time_us += length * capture["period"]
+
+
+def plot_runs(capture, title):
+   import matplotlib.pyplot as plt
+   times, states = [], [[], []]
+   time_ms = -capture["pre_samples"] * capture["period"] / 1000.0
+   for beams, length in capture["runs"]:
+      for sensor in range(2):
+         states[sensor] += [(beams >> sensor) & 1] * 2
+      times += [time_ms, time_ms + length * capture["period"] / 1000.0]
+      time_ms = times[-1]
+
+   figure, axes = plt.subplots(2, 1, sharex=True)
+   for sensor, name in enumerate(("Sensor 1 (handlers side)", "Sensor 2 (box side)")):
+      axes[sensor].plot(times, states[sensor], drawstyle="steps-post")
+      axes[sensor].axvline(0, color="red", linestyle="--")
+      axes[sensor].set_ylabel(name)
+      axes[sensor].set_yticks([0, 1])
+      axes[sensor].set_yticklabels(["clear", "broken"])
+   axes[1].set_xlabel("Time relative to crossing (ms)")
+   figure.suptitle(title)
+   plt.show()
+
+
+def main():
+   parser = argparse.ArgumentParser(description="Plot a beam capture of the timing box")
+   parser.add_argument("port", nargs="?", help="serial port of the box")
+   parser.add_argument("number", type=int, help="capture number within the race (0-15)")
+   parser.add_argument("--race", type=int, help="race ID of the capture, the current race if not given")
+   parser.add_argument("--baud", type=int, default=115200)
+   parser.add_argument("--log", help="read the frames from a serial log file")
+   parser.add_argument("--text", action="store_true", help="print the runs instead of plotting")
+   args = parser.parse_args()
+
+   if args.log:
+      with open(args.log) as log:
+         lines = log.readlines()
+   elif args.port:
+      lines = read_from_box(args.port, args.baud, args.number, args.race)
+   else:
+      parser.error("either a serial port or --log is needed")
+
+   capture = parse_frames(lines, args.number, args.race)
+   title = "Race %d, dog %d, capture %d%s" % (capture["race"], capture["dog"] + 1, args.number,
+                                              " (truncated)" if capture["truncated"] else "")
+   if args.text:
+      print(title)
+      print_runs(capture)
+      return
+
+   try:
+      plot_runs(capture, title)
+   except ImportError:
+      print(title)
+      print_runs(capture)
+
+
+if __name__ == "__main__":
+   main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# clock_calibration.py
+# Measures the frequency error of the timing box' clock against the monotonic clock of this
+# computer and optionally stores the correction on the box:
+#
+#   python3 tools/clock_calibration.py /dev/ttyACM0 --minutes 10 --write
+#
+# Every second "CAL SYNC" is sent, the box answers with its raw micros() value. The host time of
+# a sample is the middle of the request/response round trip. Samples with a slow round trip (the
+# box was busy or the USB link was late) are dropped, a least squares fit of the remaining box
+# times against the host times gives the clock rate. The resolution improves with the length of
+# the measurement, after 10 minutes it is around 1-2ppm with a typical USB serial link.
+
+import argparse
+import sys
+import time
+
+import serial
+
+
+def checksum_ok(frame):
+   if not frame.startswith("$") or "*" not in frame:
+      return False
+   body, checksum = frame[1:].rsplit("*", 1)
+   value = 0
+   for character in body:
+      value ^= ord(character)
+   try:
+      return value == int(checksum, 16)
+   except ValueError:
+      return False
+
+
+def read_frame(port, tag, timeout):
+   deadline = time.monotonic() + timeout
+   while time.monotonic() < deadline:
+      line = port.readline().decode("ascii", "replace").strip()
+      if not line or not checksum_ok(line):
+         continue
+      fields = line[1:line.index("*")].split(",")
+      if fields[0] == tag:
+         return fields
+      if fields[0] == "ERR":
+         raise RuntimeError("box refused command: " + line)
+   return None
+
+
+def sample(port):
+   port.reset_input_buffer()
+   sent = time.monotonic_ns()
+   port.write(b"CAL SYNC\n")
+   fields = read_frame(port, "CAL", 1.0)
+   received = time.monotonic_ns()
+   if fields is None or len(fields) != 3 or fields[1] != "SYNC":
+      return None
+   return (sent + received) / 2000.0, int(fields[2]), (received - sent) / 1000.0
+
+
+def fit_slope(samples):
+   count = len(samples)
+   mean_host = sum(host for host, box in samples) / count
+   mean_box = sum(box for host, box in samples) / count
+   covariance = sum((host - mean_host) * (box - mean_box) for host, box in samples)
+   variance = sum((host - mean_host) ** 2 for host, box in samples)
+   return covariance / variance
+
+
+def main():
+   parser = argparse.ArgumentParser(description="Calibrate the clock of the timing box")
+   parser.add_argument("port", help="serial port of the box")
+   parser.add_argument("--baud", type=int, default=115200)
+   parser.add_argument("--minutes", type=float, default=10.0, help="duration of the measurement")
+   parser.add_argument("--keep", type=float, default=0.5, help="fraction of fastest round trips to keep")
+   parser.add_argument("--write", action="store_true", help="store the correction on the box")
+   args = parser.parse_args()
+
+   port = serial.Serial(args.port, args.baud, timeout=0.2)
+   time.sleep(2)   #Opening the port resets the board
+
+   samples = []
+   box_offset = 0
+   last_box = None
+   end = time.monotonic() + args.minutes * 60
+   while time.monotonic() < end:
+      result = sample(port)
+      if result is not None:
+         host, box, round_trip = result
+         #micros() wraps after 71 minutes
+         if last_box is not None and box < last_box:
+            box_offset += 1 << 32
+         last_box = box
+         samples.append((host, box + box_offset, round_trip))
+         sys.stdout.write("\r%d samples, %.0f s left " % (len(samples), end - time.monotonic()))
+         sys.stdout.flush()
+      time.sleep(1)
+   print()
+
+   if len(samples) < 10:
+      sys.exit("Not enough samples")
+
+   samples.sort(key=lambda item: item[2])
+   kept = samples[:max(10, int(len(samples) * args.keep))]
+   slope = fit_slope([(host, box) for host, box, round_trip in kept])
+
+   #The box measures slope us for every true us, so its durations need to be scaled by 1 / slope
+   ppm = int(round((1.0 / slope - 1.0) * 1e6))
+   print("Kept %d of %d samples (round trip <= %.0f us)" % (len(kept), len(samples), kept[-1][2]))
+   print("Box clock rate %.7f, correction %+d ppm" % (slope, ppm))
+
+   if args.write:
+      port.write(("CAL SET %d\n" % ppm).encode("ascii"))
+      fields = read_frame(port, "CAL", 2.0)
+      if fields is None or len(fields) != 2 or int(fields[1]) != ppm:
+         sys.exit("Storing the correction failed")
+      print("Correction stored")
+
+
+if __name__ == "__main__":
+   main()